@@ -0,0 +1,105 @@
+#include "ActivityMask.h"
+#include <algorithm>
+
+// constructor
+ActivityMask::ActivityMask(int nx, int ny) : NX(nx), NY(ny)
+{
+    tilesX = (NX + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+    tilesY = (NY + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+    numTiles = tilesX * tilesY;
+
+    marked = new unsigned char[numTiles];
+    active = new unsigned char[numTiles];
+    std::fill(marked, marked + numTiles, 0);
+    std::fill(active, active + numTiles, 0);
+
+    activeList.reserve(numTiles);
+}
+
+// destructor
+ActivityMask::~ActivityMask()
+{
+    delete[] marked;
+    delete[] active;
+}
+
+int ActivityMask::GetTileOf(int i, int j) const
+{
+    // clamp boundary cells onto the nearest interior tile
+    i = std::min(std::max(i, 1), NX) - 1;
+    j = std::min(std::max(j, 1), NY) - 1;
+    return i / ACTIVITY_TILE_SIZE + tilesX * (j / ACTIVITY_TILE_SIZE);
+}
+
+void ActivityMask::MarkRange(int i0, int i1, int j0, int j1)
+{
+    i0 = std::min(std::max(i0, 1), NX) - 1;
+    i1 = std::min(std::max(i1, 1), NX) - 1;
+    j0 = std::min(std::max(j0, 1), NY) - 1;
+    j1 = std::min(std::max(j1, 1), NY) - 1;
+    for (int tj = j0 / ACTIVITY_TILE_SIZE; tj <= j1 / ACTIVITY_TILE_SIZE; tj++) {
+        for (int ti = i0 / ACTIVITY_TILE_SIZE; ti <= i1 / ACTIVITY_TILE_SIZE; ti++) {
+            marked[ti + tilesX * tj] = 1;
+        }
+    }
+}
+
+void ActivityMask::Update()
+{
+    retiredList.clear();
+    activeList.clear();
+
+    for (int tj = 0; tj < tilesY; tj++) {
+        for (int ti = 0; ti < tilesX; ti++) {
+            int tile = ti + tilesX * tj;
+
+            // dilate the marks by one tile
+            bool now = !enabled;
+            for (int dj = -1; dj <= 1 && !now; dj++) {
+                for (int di = -1; di <= 1; di++) {
+                    int ni = ti + di;
+                    int nj = tj + dj;
+                    if (ni >= 0 && ni < tilesX && nj >= 0 && nj < tilesY &&
+                        marked[ni + tilesX * nj]) {
+                        now = true;
+                        break;
+                    }
+                }
+            }
+
+            if (active[tile] && !now) {
+                retiredList.push_back(tile);
+            }
+            active[tile] = now ? 1 : 0;
+            if (now) {
+                activeList.push_back(tile);
+            }
+        }
+    }
+
+    // marks are rebuilt during the coming step
+    std::fill(marked, marked + numTiles, 0);
+}
+
+void ActivityMask::Restore(const unsigned char* markedTiles, const unsigned char* activeTiles)
+{
+    retiredList.clear();
+    activeList.clear();
+    for (int tile = 0; tile < numTiles; tile++) {
+        marked[tile] = markedTiles[tile] ? 1 : 0;
+        active[tile] = activeTiles[tile] ? 1 : 0;
+        if (active[tile]) {
+            activeList.push_back(tile);
+        }
+    }
+}
+
+void ActivityMask::GetTileBounds(int tile, int& i0, int& i1, int& j0, int& j1) const
+{
+    int ti = tile % tilesX;
+    int tj = tile / tilesX;
+    i0 = 1 + ti * ACTIVITY_TILE_SIZE;
+    j0 = 1 + tj * ACTIVITY_TILE_SIZE;
+    i1 = std::min(i0 + ACTIVITY_TILE_SIZE - 1, NX);
+    j1 = std::min(j0 + ACTIVITY_TILE_SIZE - 1, NY);
+}
@@ -0,0 +1,82 @@
+#ifndef ACTIVITYMASK_H
+#define ACTIVITYMASK_H
+
+#include <vector>
+
+// cells per tile side for the activity mask
+#define ACTIVITY_TILE_SIZE 16
+
+// coarse per-tile bitmap of the dense grid. tiles are marked when they
+// receive input or hold values above the threshold after advection; the
+// solver kernels only visit marked tiles plus a one-tile dilation.
+class ActivityMask {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, nx/ny = non-boundary grid dimensions
+    ActivityMask(int nx, int ny);
+
+    // destructor
+    ~ActivityMask();
+
+    // owns its tile arrays
+    ActivityMask(const ActivityMask&) = delete;
+    ActivityMask& operator=(const ActivityMask&) = delete;
+
+    // mark the tile holding interior cell (i, j) as active for the next step
+    void MarkCell(int i, int j) { marked[GetTileOf(i, j)] = 1; }
+    void MarkTile(int tile) { marked[tile] = 1; }
+    // mark every tile overlapping the inclusive interior cell range
+    void MarkRange(int i0, int i1, int j0, int j1);
+
+    // rebuild the active tile list from the marks (dilated by one tile),
+    // collecting tiles that dropped out since the previous update
+    void Update();
+
+    // when disabled every tile is active
+    void SetEnabled(bool enable) { enabled = enable; }
+    bool IsEnabled() const { return enabled; }
+
+    int GetTileCount() const { return numTiles; }
+    int GetActiveCount() const { return static_cast<int>(activeList.size()); }
+    const int* GetActiveTiles() const { return activeList.data(); }
+    int GetRetiredCount() const { return static_cast<int>(retiredList.size()); }
+    const int* GetRetiredTiles() const { return retiredList.data(); }
+    bool IsActive(int tile) const { return active[tile] != 0; }
+
+    // tile holding cell (i, j), boundary cells map to the nearest interior tile
+    int GetTileOf(int i, int j) const;
+
+    // inclusive interior cell range covered by a tile
+    void GetTileBounds(int tile, int& i0, int& i1, int& j0, int& j1) const;
+
+    // raw per-tile state for checkpoints, Restore rebuilds the active list
+    const unsigned char* GetMarked() const { return marked; }
+    const unsigned char* GetActive() const { return active; }
+    void Restore(const unsigned char* markedTiles, const unsigned char* activeTiles);
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // NX, NY = non-boundary grid dimensions
+    int NX, NY;
+    int tilesX, tilesY;
+    int numTiles;
+    bool enabled = true;
+
+    // marked = touched since the last update, active = dilated marks
+    unsigned char* marked;
+    unsigned char* active;
+
+    std::vector<int> activeList;
+    std::vector<int> retiredList;
+};
+
+#endif // ACTIVITYMASK_H
@@ -0,0 +1,150 @@
+#include "AsyncFieldWriter.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+
+// constructor
+AsyncFieldWriter::AsyncFieldWriter(FrameSink* sink, int capacity, OverflowPolicy policy)
+    : sink(sink), capacity(std::max(capacity, 1)), policy(policy)
+{
+    stats = { 0, 0, 0, 0, 0, 0, 0.0 };
+
+    // queued frames plus the one being written plus the one being filled
+    for (int f = 0; f < this->capacity + 2; f++) {
+        freeFrames.push_back(new FieldFrame());
+    }
+
+    worker = std::thread(&AsyncFieldWriter::WriterLoop, this);
+}
+
+// destructor
+AsyncFieldWriter::~AsyncFieldWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    worker.join();
+
+    for (FieldFrame* frame : queue) {
+        delete frame;
+    }
+    for (FieldFrame* frame : freeFrames) {
+        delete frame;
+    }
+}
+
+void AsyncFieldWriter::SetPolicy(OverflowPolicy overflowPolicy)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = overflowPolicy;
+}
+
+WriterStats AsyncFieldWriter::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool AsyncFieldWriter::Submit(long long step, int nx, int ny, const float* data)
+{
+    TRACE_SCOPE("SubmitFrame");
+
+    size_t count = static_cast<size_t>(nx + 2) * (ny + 2);
+    FieldFrame* frame;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.submitted++;
+
+        if (static_cast<int>(queue.size()) >= capacity) {
+            if (policy == OverflowPolicy::DROP) {
+                stats.dropped++;
+                return false;
+            }
+            if (policy == OverflowPolicy::COALESCE) {
+                // overwrite the newest queued frame in place, under the lock
+                // since the writer can already see it
+                frame = queue.back();
+                frame->step = step;
+                frame->nx = nx;
+                frame->ny = ny;
+                frame->data.assign(data, data + count);
+                stats.coalesced++;
+                return true;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            notFull.wait(lock, [this] { return static_cast<int>(queue.size()) < capacity; });
+            stats.blockedMs += std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        // the pool covers one producer, more producers grow it
+        if (freeFrames.empty()) {
+            freeFrames.push_back(new FieldFrame());
+        }
+        frame = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    // fill a private frame without holding the lock
+    frame->step = step;
+    frame->nx = nx;
+    frame->ny = ny;
+    frame->data.assign(data, data + count);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(frame);
+        stats.maxQueued = std::max(stats.maxQueued, static_cast<int>(queue.size()));
+    }
+    notEmpty.notify_one();
+    return true;
+}
+
+void AsyncFieldWriter::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return queue.empty() && !writing; });
+}
+
+void AsyncFieldWriter::WriterLoop()
+{
+    TRACE_THREAD_NAME("field writer");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        notEmpty.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            // stopping and drained
+            break;
+        }
+
+        writing = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+
+        bool ok;
+        {
+            TRACE_SCOPE("WriteFrame");
+            ok = sink->WriteFrame(*writing);
+        }
+
+        lock.lock();
+        if (ok) {
+            stats.written++;
+        }
+        else {
+            stats.failed++;
+        }
+        freeFrames.push_back(writing);
+        writing = nullptr;
+        if (queue.empty()) {
+            idle.notify_all();
+        }
+    }
+    idle.notify_all();
+}
@@ -0,0 +1,87 @@
+#ifndef ASYNCFIELDWRITER_H
+#define ASYNCFIELDWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameSink.h"
+
+// what Submit does when the queue is full
+enum class OverflowPolicy {
+    BLOCK,      // wait for the writer, the solver slows to disk speed
+    DROP,       // discard the new frame
+    COALESCE    // replace the newest queued frame, the writer sees the latest state
+};
+
+// counters since construction
+struct WriterStats {
+    long long submitted;
+    long long written;
+    long long dropped;
+    long long coalesced;
+    long long failed;
+    int maxQueued;
+    double blockedMs;
+};
+
+// bounded queue of field snapshots drained by a background thread into a
+// FrameSink. Submit copies the field into a recycled buffer, so the
+// solver only pays a memcpy per frame and steady-state output does not
+// allocate.
+class AsyncFieldWriter {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, starts the writer thread. sink must outlive the writer
+    AsyncFieldWriter(FrameSink* sink, int capacity = 4, OverflowPolicy policy = OverflowPolicy::BLOCK);
+
+    // destructor, writes everything still queued
+    ~AsyncFieldWriter();
+
+    // queue a copy of an (nx + 2) x (ny + 2) field. false if it was dropped
+    bool Submit(long long step, int nx, int ny, const float* data);
+
+    // wait until every queued frame is written
+    void Flush();
+
+    void SetPolicy(OverflowPolicy overflowPolicy);
+    WriterStats GetStats() const;
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    FrameSink* sink;
+    int capacity;
+    OverflowPolicy policy;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::condition_variable idle;
+
+    std::deque<FieldFrame*> queue;
+    std::vector<FieldFrame*> freeFrames;
+    // frame owned by the writer thread while it is being written
+    FieldFrame* writing = nullptr;
+    bool stopping = false;
+
+    WriterStats stats;
+    std::thread worker;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void WriterLoop();
+};
+
+#endif // ASYNCFIELDWRITER_H
@@ -0,0 +1,167 @@
+#include "Checkpoint.h"
+#include "FluidSolver.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <iostream>
+
+static const char CHECKPOINT_MAGIC[4] = { 'F', 'S', 'C', 'K' };
+
+static uint64_t AlignUp(uint64_t offset)
+{
+    return (offset + CHECKPOINT_ALIGN - 1) & ~static_cast<uint64_t>(CHECKPOINT_ALIGN - 1);
+}
+
+// offsets of every array for a grid of this shape
+static void Layout(CheckpointHeader& h, int tiles, int velTiles)
+{
+    uint64_t size = static_cast<uint64_t>(h.nx + 2) * (h.ny + 2) * sizeof(float);
+    uint64_t sizeV = static_cast<uint64_t>(h.nx / h.velocityScale + 2) *
+        (h.ny / h.velocityScale + 2) * sizeof(float);
+
+    uint64_t offset = AlignUp(sizeof(CheckpointHeader));
+    for (int f = 0; f < CHECKPOINT_FIELDS; f++) {
+        h.fieldOffset[f] = offset;
+        offset = AlignUp(offset + (f < 2 ? size : sizeV));
+    }
+    h.maskOffset[0] = offset;
+    h.maskOffset[1] = offset + 2 * static_cast<uint64_t>(tiles);
+    h.fileBytes = h.maskOffset[1] + 2 * static_cast<uint64_t>(velTiles);
+}
+
+static bool Validate(const CheckpointHeader& h, const char* path)
+{
+    if (std::memcmp(h.magic, CHECKPOINT_MAGIC, 4) != 0) {
+        std::cerr << "Error: " << path << " is not a checkpoint." << std::endl;
+        return false;
+    }
+    if (h.version != CHECKPOINT_VERSION || h.headerBytes != sizeof(CheckpointHeader)) {
+        std::cerr << "Error: unsupported checkpoint version " << h.version << "." << std::endl;
+        return false;
+    }
+    if (h.nx <= 0 || h.ny <= 0 || h.velocityScale < 1 ||
+        h.nx % h.velocityScale != 0 || h.ny % h.velocityScale != 0) {
+        std::cerr << "Error: invalid grid in checkpoint " << path << "." << std::endl;
+        return false;
+    }
+    if (h.boundary < static_cast<int32_t>(BoundaryCondition::DIRICHLET) ||
+        h.boundary > static_cast<int32_t>(BoundaryCondition::PERIODIC)) {
+        std::cerr << "Error: invalid boundary condition " << h.boundary << " in checkpoint " << path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::Save(FluidSolver& solver, const char* path)
+{
+    Grid& grid = solver.grid;
+
+    // a solver loaded from a checkpoint still reads the old file's pages,
+    // which may be the file being replaced
+    grid.ReleaseMapping();
+
+    CheckpointHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, CHECKPOINT_MAGIC, 4);
+    h.version = CHECKPOINT_VERSION;
+    h.headerBytes = sizeof(CheckpointHeader);
+    h.nx = solver.NX;
+    h.ny = solver.NY;
+    h.velocityScale = grid.velocityScale;
+    h.boundary = static_cast<int32_t>(solver.bc);
+    h.maskEnabled = grid.mask.IsEnabled() ? 1 : 0;
+    h.hx = solver.hx;
+    h.hy = solver.hy;
+    h.dt = solver.dt;
+    h.diff = solver.diff;
+    h.activityThreshold = solver.activityThreshold;
+    h.stepCount = solver.stepCount;
+
+    int tiles = grid.mask.GetTileCount();
+    int velTiles = grid.velMask.GetTileCount();
+    Layout(h, tiles, velTiles);
+
+    MappedFile file;
+    if (!file.Create(path, static_cast<size_t>(h.fileBytes))) {
+        return false;
+    }
+    unsigned char* base = file.GetData();
+
+    std::memcpy(base, &h, sizeof(h));
+
+    const float* fields[CHECKPOINT_FIELDS] = { grid.dens, grid.dens_prev, grid.u, grid.u_prev, grid.v, grid.v_prev };
+    for (int f = 0; f < CHECKPOINT_FIELDS; f++) {
+        size_t count = (f < 2) ? grid.size : grid.sizeV;
+        std::memcpy(base + h.fieldOffset[f], fields[f], count * sizeof(float));
+    }
+
+    std::memcpy(base + h.maskOffset[0], grid.mask.GetMarked(), tiles);
+    std::memcpy(base + h.maskOffset[0] + tiles, grid.mask.GetActive(), tiles);
+    std::memcpy(base + h.maskOffset[1], grid.velMask.GetMarked(), velTiles);
+    std::memcpy(base + h.maskOffset[1] + velTiles, grid.velMask.GetActive(), velTiles);
+
+    // flushed to path.tmp, then renamed over path
+    return file.Commit();
+}
+
+bool Checkpoint::ReadHeader(const char* path, CheckpointHeader& header)
+{
+    MappedFile file;
+    if (!file.Open(path, false)) {
+        return false;
+    }
+    if (file.GetSize() < sizeof(CheckpointHeader)) {
+        std::cerr << "Error: truncated checkpoint " << path << "." << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    return Validate(header, path);
+}
+
+std::unique_ptr<FluidSolver> Checkpoint::Load(const char* path)
+{
+    // private pages: the solver writes its fields in place without
+    // touching the checkpoint
+    MappedFile* file = new MappedFile();
+    if (!file->Open(path, true) || file->GetSize() < sizeof(CheckpointHeader)) {
+        delete file;
+        return nullptr;
+    }
+
+    CheckpointHeader h;
+    std::memcpy(&h, file->GetData(), sizeof(h));
+    if (!Validate(h, path)) {
+        delete file;
+        return nullptr;
+    }
+
+    // recompute the layout rather than trusting the stored offsets
+    CheckpointHeader expected = h;
+    ActivityMask probe(h.nx, h.ny);
+    ActivityMask probeV(h.nx / h.velocityScale, h.ny / h.velocityScale);
+    Layout(expected, probe.GetTileCount(), probeV.GetTileCount());
+    if (std::memcmp(expected.fieldOffset, h.fieldOffset, sizeof(h.fieldOffset)) != 0 ||
+        std::memcmp(expected.maskOffset, h.maskOffset, sizeof(h.maskOffset)) != 0 ||
+        expected.fileBytes != h.fileBytes || file->GetSize() < h.fileBytes) {
+        std::cerr << "Error: corrupt or truncated checkpoint " << path << "." << std::endl;
+        delete file;
+        return nullptr;
+    }
+
+    unsigned char* base = file->GetData();
+    float* fields[CHECKPOINT_FIELDS];
+    for (int f = 0; f < CHECKPOINT_FIELDS; f++) {
+        fields[f] = reinterpret_cast<float*>(base + h.fieldOffset[f]);
+    }
+
+    // the grid takes ownership of the mapping
+    std::unique_ptr<FluidSolver> solver(new FluidSolver(h, file, fields));
+
+    Grid& grid = solver->grid;
+    int tiles = grid.mask.GetTileCount();
+    int velTiles = grid.velMask.GetTileCount();
+    grid.mask.Restore(base + h.maskOffset[0], base + h.maskOffset[0] + tiles);
+    grid.velMask.Restore(base + h.maskOffset[1], base + h.maskOffset[1] + velTiles);
+    solver->SetActivityMaskEnabled(h.maskEnabled != 0);
+
+    return solver;
+}
@@ -0,0 +1,58 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <memory>
+
+class FluidSolver;
+
+#define CHECKPOINT_VERSION 1
+// header and every array start on a page boundary so loads can map them
+#define CHECKPOINT_ALIGN 4096
+// dens, dens_prev, u, u_prev, v, v_prev
+#define CHECKPOINT_FIELDS 6
+
+// file header, stored in native (little-endian) layout at offset 0
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    // sizeof(CheckpointHeader), guards against layout changes
+    uint32_t headerBytes;
+    int32_t nx, ny;
+    int32_t velocityScale;
+    int32_t boundary;
+    int32_t maskEnabled;
+    float hx, hy;
+    float dt, diff;
+    float activityThreshold;
+    int64_t stepCount;
+    uint64_t fieldOffset[CHECKPOINT_FIELDS];
+    // marked then active tile bytes of the density and velocity masks
+    uint64_t maskOffset[2];
+    uint64_t fileBytes;
+};
+
+// full solver state on disk: every field buffer, the activity masks, the
+// parameters and the step counter. Save writes through a shared mapping
+// of a temporary file that replaces the checkpoint only once complete;
+// Load maps the file copy-on-write and the new solver's grid uses the
+// mapped arrays directly, so restoring costs page faults rather than reads.
+class Checkpoint {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // a solver still mapping a loaded checkpoint is moved to the heap first
+    static bool Save(FluidSolver& solver, const char* path);
+
+    // header only, to inspect a checkpoint without loading it
+    static bool ReadHeader(const char* path, CheckpointHeader& header);
+
+    // nullptr if the file is missing, truncated or of another version
+    static std::unique_ptr<FluidSolver> Load(const char* path);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,334 @@
+#include "DecomposedSolver.h"
+#include "HaloTransport.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// index of global cell (i, j) in this rank's arrays
+#define DIX(i, j) ((i) + (NX + 2) * ((j) - rowOffset))
+
+// constructor
+DecomposedSolver::DecomposedSolver(int nx, int ny, HaloTransport* transport, int haloRows)
+    : NX(nx), NY(ny), transport(transport), rank(transport->GetRank()), ranks(transport->GetRankCount()),
+    haloRows(haloRows), failed(false), stepCount(0), exchangeMs(0.0)
+{
+    // every rank sees the same split, so all of them fail together
+    if (!CheckStrips(NY, ranks, haloRows)) {
+        failed = true;
+        this->haloRows = std::max(haloRows, 0);
+    }
+    StripRows(NY, ranks, rank, rowBegin, rowEnd);
+    rowOffset = rowBegin - this->haloRows;
+
+    // square cells with the longer side of the domain at unit length, as FluidSolver
+    hx = hy = 1.0f / std::max(NX, NY);
+
+    // allocated here, after the caller had the chance to bind this process
+    // to its node, so first touch places the strip in local memory
+    size_t size = static_cast<size_t>(NX + 2) * std::max(rowEnd - rowBegin + 1 + 2 * this->haloRows, 1);
+    u = new float[size]();
+    v = new float[size]();
+    u_prev = new float[size]();
+    v_prev = new float[size]();
+    dens = new float[size]();
+    dens_prev = new float[size]();
+}
+
+// destructor
+DecomposedSolver::~DecomposedSolver()
+{
+    delete[] u;
+    delete[] v;
+    delete[] u_prev;
+    delete[] v_prev;
+    delete[] dens;
+    delete[] dens_prev;
+}
+
+bool DecomposedSolver::CheckStrips(int ny, int ranks, int haloRows)
+{
+    if (ranks < 1 || ranks > ny) {
+        std::cerr << "Error: cannot split " << ny << " rows across " << ranks << " ranks." << std::endl;
+        return false;
+    }
+    int thinnest = ny / ranks;
+    if (haloRows < 1 || haloRows > thinnest) {
+        std::cerr << "Error: a halo of " << haloRows << " rows needs 1.." << thinnest
+            << " for strips of " << thinnest << " rows." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void DecomposedSolver::StripRows(int ny, int ranks, int rank, int& begin, int& end)
+{
+    // the first ny % ranks strips take one extra row
+    int rows = ny / ranks;
+    int extra = ny % ranks;
+    begin = 1 + rank * rows + std::min(rank, extra);
+    end = begin + rows - 1 + (rank < extra ? 1 : 0);
+}
+
+void DecomposedSolver::AddInputToField(FieldType fieldType, int i, int j, float s)
+{
+    if (j < rowBegin || j > rowEnd) {
+        return;
+    }
+
+    switch (fieldType) {
+    case DENSITY:
+        dens[DIX(i, j)] += s * dt;
+        break;
+    case VELOCITY_U:
+        u[DIX(i, j)] += s * dt;
+        break;
+    case VELOCITY_V:
+        v[DIX(i, j)] += s * dt;
+        break;
+    default:
+        std::cerr << "Error: Invalid field type." << std::endl;
+        break;
+    }
+}
+
+// swap the outermost `rows` rows of the strip with the neighbours' ghost rows
+bool DecomposedSolver::Exchange(float* x, int rows)
+{
+    if (failed) {
+        return false;
+    }
+
+    TRACE_SCOPE("HaloExchange");
+    auto start = std::chrono::steady_clock::now();
+    size_t count = static_cast<size_t>(rows) * (NX + 2);
+    if (!transport->ExchangeHalo(x + DIX(0, rowBegin), x + DIX(0, rowBegin - rows),
+        x + DIX(0, rowEnd - rows + 1), x + DIX(0, rowEnd + 1), count)) {
+        failed = true;
+    }
+    exchangeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return !failed;
+}
+
+// Dirichlet on the edges of the global domain, cuts get their rows from the neighbours
+void DecomposedSolver::SetBoundary(float* x)
+{
+    for (int j = rowBegin; j <= rowEnd; j++) {
+        x[DIX(0, j)] = 0.0f;
+        x[DIX(NX + 1, j)] = 0.0f;
+    }
+    if (rank == 0) {
+        for (int i = 0; i <= NX + 1; i++) {
+            x[DIX(i, 0)] = 0.0f;
+        }
+    }
+    if (rank == ranks - 1) {
+        for (int i = 0; i <= NX + 1; i++) {
+            x[DIX(i, NY + 1)] = 0.0f;
+        }
+    }
+}
+
+void DecomposedSolver::Diffuse(float* x, const float* x0)
+{
+    TRACE_SCOPE("Diffuse");
+
+    float ax = dt * diff / (hx * hx);
+    float ay = dt * diff / (hy * hy);
+    float c = 1 + 2 * ax + 2 * ay;
+
+    // the first sweep reads the neighbours' rows of the initial guess
+    Exchange(x, 1);
+    for (int k = 0; k < relaxIterations && !failed; k++) {
+        for (int j = rowBegin; j <= rowEnd; j++) {
+            for (int i = 1; i <= NX; i++) {
+                x[DIX(i, j)] = (x0[DIX(i, j)] + ax * (x[DIX(i - 1, j)] + x[DIX(i + 1, j)]) +
+                    ay * (x[DIX(i, j - 1)] + x[DIX(i, j + 1)])) / c;
+            }
+        }
+        SetBoundary(x);
+        Exchange(x, 1);
+    }
+}
+
+void DecomposedSolver::Advect(float* d, float* d0, const float* u, const float* v)
+{
+    // backtraces may end up to haloRows rows into the neighbours' strips
+    Exchange(d0, haloRows);
+
+    TRACE_SCOPE("Advect");
+
+    float dt0x = dt / hx;
+    float dt0y = dt / hy;
+    float yLow = std::max(0.5f, static_cast<float>(rowBegin - haloRows));
+    float yHigh = std::min(NY + 0.5f, static_cast<float>(rowEnd + haloRows - 1));
+
+    for (int j = rowBegin; j <= rowEnd; j++) {
+        for (int i = 1; i <= NX; i++) {
+            float x = i - dt0x * u[DIX(i, j)];
+            float y = j - dt0y * v[DIX(i, j)];
+
+            if (x < 0.5f) x = 0.5f;
+            if (x > NX + 0.5f) x = NX + 0.5f;
+            int i0 = static_cast<int>(x);
+            int i1 = i0 + 1;
+
+            if (y < yLow) y = yLow;
+            if (y > yHigh) y = yHigh;
+            int j0 = static_cast<int>(y);
+            int j1 = j0 + 1;
+
+            float s1 = x - i0;
+            float s0 = 1.0f - s1;
+            float t1 = y - j0;
+            float t0 = 1.0f - t1;
+
+            d[DIX(i, j)] = s0 * (t0 * d0[DIX(i0, j0)] + t1 * d0[DIX(i0, j1)]) +
+                s1 * (t0 * d0[DIX(i1, j0)] + t1 * d0[DIX(i1, j1)]);
+        }
+    }
+
+    SetBoundary(d);
+}
+
+void DecomposedSolver::Project(float* u, float* v, float* p, float* div)
+{
+    // the divergence reads the velocity one row past the strip
+    Exchange(u, 1);
+    Exchange(v, 1);
+
+    TRACE_SCOPE("Project");
+
+    float ax = 1.0f / (hx * hx);
+    float ay = 1.0f / (hy * hy);
+    float wx = 2 * ax / (ax + ay);
+    float wy = 2 * ay / (ax + ay);
+
+    for (int j = rowBegin; j <= rowEnd; j++) {
+        for (int i = 1; i <= NX; i++) {
+            div[DIX(i, j)] = -((u[DIX(i + 1, j)] - u[DIX(i - 1, j)]) / hx +
+                (v[DIX(i, j + 1)] - v[DIX(i, j - 1)]) / hy) / (ax + ay);
+        }
+    }
+
+    // every rank starts from zero, so the ghost rows need no exchange
+    for (int j = rowBegin - 1; j <= rowEnd + 1; j++) {
+        for (int i = 0; i <= NX + 1; i++) {
+            p[DIX(i, j)] = 0.0f;
+        }
+    }
+
+    for (int k = 0; k < relaxIterations && !failed; k++) {
+        for (int j = rowBegin; j <= rowEnd; j++) {
+            for (int i = 1; i <= NX; i++) {
+                p[DIX(i, j)] = (div[DIX(i, j)] + wx * (p[DIX(i - 1, j)] + p[DIX(i + 1, j)]) +
+                    wy * (p[DIX(i, j - 1)] + p[DIX(i, j + 1)])) / 4.0f;
+            }
+        }
+        Exchange(p, 1);
+
+        // all ranks check the residual at the same sweeps and agree on it,
+        // so they stop together
+        if (pressureTolerance > 0.0f && k % 5 == 4 && !failed) {
+            float residual = 0.0f;
+            for (int j = rowBegin; j <= rowEnd; j++) {
+                for (int i = 1; i <= NX; i++) {
+                    float r = div[DIX(i, j)] + wx * (p[DIX(i - 1, j)] + p[DIX(i + 1, j)]) +
+                        wy * (p[DIX(i, j - 1)] + p[DIX(i, j + 1)]) - 4.0f * p[DIX(i, j)];
+                    residual = std::max(residual, std::fabs(r));
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            if (!transport->AllReduceMax(residual)) {
+                failed = true;
+            }
+            exchangeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (residual < pressureTolerance) {
+                break;
+            }
+        }
+    }
+
+    for (int j = rowBegin; j <= rowEnd; j++) {
+        for (int i = 1; i <= NX; i++) {
+            u[DIX(i, j)] -= 0.5f * (p[DIX(i + 1, j)] - p[DIX(i - 1, j)]) / hx;
+            v[DIX(i, j)] -= 0.5f * (p[DIX(i, j + 1)] - p[DIX(i, j - 1)]) / hy;
+        }
+    }
+
+    SetBoundary(u);
+    SetBoundary(v);
+}
+
+bool DecomposedSolver::Step()
+{
+    if (failed) {
+        return false;
+    }
+
+    TRACE_SCOPE("DecomposedStep");
+
+    // the FluidSolver sequence, see FluidSolver::StepVelocity and StepDensity
+    std::swap(u, u_prev);
+    std::swap(v, v_prev);
+    Diffuse(u, u_prev);
+    Diffuse(v, v_prev);
+    Project(u, v, u_prev, v_prev);
+    std::swap(u, u_prev);
+    std::swap(v, v_prev);
+    Advect(u, u_prev, u_prev, v_prev);
+    Advect(v, v_prev, u_prev, v_prev);
+    Project(u, v, u_prev, v_prev);
+
+    std::swap(dens, dens_prev);
+    Diffuse(dens, dens_prev);
+    std::swap(dens, dens_prev);
+    Advect(dens, dens_prev, u, v);
+
+    stepCount++;
+    return !failed;
+}
+
+bool DecomposedSolver::GatherDensity(float* density)
+{
+    if (failed) {
+        return false;
+    }
+
+    // each strip goes with the global boundary rows next to it
+    int first = (rank == 0) ? 0 : rowBegin;
+    int last = (rank == ranks - 1) ? NY + 1 : rowEnd;
+    size_t rowBytes = static_cast<size_t>(NX + 2) * sizeof(float);
+
+    if (rank != 0) {
+        return transport->Send(0, dens + DIX(0, first), (last - first + 1) * rowBytes);
+    }
+
+    std::copy(dens + DIX(0, first), dens + DIX(0, last + 1), density + static_cast<size_t>(first) * (NX + 2));
+    for (int r = 1; r < ranks; r++) {
+        int begin, end;
+        StripRows(NY, ranks, r, begin, end);
+        if (r == ranks - 1) {
+            end = NY + 1;
+        }
+        if (!transport->Receive(r, density + static_cast<size_t>(begin) * (NX + 2), (end - begin + 1) * rowBytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DecomposedSolver::GetDensitySum(double& sum)
+{
+    sum = 0.0;
+    if (failed) {
+        return false;
+    }
+    for (int j = rowBegin; j <= rowEnd; j++) {
+        for (int i = 1; i <= NX; i++) {
+            sum += dens[DIX(i, j)];
+        }
+    }
+    return transport->AllReduceSum(sum);
+}
@@ -0,0 +1,107 @@
+#ifndef DECOMPOSEDSOLVER_H
+#define DECOMPOSEDSOLVER_H
+
+#include <vector>
+#include "Grid.h"
+
+class HaloTransport;
+
+// one rank's share of an nx x ny Dirichlet grid cut into horizontal
+// strips, for grids whose step is bound by one socket's memory bandwidth.
+// each rank (usually a process pinned to its own NUMA node) steps its rows
+// with the FluidSolver scheme and swaps ghost rows with the ranks above
+// and below through a HaloTransport: one row after every relaxation sweep,
+// haloRows rows of the advected field before each advection.
+//
+// the relaxations are Gauss-Seidel within a strip and Jacobi across cuts,
+// and a backtrace reaches at most haloRows rows past its strip, so results
+// differ slightly from a single FluidSolver near the cuts. the whole strip
+// is always stepped, there is no activity mask
+class DecomposedSolver {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, the strip follows from the transport's rank and rank count.
+    // the solver is failed from the start if CheckStrips rejects the split
+    DecomposedSolver(int nx, int ny, HaloTransport* transport, int haloRows = 4);
+
+    // destructor
+    ~DecomposedSolver();
+
+    // every strip must hold at least haloRows rows, as a deeper halo would
+    // need rows from two ranks away. prints the reason when it fails
+    static bool CheckStrips(int ny, int ranks, int haloRows);
+
+    // add input at global cell (i, j), ignored outside this rank's rows so
+    // every rank can be given the same input
+    void AddInputToField(FieldType fieldType, int i, int j, float s);
+
+    // step, false once the transport failed or the split was rejected
+    bool Step();
+
+    // copy every rank's rows into rank 0's (NX + 2) x (NY + 2) density, the
+    // other ranks pass nullptr. every rank must call it
+    bool GatherDensity(float* density);
+
+    // total density over all ranks
+    bool GetDensitySum(double& sum);
+
+    // sweeps per relaxation, the pressure solve stops early once the
+    // largest residual over all ranks is below the tolerance (0 = never)
+    void SetRelaxationIterations(int iterations) { relaxIterations = iterations > 1 ? iterations : 1; }
+    void SetPressureTolerance(float tolerance) { pressureTolerance = tolerance; }
+
+    int GetNX() const { return NX; }
+    int GetNY() const { return NY; }
+    // interior rows rowBegin..rowEnd belong to this rank
+    int GetRowBegin() const { return rowBegin; }
+    int GetRowEnd() const { return rowEnd; }
+    long long GetStepCount() const { return stepCount; }
+    // time spent exchanging halos and reducing, including waiting for peers
+    double GetExchangeMs() const { return exchangeMs; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    int NX, NY;
+    HaloTransport* transport;
+    int rank, ranks;
+    int haloRows;
+    int rowBegin, rowEnd;
+    // global row of the first stored row, stored rows reach haloRows past the strip
+    int rowOffset;
+    bool failed;
+
+    float hx, hy;
+    float dt = 0.8f;
+    float diff = 0.0001f;
+    int relaxIterations = 20;
+    float pressureTolerance = 0.0f;
+
+    float *u, *v, *u_prev, *v_prev, *dens, *dens_prev;
+
+    long long stepCount;
+    double exchangeMs;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // rows of this rank for a strip split of ny rows
+    static void StripRows(int ny, int ranks, int rank, int& begin, int& end);
+
+    bool Exchange(float* x, int rows);
+    void SetBoundary(float* x);
+    void Diffuse(float* x, const float* x0);
+    void Advect(float* d, float* d0, const float* u, const float* v);
+    void Project(float* u, float* v, float* p, float* div);
+};
+
+#endif // DECOMPOSEDSOLVER_H
@@ -0,0 +1,486 @@
+#include "DeltaStream.h"
+#include "FieldCodec.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// residual of one value: zigzagged difference of the float bits, small
+// when a value changes a little, where XOR would flip low mantissa bits
+// and the borrow chain alike
+static uint32_t BitDelta(uint32_t cur, uint32_t prev)
+{
+    uint32_t d = cur - prev;
+    return (d << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(d) >> 31);
+}
+
+static uint32_t ApplyBitDelta(uint32_t prev, uint32_t z)
+{
+    return prev + ((z >> 1) ^ (0u - (z & 1)));
+}
+
+static const char DELTA_STREAM_MAGIC[4] = { 'F', 'S', 'D', 'S' };
+static const char DELTA_INDEX_MAGIC[4] = { 'F', 'S', 'D', 'X' };
+static const char DELTA_END_MAGIC[4] = { 'F', 'S', 'D', 'E' };
+
+// magic, version, nx, ny, tileSize, keyframeInterval
+static const size_t HEADER_BYTES = 24;
+// step, kind, payload bytes
+static const size_t RECORD_BYTES = 20;
+// index offset, end magic
+static const size_t TRAILER_BYTES = 12;
+
+enum DeltaFrameKind : uint32_t {
+    FRAME_KEY,
+    FRAME_DELTA
+};
+
+// ==================================================
+// WRITER
+// ==================================================
+
+// constructor
+DeltaStreamWriter::DeltaStreamWriter() : file(nullptr), offset(0), failed(false), pool(nullptr),
+    nx(0), ny(0), tileSize(0), tilesX(0), tilesY(0), keyframeInterval(1)
+{
+    stats = { 0, 0, 0, 0, 0, 0 };
+}
+
+// destructor
+DeltaStreamWriter::~DeltaStreamWriter()
+{
+    Close();
+}
+
+bool DeltaStreamWriter::Open(const char* path, int nx, int ny, int keyframeInterval, int tileSize, ThreadPool* pool)
+{
+    Close();
+
+    if (nx <= 0 || ny <= 0) {
+        std::cerr << "Error: invalid grid " << nx << "x" << ny << " for delta stream " << path << std::endl;
+        return false;
+    }
+
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Error: cannot open delta stream " << path << std::endl;
+        return false;
+    }
+
+    this->nx = nx;
+    this->ny = ny;
+    this->keyframeInterval = std::max(keyframeInterval, 1);
+    // a tile larger than the grid would only pad it
+    this->tileSize = std::min(std::max(tileSize, 1), std::max(nx, ny) + 2);
+    this->pool = pool;
+    tilesX = (nx + 2 + this->tileSize - 1) / this->tileSize;
+    tilesY = (ny + 2 + this->tileSize - 1) / this->tileSize;
+
+    size_t tileValues = static_cast<size_t>(this->tileSize) * this->tileSize;
+    previous.assign(static_cast<size_t>(nx + 2) * (ny + 2), 0.0f);
+    residual.assign(tileValues * tilesX * tilesY, 0.0f);
+    changed.assign(static_cast<size_t>(tilesX) * tilesY, 0);
+    keyframes.clear();
+    stats = { 0, 0, 0, 0, 0, 0 };
+    offset = 0;
+    failed = false;
+
+    uint32_t version = DELTA_STREAM_VERSION;
+    int32_t config[4] = { nx, ny, this->tileSize, this->keyframeInterval };
+    Put(DELTA_STREAM_MAGIC, 4);
+    Put(&version, sizeof(version));
+    Put(config, sizeof(config));
+    return !failed;
+}
+
+void DeltaStreamWriter::Put(const void* data, size_t bytes)
+{
+    if (std::fwrite(data, 1, bytes, file) != bytes) {
+        failed = true;
+    }
+    offset += bytes;
+}
+
+bool DeltaStreamWriter::WriteFrame(long long step, const float* data)
+{
+    TRACE_SCOPE("WriteDeltaFrame");
+
+    if (!file) {
+        return false;
+    }
+
+    int W = nx + 2;
+    int H = ny + 2;
+    size_t count = static_cast<size_t>(W) * H;
+    size_t tileValues = static_cast<size_t>(tileSize) * tileSize;
+    int tiles = tilesX * tilesY;
+
+    payload.clear();
+    CodecOptions options;
+    uint32_t kind;
+
+    if (stats.frames % keyframeInterval == 0) {
+        kind = FRAME_KEY;
+        options.mode = CodecMode::LOSSLESS;
+        FieldCodec::Encode(data, count, options, pool, payload);
+        keyframes.push_back({ stats.frames, step, offset });
+        stats.keyframes++;
+    }
+    else {
+        kind = FRAME_DELTA;
+
+        // residual of every tile against the previous frame into its own slot
+        auto diffTiles = [&](int begin, int end) {
+            for (int t = begin; t < end; t++) {
+                int i0 = (t % tilesX) * tileSize;
+                int j0 = (t / tilesX) * tileSize;
+                int i1 = std::min(i0 + tileSize, W);
+                int j1 = std::min(j0 + tileSize, H);
+                uint32_t* slot = reinterpret_cast<uint32_t*>(residual.data() + t * tileValues);
+                if (i1 - i0 < tileSize || j1 - j0 < tileSize) {
+                    // keep the padding of edge tiles zero, packing may have left data there
+                    std::memset(slot, 0, tileValues * sizeof(float));
+                }
+                uint32_t any = 0;
+                for (int j = j0; j < j1; j++) {
+                    const uint32_t* cur = reinterpret_cast<const uint32_t*>(data + static_cast<size_t>(j) * W);
+                    const uint32_t* prev = reinterpret_cast<const uint32_t*>(previous.data() + static_cast<size_t>(j) * W);
+                    uint32_t* row = slot + static_cast<size_t>(j - j0) * tileSize;
+                    for (int i = i0; i < i1; i++) {
+                        row[i - i0] = BitDelta(cur[i], prev[i]);
+                        any |= row[i - i0];
+                    }
+                }
+                changed[t] = any ? 1 : 0;
+            }
+        };
+        if (pool) {
+            pool->ParallelFor(tiles, diffTiles, 4);
+        }
+        else {
+            diffTiles(0, tiles);
+        }
+
+        // pack the changed tiles to the front
+        uint32_t changedCount = 0;
+        std::vector<unsigned char> bitmap((tiles + 7) / 8, 0);
+        for (int t = 0; t < tiles; t++) {
+            if (changed[t]) {
+                bitmap[t >> 3] |= static_cast<unsigned char>(1 << (t & 7));
+                if (changedCount != static_cast<uint32_t>(t)) {
+                    std::memcpy(residual.data() + changedCount * tileValues,
+                        residual.data() + t * tileValues, tileValues * sizeof(float));
+                }
+                changedCount++;
+            }
+        }
+
+        payload.resize(sizeof(changedCount));
+        std::memcpy(payload.data(), &changedCount, sizeof(changedCount));
+        payload.insert(payload.end(), bitmap.begin(), bitmap.end());
+        options.mode = CodecMode::RESIDUAL;
+        options.chunkValues = static_cast<int>(tileValues);
+        FieldCodec::Encode(residual.data(), changedCount * tileValues, options, pool, payload);
+
+        stats.tiles += tiles;
+        stats.skippedTiles += tiles - changedCount;
+    }
+
+    int64_t step64 = step;
+    uint64_t bytes = payload.size();
+    Put(&step64, sizeof(step64));
+    Put(&kind, sizeof(kind));
+    Put(&bytes, sizeof(bytes));
+    Put(payload.data(), payload.size());
+
+    std::memcpy(previous.data(), data, count * sizeof(float));
+    stats.frames++;
+    stats.rawBytes += count * sizeof(float);
+    stats.storedBytes = offset;
+
+    if (failed) {
+        std::cerr << "Error: write to delta stream failed" << std::endl;
+    }
+    return !failed;
+}
+
+bool DeltaStreamWriter::Close()
+{
+    if (!file) {
+        return true;
+    }
+
+    uint64_t indexOffset = offset;
+    uint32_t counts[2] = { static_cast<uint32_t>(keyframes.size()), static_cast<uint32_t>(stats.frames) };
+    Put(DELTA_INDEX_MAGIC, 4);
+    Put(counts, sizeof(counts));
+    for (const DeltaKeyframe& key : keyframes) {
+        int64_t entry[2] = { key.frame, key.step };
+        Put(entry, sizeof(entry));
+        Put(&key.offset, sizeof(key.offset));
+    }
+    Put(&indexOffset, sizeof(indexOffset));
+    Put(DELTA_END_MAGIC, 4);
+    stats.storedBytes = offset;
+
+    bool ok = (std::fclose(file) == 0) && !failed;
+    file = nullptr;
+    if (!ok) {
+        std::cerr << "Error: write to delta stream failed" << std::endl;
+    }
+    return ok;
+}
+
+// ==================================================
+// READER
+// ==================================================
+
+bool DeltaStreamReader::Open(const char* path, ThreadPool* pool)
+{
+    this->pool = pool;
+    keyframes.clear();
+    current.clear();
+    currentFrame = -1;
+    frameCount = 0;
+
+    if (!file.Open(path, false)) {
+        return false;
+    }
+    const unsigned char* base = file.GetData();
+    uint64_t size = file.GetSize();
+
+    uint32_t version = 0;
+    int32_t config[4];
+    if (size < HEADER_BYTES || std::memcmp(base, DELTA_STREAM_MAGIC, 4) != 0) {
+        std::cerr << "Error: " << path << " is not a delta stream." << std::endl;
+        return false;
+    }
+    std::memcpy(&version, base + 4, sizeof(version));
+    std::memcpy(config, base + 8, sizeof(config));
+    if (version != DELTA_STREAM_VERSION) {
+        std::cerr << "Error: unsupported delta stream version " << version << "." << std::endl;
+        return false;
+    }
+    nx = config[0];
+    ny = config[1];
+    tileSize = config[2];
+    // the cell index must fit an int, and the writer never makes a tile
+    // larger than the grid. the cell count is bounded by the file size
+    // below, by the keyframes
+    if (nx <= 0 || ny <= 0 || tileSize <= 0 ||
+        (static_cast<int64_t>(nx) + 2) * (static_cast<int64_t>(ny) + 2) > INT32_MAX ||
+        tileSize > std::max(nx, ny) + 2) {
+        std::cerr << "Error: invalid grid in delta stream " << path << "." << std::endl;
+        return false;
+    }
+    tilesX = (nx + 2 + tileSize - 1) / tileSize;
+    tilesY = (ny + 2 + tileSize - 1) / tileSize;
+
+    // use the index when the writer closed the stream
+    uint64_t indexOffset = 0;
+    if (size >= HEADER_BYTES + TRAILER_BYTES &&
+        std::memcmp(base + size - 4, DELTA_END_MAGIC, 4) == 0) {
+        std::memcpy(&indexOffset, base + size - TRAILER_BYTES, sizeof(indexOffset));
+    }
+    if (indexOffset >= HEADER_BYTES && indexOffset + 12 <= size - TRAILER_BYTES &&
+        std::memcmp(base + indexOffset, DELTA_INDEX_MAGIC, 4) == 0) {
+        uint32_t counts[2];
+        std::memcpy(counts, base + indexOffset + 4, sizeof(counts));
+        const size_t entryBytes = 24;
+        if (indexOffset + 12 + counts[0] * entryBytes + TRAILER_BYTES == size) {
+            // keyframes must be in order, inside the frame count and point at
+            // keyframe records before the index, otherwise the records are
+            // scanned instead
+            bool valid = counts[1] <= static_cast<uint32_t>(INT32_MAX);
+            const unsigned char* p = base + indexOffset + 12;
+            for (uint32_t k = 0; k < counts[0] && valid; k++, p += entryBytes) {
+                int64_t entry[2];
+                DeltaKeyframe key;
+                std::memcpy(entry, p, sizeof(entry));
+                std::memcpy(&key.offset, p + sizeof(entry), sizeof(key.offset));
+                key.frame = entry[0];
+                key.step = entry[1];
+                valid = key.frame >= 0 && key.frame < counts[1] && key.offset >= HEADER_BYTES &&
+                    key.offset < indexOffset && (keyframes.empty() || key.frame > keyframes.back().frame) &&
+                    IsKeyframe(key.offset, indexOffset);
+                keyframes.push_back(key);
+            }
+            if (valid) {
+                frameCount = static_cast<int>(counts[1]);
+                return true;
+            }
+            keyframes.clear();
+        }
+        return ScanFrames(indexOffset);
+    }
+
+    return ScanFrames(size);
+}
+
+bool DeltaStreamReader::ScanFrames(uint64_t end)
+{
+    const unsigned char* base = file.GetData();
+    uint64_t at = HEADER_BYTES;
+    long long frame = 0;
+
+    // a truncated last record is dropped
+    while (at + RECORD_BYTES <= end) {
+        int64_t step;
+        uint32_t kind;
+        uint64_t bytes;
+        std::memcpy(&step, base + at, sizeof(step));
+        std::memcpy(&kind, base + at + 8, sizeof(kind));
+        std::memcpy(&bytes, base + at + 12, sizeof(bytes));
+        if (kind > FRAME_DELTA || bytes > end - at - RECORD_BYTES ||
+            (kind == FRAME_KEY && !IsKeyframe(at, end))) {
+            break;
+        }
+        if (kind == FRAME_KEY) {
+            keyframes.push_back({ frame, step, at });
+        }
+        at += RECORD_BYTES + bytes;
+        frame++;
+    }
+    frameCount = static_cast<int>(frame);
+    return true;
+}
+
+bool DeltaStreamReader::IsKeyframe(uint64_t offset, uint64_t end) const
+{
+    const unsigned char* base = file.GetData();
+    if (offset > end || end - offset < RECORD_BYTES) {
+        return false;
+    }
+    uint32_t kind;
+    uint64_t bytes;
+    std::memcpy(&kind, base + offset + 8, sizeof(kind));
+    std::memcpy(&bytes, base + offset + 12, sizeof(bytes));
+    size_t count = static_cast<size_t>(nx + 2) * (ny + 2);
+    return kind == FRAME_KEY && bytes <= end - offset - RECORD_BYTES &&
+        FieldCodec::CheckCount(base + offset + RECORD_BYTES, static_cast<size_t>(bytes), count);
+}
+
+bool DeltaStreamReader::DecodeNext()
+{
+    const unsigned char* base = file.GetData();
+    uint64_t size = file.GetSize();
+    if (nextOffset > size || size - nextOffset < RECORD_BYTES) {
+        return false;
+    }
+
+    int64_t step;
+    uint32_t kind;
+    uint64_t bytes;
+    std::memcpy(&step, base + nextOffset, sizeof(step));
+    std::memcpy(&kind, base + nextOffset + 8, sizeof(kind));
+    std::memcpy(&bytes, base + nextOffset + 12, sizeof(bytes));
+    if (bytes > size - nextOffset - RECORD_BYTES) {
+        return false;
+    }
+    const unsigned char* p = base + nextOffset + RECORD_BYTES;
+
+    int W = nx + 2;
+    int H = ny + 2;
+    size_t count = static_cast<size_t>(W) * H;
+
+    if (kind == FRAME_KEY) {
+        if (!FieldCodec::CheckCount(p, static_cast<size_t>(bytes), count)) {
+            return false;
+        }
+        current.resize(count);
+        if (!FieldCodec::Decode(p, static_cast<size_t>(bytes), current.data(), count, pool)) {
+            return false;
+        }
+    }
+    else if (kind == FRAME_DELTA && current.size() == count) {
+        int tiles = tilesX * tilesY;
+        size_t bitmapBytes = (tiles + 7) / 8;
+        uint32_t changedCount;
+        if (bytes < sizeof(changedCount) + bitmapBytes) {
+            return false;
+        }
+        std::memcpy(&changedCount, p, sizeof(changedCount));
+        const unsigned char* bitmap = p + sizeof(changedCount);
+        const unsigned char* stream = bitmap + bitmapBytes;
+        if (changedCount > static_cast<uint32_t>(tiles)) {
+            return false;
+        }
+
+        size_t tileValues = static_cast<size_t>(tileSize) * tileSize;
+        size_t streamBytes = static_cast<size_t>(p + bytes - stream);
+        if (!FieldCodec::CheckCount(stream, streamBytes, changedCount * tileValues)) {
+            return false;
+        }
+        residual.resize(changedCount * tileValues);
+        if (!FieldCodec::Decode(stream, streamBytes, residual.data(),
+            residual.size(), pool)) {
+            return false;
+        }
+
+        // add each changed tile back onto the previous frame
+        uint32_t packed = 0;
+        for (int t = 0; t < tiles && packed < changedCount; t++) {
+            if (!(bitmap[t >> 3] & (1 << (t & 7)))) {
+                continue;
+            }
+            int i0 = (t % tilesX) * tileSize;
+            int j0 = (t / tilesX) * tileSize;
+            int i1 = std::min(i0 + tileSize, W);
+            int j1 = std::min(j0 + tileSize, H);
+            const uint32_t* slot = reinterpret_cast<const uint32_t*>(residual.data() + packed * tileValues);
+            for (int j = j0; j < j1; j++) {
+                uint32_t* row = reinterpret_cast<uint32_t*>(current.data() + static_cast<size_t>(j) * W);
+                const uint32_t* diff = slot + static_cast<size_t>(j - j0) * tileSize;
+                for (int i = i0; i < i1; i++) {
+                    row[i] = ApplyBitDelta(row[i], diff[i - i0]);
+                }
+            }
+            packed++;
+        }
+    }
+    else {
+        return false;
+    }
+
+    currentFrame++;
+    currentStep = step;
+    nextOffset += RECORD_BYTES + bytes;
+    return true;
+}
+
+bool DeltaStreamReader::ReadFrame(int frame, float* out, long long* step)
+{
+    TRACE_SCOPE("ReadDeltaFrame");
+
+    if (frame < 0 || frame >= frameCount) {
+        return false;
+    }
+
+    // nearest keyframe at or before the frame
+    auto key = std::upper_bound(keyframes.begin(), keyframes.end(), static_cast<long long>(frame),
+        [](long long f, const DeltaKeyframe& k) { return f < k.frame; });
+    if (key == keyframes.begin()) {
+        return false;
+    }
+    --key;
+
+    // roll forward from the current frame when no keyframe lies between
+    if (currentFrame < key->frame || currentFrame > frame) {
+        currentFrame = static_cast<int>(key->frame) - 1;
+        nextOffset = key->offset;
+    }
+    while (currentFrame < frame) {
+        if (!DecodeNext()) {
+            std::cerr << "Error: corrupt frame " << currentFrame + 1 << " in delta stream." << std::endl;
+            currentFrame = -1;
+            return false;
+        }
+    }
+
+    std::memcpy(out, current.data(), current.size() * sizeof(float));
+    if (step) {
+        *step = currentStep;
+    }
+    return true;
+}
@@ -0,0 +1,157 @@
+#ifndef DELTASTREAM_H
+#define DELTASTREAM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "MappedFile.h"
+
+class ThreadPool;
+
+// temporal delta stream of one field, little-endian:
+//   "FSDS", u32 version, i32 nx, ny, tileSize, keyframeInterval
+//   frames: i64 step, u32 kind, u64 bytes, payload
+//     key:   FieldCodec LOSSLESS stream of the whole frame
+//     delta: u32 changed tiles, tile bitmap, FieldCodec RESIDUAL stream of
+//            the changed tiles' zigzagged float-bit differences against
+//            the previous frame, one chunk per tile (edge tiles zero padded)
+//   index: "FSDX", u32 keyframes, u32 frames, keyframes x (i64 frame, i64 step, u64 offset)
+//   trailer: u64 index offset, "FSDE"
+#define DELTA_STREAM_VERSION 1
+
+struct DeltaKeyframe {
+    long long frame;
+    long long step;
+    uint64_t offset;
+};
+
+// counters since Open
+struct DeltaStreamStats {
+    long long frames;
+    long long keyframes;
+    long long tiles;
+    long long skippedTiles;
+    uint64_t rawBytes;
+    uint64_t storedBytes;
+};
+
+// writes a series of frames as periodic lossless keyframes with bitwise
+// difference residuals in between. consecutive density frames differ in few tiles,
+// so most tiles are skipped outright and the rest are mostly zero bits.
+class DeltaStreamWriter {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    DeltaStreamWriter();
+
+    // destructor, closes the stream
+    ~DeltaStreamWriter();
+
+    // frames are (nx + 2) x (ny + 2). pool may be nullptr
+    bool Open(const char* path, int nx, int ny, int keyframeInterval = 32, int tileSize = 64,
+        ThreadPool* pool = nullptr);
+
+    bool WriteFrame(long long step, const float* data);
+
+    // writes the keyframe index, false on an I/O error
+    bool Close();
+
+    bool IsOpen() const { return file != nullptr; }
+    DeltaStreamStats GetStats() const { return stats; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    FILE* file;
+    uint64_t offset;
+    bool failed;
+    ThreadPool* pool;
+
+    int nx, ny;
+    int tileSize;
+    int tilesX, tilesY;
+    int keyframeInterval;
+
+    // last frame written, the reference of the next delta
+    std::vector<float> previous;
+    // changed tiles of the current frame, packed tileSize^2 apart
+    std::vector<float> residual;
+    std::vector<unsigned char> changed;
+    std::vector<unsigned char> payload;
+
+    std::vector<DeltaKeyframe> keyframes;
+    DeltaStreamStats stats;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void Put(const void* data, size_t bytes);
+};
+
+// random access to a delta stream through a read-only mapping. a frame is
+// rebuilt from the nearest keyframe at or before it, and stepping forward
+// from the last frame read only applies the deltas in between, so scrubbing
+// and playback stay cheap. a stream without an index (the writer never
+// closed it) is scanned on Open instead.
+class DeltaStreamReader {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    bool Open(const char* path, ThreadPool* pool = nullptr);
+
+    int GetNX() const { return nx; }
+    int GetNY() const { return ny; }
+    int GetFrameCount() const { return frameCount; }
+    const std::vector<DeltaKeyframe>& GetKeyframes() const { return keyframes; }
+
+    // decode frame (0 .. GetFrameCount() - 1) into (nx + 2) x (ny + 2) floats
+    bool ReadFrame(int frame, float* out, long long* step = nullptr);
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    MappedFile file;
+    ThreadPool* pool = nullptr;
+
+    int nx = 0, ny = 0;
+    int tileSize = 0;
+    int tilesX = 0, tilesY = 0;
+    int frameCount = 0;
+    std::vector<DeltaKeyframe> keyframes;
+
+    // last decoded frame and where the record after it starts
+    std::vector<float> current;
+    std::vector<float> residual;
+    int currentFrame = -1;
+    long long currentStep = 0;
+    uint64_t nextOffset = 0;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // apply the record at nextOffset to current
+    bool DecodeNext();
+    bool ScanFrames(uint64_t end);
+    // true if a keyframe record of the whole grid starts at offset and ends
+    // by end, which also bounds the grid by the file size
+    bool IsKeyframe(uint64_t offset, uint64_t end) const;
+};
+
+#endif // DELTASTREAM_H
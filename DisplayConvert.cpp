@@ -0,0 +1,222 @@
+#include "DisplayConvert.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DISPLAY_SSE2
+#include <emmintrin.h>
+#endif
+
+// MSVC has no __F16C__, every AVX2 target has F16C
+#if defined(DISPLAY_SSE2) && (defined(__F16C__) || defined(__AVX2__))
+#define DISPLAY_F16C
+#include <immintrin.h>
+#endif
+
+int DisplayBytesPerTexel(DisplayFormat format)
+{
+    switch (format) {
+    case DisplayFormat::HALF16:
+    case DisplayFormat::UNORM16:
+        return 2;
+    case DisplayFormat::UNORM8:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+// ==================================================
+// SCALAR
+// ==================================================
+
+// rebias the exponent and round the mantissa to nearest even, with a magic
+// add for results in the half subnormal range. Inf stays Inf, NaN becomes
+// a quiet NaN and values too large for a half become Inf
+uint16_t FloatToHalf(float value)
+{
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Overflow = (127u + 16) << 23;
+    const uint32_t denormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits >= f16Overflow) {
+        half = (bits > f32Infinity) ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < (113u << 23)) {
+        float magic, shifted;
+        std::memcpy(&magic, &denormMagic, sizeof(magic));
+        std::memcpy(&shifted, &bits, sizeof(shifted));
+        shifted += magic;
+        std::memcpy(&half, &shifted, sizeof(half));
+        half -= denormMagic;
+    }
+    else {
+        uint32_t mantissaOdd = (bits >> 13) & 1;
+        bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff;
+        bits += mantissaOdd;
+        half = bits >> 13;
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+static uint16_t ToUnorm16(float v)
+{
+    // written so NaN lands on 0
+    v = (v > 0.0f) ? std::min(v, 1.0f) : 0.0f;
+    return static_cast<uint16_t>(v * 65535.0f + 0.5f);
+}
+
+static uint8_t ToUnorm8(float v)
+{
+    v = (v > 0.0f) ? std::min(v, 1.0f) : 0.0f;
+    return static_cast<uint8_t>(v * 255.0f + 0.5f);
+}
+
+// ==================================================
+// SSE2
+// ==================================================
+
+#ifdef DISPLAY_SSE2
+
+// clamp to [0, 1] (NaN to 0), scale to [0, maxValue] and round
+static inline __m128i UnormLanes(__m128 v, __m128 scale, __m128 maxValue)
+{
+    v = _mm_mul_ps(v, scale);
+    // maxps returns its second operand when either is NaN
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    v = _mm_add_ps(_mm_mul_ps(v, maxValue), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(v);
+}
+
+// pack two vectors of values in [0, 65535] to eight u16, SSE2 has only a
+// signed 32 -> 16 pack so the range is shifted around it
+static inline __m128i PackU16(__m128i a, __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+    return _mm_xor_si128(packed, bias16);
+}
+
+#ifndef DISPLAY_F16C
+// FloatToHalf on four lanes, both branches computed and selected by mask
+static inline __m128i HalfLanes(__m128 v)
+{
+    const __m128i signMask = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i f32Infinity = _mm_set1_epi32(255 << 23);
+    const __m128i f16Overflow = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalLimit = _mm_set1_epi32(113 << 23);
+
+    __m128i bits = _mm_castps_si128(v);
+    __m128i sign = _mm_and_si128(bits, signMask);
+    bits = _mm_xor_si128(bits, sign);
+
+    __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_add_epi32(bits, _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(15 - 127) << 23) + 0xfff)));
+    normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissaOdd), 13);
+
+    __m128 shifted = _mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(denormMagic));
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(shifted), denormMagic);
+
+    __m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00),
+        _mm_and_si128(_mm_cmpgt_epi32(bits, f32Infinity), _mm_set1_epi32(0x0200)));
+
+    // bits has no sign left, so the signed compares are exact
+    __m128i isSubnormal = _mm_cmplt_epi32(bits, normalLimit);
+    __m128i isSpecial = _mm_cmpgt_epi32(bits, _mm_sub_epi32(f16Overflow, _mm_set1_epi32(1)));
+    __m128i half = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    half = _mm_or_si128(_mm_and_si128(isSpecial, special), _mm_andnot_si128(isSpecial, half));
+    return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+#endif
+
+#endif // DISPLAY_SSE2
+
+// ==================================================
+// CONVERSION
+// ==================================================
+
+void ConvertForDisplay(const float* in, void* out, size_t count, DisplayFormat format, float scale)
+{
+    size_t i = 0;
+
+    switch (format) {
+    case DisplayFormat::FLOAT32: {
+        float* dst = static_cast<float*>(out);
+        if (scale == 1.0f) {
+            std::memcpy(dst, in, count * sizeof(float));
+            return;
+        }
+        for (; i < count; i++) {
+            dst[i] = in[i] * scale;
+        }
+        return;
+    }
+
+    case DisplayFormat::HALF16: {
+        uint16_t* dst = static_cast<uint16_t*>(out);
+#ifdef DISPLAY_SSE2
+        __m128 s = _mm_set1_ps(scale);
+        for (; i + 8 <= count; i += 8) {
+            __m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), s);
+            __m128 b = _mm_mul_ps(_mm_loadu_ps(in + i + 4), s);
+#ifdef DISPLAY_F16C
+            __m128i packed = _mm_unpacklo_epi64(_mm_cvtps_ph(a, _MM_FROUND_TO_NEAREST_INT),
+                _mm_cvtps_ph(b, _MM_FROUND_TO_NEAREST_INT));
+#else
+            __m128i packed = PackU16(HalfLanes(a), HalfLanes(b));
+#endif
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = FloatToHalf(in[i] * scale);
+        }
+        return;
+    }
+
+    case DisplayFormat::UNORM16: {
+        uint16_t* dst = static_cast<uint16_t*>(out);
+#ifdef DISPLAY_SSE2
+        __m128 s = _mm_set1_ps(scale);
+        __m128 maxValue = _mm_set1_ps(65535.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = UnormLanes(_mm_loadu_ps(in + i), s, maxValue);
+            __m128i b = UnormLanes(_mm_loadu_ps(in + i + 4), s, maxValue);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), PackU16(a, b));
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = ToUnorm16(in[i] * scale);
+        }
+        return;
+    }
+
+    case DisplayFormat::UNORM8: {
+        uint8_t* dst = static_cast<uint8_t*>(out);
+#ifdef DISPLAY_SSE2
+        __m128 s = _mm_set1_ps(scale);
+        __m128 maxValue = _mm_set1_ps(255.0f);
+        for (; i + 16 <= count; i += 16) {
+            __m128i a = UnormLanes(_mm_loadu_ps(in + i), s, maxValue);
+            __m128i b = UnormLanes(_mm_loadu_ps(in + i + 4), s, maxValue);
+            __m128i c = UnormLanes(_mm_loadu_ps(in + i + 8), s, maxValue);
+            __m128i d = UnormLanes(_mm_loadu_ps(in + i + 12), s, maxValue);
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = ToUnorm8(in[i] * scale);
+        }
+        return;
+    }
+    }
+}
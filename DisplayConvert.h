@@ -0,0 +1,25 @@
+#ifndef DISPLAYCONVERT_H
+#define DISPLAYCONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// texel formats for uploading a field to the display
+enum class DisplayFormat {
+    FLOAT32,    // 4 bytes, the field as is
+    HALF16,     // 2 bytes, IEEE half float
+    UNORM16,    // 2 bytes, value * scale clamped to [0, 1]
+    UNORM8      // 1 byte, value * scale clamped to [0, 1]
+};
+
+int DisplayBytesPerTexel(DisplayFormat format);
+
+// write value * scale of count values in the display format. SSE2 (and
+// F16C for half floats when the compiler targets it) with a scalar tail,
+// unaligned in and out are fine
+void ConvertForDisplay(const float* in, void* out, size_t count, DisplayFormat format, float scale);
+
+// round-to-nearest-even float to half conversion, one value
+uint16_t FloatToHalf(float value);
+
+#endif // DISPLAYCONVERT_H
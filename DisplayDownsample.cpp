@@ -0,0 +1,158 @@
+#include "DisplayDownsample.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DOWNSAMPLE_SSE2
+#include <emmintrin.h>
+#endif
+
+// first and one-past-last cell under each of pixels pixels spread over
+// [v0, v1), never empty and always inside [0, cells)
+static void PixelSpans(double v0, double v1, int cells, int pixels, std::vector<int>& start, std::vector<int>& end)
+{
+    start.resize(pixels);
+    end.resize(pixels);
+    double step = (v1 - v0) / pixels;
+    for (int p = 0; p < pixels; p++) {
+        int a, b;
+        if (step <= 1.0) {
+            a = static_cast<int>(std::floor(v0 + (p + 0.5) * step));
+            b = a + 1;
+        }
+        else {
+            a = static_cast<int>(std::floor(v0 + p * step));
+            b = static_cast<int>(std::floor(v0 + (p + 1) * step));
+        }
+        a = std::min(std::max(a, 0), cells - 1);
+        b = std::min(std::max(b, a + 1), cells);
+        start[p] = a;
+        end[p] = b;
+    }
+}
+
+// acc = acc + row or max(acc, row), elementwise
+static void CombineRow(float* acc, const float* row, int count, DownsampleFilter filter)
+{
+    int i = 0;
+    if (filter == DownsampleFilter::MAX) {
+#ifdef DOWNSAMPLE_SSE2
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_ps(acc + i, _mm_max_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(row + i)));
+            _mm_storeu_ps(acc + i + 4, _mm_max_ps(_mm_loadu_ps(acc + i + 4), _mm_loadu_ps(row + i + 4)));
+        }
+#endif
+        for (; i < count; i++) {
+            acc[i] = std::max(acc[i], row[i]);
+        }
+    }
+    else {
+#ifdef DOWNSAMPLE_SSE2
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(row + i)));
+            _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_loadu_ps(row + i + 4)));
+        }
+#endif
+        for (; i < count; i++) {
+            acc[i] += row[i];
+        }
+    }
+}
+
+// sum or max of count values
+static float ReduceSpan(const float* values, int count, DownsampleFilter filter)
+{
+    int i = 0;
+    float result;
+    if (filter == DownsampleFilter::MAX) {
+        result = values[0];
+#ifdef DOWNSAMPLE_SSE2
+        if (count >= 4) {
+            __m128 m = _mm_loadu_ps(values);
+            for (i = 4; i + 4 <= count; i += 4) {
+                m = _mm_max_ps(m, _mm_loadu_ps(values + i));
+            }
+            m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+            m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+            result = _mm_cvtss_f32(m);
+        }
+#endif
+        for (; i < count; i++) {
+            result = std::max(result, values[i]);
+        }
+    }
+    else {
+        result = 0.0f;
+#ifdef DOWNSAMPLE_SSE2
+        if (count >= 4) {
+            __m128 s = _mm_setzero_ps();
+            for (; i + 4 <= count; i += 4) {
+                s = _mm_add_ps(s, _mm_loadu_ps(values + i));
+            }
+            s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+            s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1)));
+            result = _mm_cvtss_f32(s);
+        }
+#endif
+        for (; i < count; i++) {
+            result += values[i];
+        }
+    }
+    return result;
+}
+
+void DownsampleField(const float* field, int width, int height, const FieldView& view,
+    float* out, int outWidth, int outHeight, DownsampleFilter filter, ThreadPool* pool)
+{
+    TRACE_SCOPE("DownsampleField");
+
+    if (outWidth <= 0 || outHeight <= 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    std::vector<int> colStart, colEnd, rowStart, rowEnd;
+    PixelSpans(view.x0, view.x1, width, outWidth, colStart, colEnd);
+    PixelSpans(view.y0, view.y1, height, outHeight, rowStart, rowEnd);
+
+    // only the visible columns are combined, spans grow monotonically
+    int firstCol = colStart[0];
+    int accWidth = colEnd[outWidth - 1] - firstCol;
+
+    // each pixel row first combines its source rows over the visible width,
+    // then reduces that row per pixel span. zoomed in, neighbouring pixel
+    // rows share a source row and are copied instead
+    auto resampleRows = [&](int begin, int end) {
+        std::vector<float> acc(accWidth);
+        for (int py = begin; py < end; py++) {
+            float* dst = out + static_cast<size_t>(py) * outWidth;
+            if (py > begin && rowStart[py] == rowStart[py - 1] && rowEnd[py] == rowEnd[py - 1]) {
+                std::memcpy(dst, dst - outWidth, outWidth * sizeof(float));
+                continue;
+            }
+
+            std::memcpy(acc.data(), field + static_cast<size_t>(rowStart[py]) * width + firstCol, accWidth * sizeof(float));
+            for (int j = rowStart[py] + 1; j < rowEnd[py]; j++) {
+                CombineRow(acc.data(), field + static_cast<size_t>(j) * width + firstCol, accWidth, filter);
+            }
+
+            int rows = rowEnd[py] - rowStart[py];
+            for (int px = 0; px < outWidth; px++) {
+                int cols = colEnd[px] - colStart[px];
+                float v = ReduceSpan(acc.data() + colStart[px] - firstCol, cols, filter);
+                dst[px] = (filter == DownsampleFilter::BOX) ? v / static_cast<float>(cols * rows) : v;
+            }
+        }
+    };
+
+    if (pool && outHeight > 1) {
+        int grain = std::max(1, outHeight / (pool->GetThreadCount() * 4));
+        pool->ParallelFor(outHeight, resampleRows, grain);
+    }
+    else {
+        resampleRows(0, outHeight);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef DISPLAYDOWNSAMPLE_H
+#define DISPLAYDOWNSAMPLE_H
+
+class ThreadPool;
+
+enum class DownsampleFilter {
+    BOX,    // mean of the cells under a pixel, keeps the overall look
+    MAX     // largest cell under a pixel, thin filaments stay visible
+};
+
+// region of a field in cell units, cell (i, j) covers [i, i + 1) x [j, j + 1)
+struct FieldView {
+    float x0, y0;
+    float x1, y1;
+};
+
+// resample the view of a width x height field (rows width apart, row 0 at
+// the bottom) to outWidth x outHeight pixels, so the display costs what
+// the window costs instead of what the grid costs. a pixel covering more
+// than one cell is filtered over all of them, a pixel smaller than a cell
+// takes the cell under its centre. source rows are combined with SSE2 and
+// output rows split over pool (nullptr runs on the caller)
+void DownsampleField(const float* field, int width, int height, const FieldView& view,
+    float* out, int outWidth, int outHeight, DownsampleFilter filter, ThreadPool* pool);
+
+#endif // DISPLAYDOWNSAMPLE_H
@@ -0,0 +1,476 @@
+#include "EnsembleBatch.h"
+#include "FluidSolver.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENSEMBLE_SSE2
+#include <emmintrin.h>
+#endif
+
+// index of lane 0 of cell (i, j) in a packed field
+#define LX(i, j) (((i) + (NX + 2) * (j)) * ENSEMBLE_LANES)
+
+// ==================================================
+// LANES
+// ==================================================
+
+// one value per member of a group. the kernels below are written once
+// against these and match the scalar FluidSolver expressions operation for
+// operation, so every lane rounds exactly like the solver it came from
+#ifdef ENSEMBLE_SSE2
+typedef __m128 Lanes;
+static inline Lanes LaneLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void LaneStore(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+static inline Lanes LaneSplat(float a) { return _mm_set1_ps(a); }
+static inline Lanes LaneAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes LaneSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes LaneMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes LaneDiv(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+static inline Lanes LaneNeg(Lanes a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+static inline Lanes LaneClamp(Lanes a, Lanes lo, Lanes hi) { return _mm_min_ps(_mm_max_ps(a, lo), hi); }
+// truncate positive values, as the solver's static_cast<int>
+static inline void LaneTruncate(Lanes a, int* out, Lanes& truncated)
+{
+    __m128i t = _mm_cvttps_epi32(a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), t);
+    truncated = _mm_cvtepi32_ps(t);
+}
+#else
+struct Lanes {
+    float v[ENSEMBLE_LANES];
+};
+static inline Lanes LaneLoad(const float* p) { Lanes r; for (int l = 0; l < ENSEMBLE_LANES; l++) r.v[l] = p[l]; return r; }
+static inline void LaneStore(float* p, Lanes a) { for (int l = 0; l < ENSEMBLE_LANES; l++) p[l] = a.v[l]; }
+static inline Lanes LaneSplat(float a) { Lanes r; for (int l = 0; l < ENSEMBLE_LANES; l++) r.v[l] = a; return r; }
+static inline Lanes LaneAdd(Lanes a, Lanes b) { for (int l = 0; l < ENSEMBLE_LANES; l++) a.v[l] += b.v[l]; return a; }
+static inline Lanes LaneSub(Lanes a, Lanes b) { for (int l = 0; l < ENSEMBLE_LANES; l++) a.v[l] -= b.v[l]; return a; }
+static inline Lanes LaneMul(Lanes a, Lanes b) { for (int l = 0; l < ENSEMBLE_LANES; l++) a.v[l] *= b.v[l]; return a; }
+static inline Lanes LaneDiv(Lanes a, Lanes b) { for (int l = 0; l < ENSEMBLE_LANES; l++) a.v[l] /= b.v[l]; return a; }
+static inline Lanes LaneNeg(Lanes a) { for (int l = 0; l < ENSEMBLE_LANES; l++) a.v[l] = -a.v[l]; return a; }
+static inline Lanes LaneClamp(Lanes a, Lanes lo, Lanes hi)
+{
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        if (a.v[l] < lo.v[l]) a.v[l] = lo.v[l];
+        if (a.v[l] > hi.v[l]) a.v[l] = hi.v[l];
+    }
+    return a;
+}
+static inline void LaneTruncate(Lanes a, int* out, Lanes& truncated)
+{
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        out[l] = static_cast<int>(a.v[l]);
+        truncated.v[l] = static_cast<float>(out[l]);
+    }
+}
+#endif
+
+// ==================================================
+// BATCH
+// ==================================================
+
+EnsembleBatch::EnsembleBatch(int numThreads, bool interleaved)
+    : pool(new ThreadPool(numThreads)), interleaved(interleaved), layoutValid(false)
+{
+}
+
+EnsembleBatch::~EnsembleBatch()
+{
+    delete pool;
+    for (std::vector<float>* buffer : scratch) {
+        delete buffer;
+    }
+}
+
+int EnsembleBatch::Add(FluidSolver* solver)
+{
+    members.push_back(solver);
+    layoutValid = false;
+    return static_cast<int>(members.size()) - 1;
+}
+
+int EnsembleBatch::GetInterleavedCount() const
+{
+    int count = 0;
+    for (const Group& group : groups) {
+        count += group.count;
+    }
+    return count;
+}
+
+bool EnsembleBatch::CanInterleave(const FluidSolver* solver) const
+{
+    return interleaved && solver->bc == BoundaryCondition::DIRICHLET && solver->grid.velocityScale == 1 &&
+        !solver->output && !solver->display;
+}
+
+bool EnsembleBatch::LayoutMatches() const
+{
+    if (!layoutValid) {
+        return false;
+    }
+    for (const Group& group : groups) {
+        for (int l = 0; l < group.count; l++) {
+            const FluidSolver* solver = group.lanes[l];
+            if (!CanInterleave(solver) || solver->relaxIterations != group.iterations) {
+                return false;
+            }
+        }
+    }
+    for (const FluidSolver* solver : singles) {
+        if (CanInterleave(solver)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EnsembleBatch::BuildLayout()
+{
+    groups.clear();
+    singles.clear();
+
+    for (FluidSolver* solver : members) {
+        if (!CanInterleave(solver)) {
+            singles.push_back(solver);
+            continue;
+        }
+
+        Group* open = nullptr;
+        for (Group& group : groups) {
+            if (group.count < ENSEMBLE_LANES && group.NX == solver->NX && group.NY == solver->NY &&
+                group.iterations == solver->relaxIterations) {
+                open = &group;
+                break;
+            }
+        }
+        if (!open) {
+            groups.push_back({ {}, 0, solver->NX, solver->NY, solver->relaxIterations });
+            open = &groups.back();
+        }
+        open->lanes[open->count++] = solver;
+    }
+
+    layoutValid = true;
+}
+
+void EnsembleBatch::Step(int steps)
+{
+    TRACE_SCOPE("EnsembleStep");
+
+    if (!LayoutMatches()) {
+        BuildLayout();
+    }
+
+    // one item per group or lone member. items are coarse, so the pool
+    // balances them one at a time
+    int numGroups = static_cast<int>(groups.size());
+    int items = numGroups + static_cast<int>(singles.size());
+    pool->ParallelFor(items, [&](int begin, int end) {
+        for (int item = begin; item < end; item++) {
+            if (item < numGroups) {
+                StepGroup(groups[item], steps);
+            }
+            else {
+                FluidSolver* solver = singles[item - numGroups];
+                for (int s = 0; s < steps; s++) {
+                    solver->Step();
+                }
+            }
+        }
+    });
+}
+
+// ==================================================
+// INTERLEAVED GROUPS
+// ==================================================
+
+void EnsembleBatch::StepGroup(const Group& group, int steps)
+{
+    TRACE_SCOPE("EnsembleGroup");
+
+    std::vector<float>* buffer;
+    {
+        std::lock_guard<std::mutex> lock(scratchMutex);
+        if (scratch.empty()) {
+            buffer = new std::vector<float>();
+        }
+        else {
+            buffer = scratch.back();
+            scratch.pop_back();
+        }
+    }
+
+    size_t cells = static_cast<size_t>(group.NX + 2) * (group.NY + 2);
+    // lanes past the group's members must read as zero fields
+    if (group.count < ENSEMBLE_LANES) {
+        buffer->assign(6 * cells * ENSEMBLE_LANES, 0.0f);
+    }
+    else {
+        buffer->resize(6 * cells * ENSEMBLE_LANES);
+    }
+    Packed packed;
+    Pack(group, packed, buffer->data());
+
+    for (int s = 0; s < steps; s++) {
+        // FluidSolver::StepVelocity
+        std::swap(packed.u, packed.u_prev);
+        std::swap(packed.v, packed.v_prev);
+        Diffuse(packed, VELOCITY_U);
+        Diffuse(packed, VELOCITY_V);
+        Project(packed);
+        std::swap(packed.u, packed.u_prev);
+        std::swap(packed.v, packed.v_prev);
+        Advect(packed, VELOCITY_U);
+        Advect(packed, VELOCITY_V);
+        Project(packed);
+
+        // FluidSolver::StepDensity
+        std::swap(packed.dens, packed.dens_prev);
+        Diffuse(packed, DENSITY);
+        std::swap(packed.dens, packed.dens_prev);
+        Advect(packed, DENSITY);
+    }
+
+    Unpack(group, packed);
+    for (int l = 0; l < group.count; l++) {
+        FluidSolver* solver = group.lanes[l];
+        solver->stepCount += steps;
+        solver->MarkAllDirty();
+
+        // the kernels visit every tile, so a member stepped alone next must
+        // not retire any of them on marks from before the group
+        solver->grid.velMask.MarkRange(1, group.NX, 1, group.NY);
+        solver->grid.mask.MarkRange(1, group.NX, 1, group.NY);
+    }
+
+    std::lock_guard<std::mutex> lock(scratchMutex);
+    scratch.push_back(buffer);
+}
+
+void EnsembleBatch::Pack(const Group& group, Packed& packed, float* storage)
+{
+    int NX = group.NX;
+    int NY = group.NY;
+    size_t cells = static_cast<size_t>(NX + 2) * (NY + 2);
+
+    packed.NX = NX;
+    packed.NY = NY;
+    packed.iterations = group.iterations;
+    float** fields[6] = { &packed.dens, &packed.dens_prev, &packed.u, &packed.u_prev, &packed.v, &packed.v_prev };
+    for (int f = 0; f < 6; f++) {
+        *fields[f] = storage + f * cells * ENSEMBLE_LANES;
+    }
+    packed.tiles = &group.lanes[0]->grid.mask;
+
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        const FluidSolver* solver = group.lanes[l < group.count ? l : 0];
+        packed.dt[l] = solver->dt;
+        packed.diff[l] = solver->diff;
+        packed.hx[l] = solver->hx;
+        packed.hy[l] = solver->hy;
+    }
+
+    for (int l = 0; l < group.count; l++) {
+        const Grid& grid = group.lanes[l]->grid;
+        const float* source[6] = { grid.dens, grid.dens_prev, grid.u, grid.u_prev, grid.v, grid.v_prev };
+        for (int f = 0; f < 6; f++) {
+            float* target = *fields[f] + l;
+            for (size_t k = 0; k < cells; k++) {
+                target[k * ENSEMBLE_LANES] = source[f][k];
+            }
+        }
+    }
+}
+
+void EnsembleBatch::Unpack(const Group& group, const Packed& packed)
+{
+    size_t cells = static_cast<size_t>(group.NX + 2) * (group.NY + 2);
+    const float* fields[6] = { packed.dens, packed.dens_prev, packed.u, packed.u_prev, packed.v, packed.v_prev };
+
+    for (int l = 0; l < group.count; l++) {
+        Grid& grid = group.lanes[l]->grid;
+        float* target[6] = { grid.dens, grid.dens_prev, grid.u, grid.u_prev, grid.v, grid.v_prev };
+        for (int f = 0; f < 6; f++) {
+            const float* source = fields[f] + l;
+            for (size_t k = 0; k < cells; k++) {
+                target[f][k] = source[k * ENSEMBLE_LANES];
+            }
+        }
+    }
+}
+
+void EnsembleBatch::SetBoundary(float* x, int NX, int NY)
+{
+    // Dirichlet, the only boundary grouped members have
+    Lanes zero = LaneSplat(0.0f);
+    for (int j = 0; j <= NY + 1; j++) {
+        LaneStore(x + LX(0, j), zero);
+        LaneStore(x + LX(NX + 1, j), zero);
+    }
+    for (int i = 1; i <= NX; i++) {
+        LaneStore(x + LX(i, 0), zero);
+        LaneStore(x + LX(i, NY + 1), zero);
+    }
+}
+
+void EnsembleBatch::Diffuse(const Packed& packed, FieldType fieldType)
+{
+    int NX = packed.NX;
+    int NY = packed.NY;
+
+    float a[2][ENSEMBLE_LANES], cl[ENSEMBLE_LANES];
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        a[0][l] = packed.dt[l] * packed.diff[l] / (packed.hx[l] * packed.hx[l]);
+        a[1][l] = packed.dt[l] * packed.diff[l] / (packed.hy[l] * packed.hy[l]);
+        cl[l] = 1 + 2 * a[0][l] + 2 * a[1][l];
+    }
+    Lanes ax = LaneLoad(a[0]), ay = LaneLoad(a[1]), c = LaneLoad(cl);
+
+    float* x = (fieldType == DENSITY) ? packed.dens : (fieldType == VELOCITY_U) ? packed.u : packed.v;
+    const float* x0 = (fieldType == DENSITY) ? packed.dens_prev : (fieldType == VELOCITY_U) ? packed.u_prev : packed.v_prev;
+
+    int numTiles = packed.tiles->GetTileCount();
+    int i0, i1, j0, j1;
+    for (int k = 0; k < packed.iterations; k++) {
+        for (int t = 0; t < numTiles; t++) {
+            packed.tiles->GetTileBounds(t, i0, i1, j0, j1);
+            for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i++) {
+                    Lanes sum = LaneAdd(LaneLoad(x0 + LX(i, j)), LaneMul(ax, LaneAdd(LaneLoad(x + LX(i - 1, j)), LaneLoad(x + LX(i + 1, j)))));
+                    sum = LaneAdd(sum, LaneMul(ay, LaneAdd(LaneLoad(x + LX(i, j - 1)), LaneLoad(x + LX(i, j + 1)))));
+                    LaneStore(x + LX(i, j), LaneDiv(sum, c));
+                }
+            }
+        }
+        SetBoundary(x, NX, NY);
+    }
+}
+
+void EnsembleBatch::Advect(const Packed& packed, FieldType fieldType)
+{
+    int NX = packed.NX;
+    int NY = packed.NY;
+
+    float d0x[ENSEMBLE_LANES], d0y[ENSEMBLE_LANES];
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        d0x[l] = packed.dt[l] / packed.hx[l];
+        d0y[l] = packed.dt[l] / packed.hy[l];
+    }
+    Lanes dt0x = LaneLoad(d0x), dt0y = LaneLoad(d0y);
+    Lanes lo = LaneSplat(0.5f), hiX = LaneSplat(NX + 0.5f), hiY = LaneSplat(NY + 0.5f), one = LaneSplat(1.0f);
+
+    float* d = (fieldType == DENSITY) ? packed.dens : (fieldType == VELOCITY_U) ? packed.u : packed.v;
+    const float* d0 = (fieldType == DENSITY) ? packed.dens_prev : (fieldType == VELOCITY_U) ? packed.u_prev : packed.v_prev;
+    // as in FluidSolver::Advect
+    bool density = (fieldType == DENSITY);
+    const float* u = density ? packed.u : packed.u_prev;
+    const float* v = density ? packed.v : packed.v_prev;
+
+    int numTiles = packed.tiles->GetTileCount();
+    int ti0, ti1, tj0, tj1;
+    int cellX[ENSEMBLE_LANES], cellY[ENSEMBLE_LANES];
+    float corner[4][ENSEMBLE_LANES];
+    for (int t = 0; t < numTiles; t++) {
+        packed.tiles->GetTileBounds(t, ti0, ti1, tj0, tj1);
+        for (int j = tj0; j <= tj1; j++) {
+            for (int i = ti0; i <= ti1; i++) {
+                Lanes x = LaneSub(LaneSplat(static_cast<float>(i)), LaneMul(dt0x, LaneLoad(u + LX(i, j))));
+                Lanes y = LaneSub(LaneSplat(static_cast<float>(j)), LaneMul(dt0y, LaneLoad(v + LX(i, j))));
+                x = LaneClamp(x, lo, hiX);
+                y = LaneClamp(y, lo, hiY);
+
+                Lanes fx, fy;
+                LaneTruncate(x, cellX, fx);
+                LaneTruncate(y, cellY, fy);
+                Lanes s1 = LaneSub(x, fx), s0 = LaneSub(one, s1);
+                Lanes t1 = LaneSub(y, fy), t0 = LaneSub(one, t1);
+
+                // each lane backtraces to its own cell
+                for (int l = 0; l < ENSEMBLE_LANES; l++) {
+                    const float* p = d0 + LX(cellX[l], cellY[l]) + l;
+                    corner[0][l] = p[0];
+                    corner[1][l] = p[(NX + 2) * ENSEMBLE_LANES];
+                    corner[2][l] = p[ENSEMBLE_LANES];
+                    corner[3][l] = p[(NX + 3) * ENSEMBLE_LANES];
+                }
+                Lanes left = LaneAdd(LaneMul(t0, LaneLoad(corner[0])), LaneMul(t1, LaneLoad(corner[1])));
+                Lanes right = LaneAdd(LaneMul(t0, LaneLoad(corner[2])), LaneMul(t1, LaneLoad(corner[3])));
+                LaneStore(d + LX(i, j), LaneAdd(LaneMul(s0, left), LaneMul(s1, right)));
+            }
+        }
+    }
+
+    SetBoundary(d, NX, NY);
+}
+
+void EnsembleBatch::Project(const Packed& packed)
+{
+    int NX = packed.NX;
+    int NY = packed.NY;
+
+    float axl[ENSEMBLE_LANES], ayl[ENSEMBLE_LANES], wxl[ENSEMBLE_LANES], wyl[ENSEMBLE_LANES], sum[ENSEMBLE_LANES];
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        axl[l] = 1.0f / (packed.hx[l] * packed.hx[l]);
+        ayl[l] = 1.0f / (packed.hy[l] * packed.hy[l]);
+        wxl[l] = 2 * axl[l] / (axl[l] + ayl[l]);
+        wyl[l] = 2 * ayl[l] / (axl[l] + ayl[l]);
+        sum[l] = axl[l] + ayl[l];
+    }
+    Lanes hx = LaneLoad(packed.hx), hy = LaneLoad(packed.hy), axy = LaneLoad(sum);
+    Lanes wx = LaneLoad(wxl), wy = LaneLoad(wyl);
+    Lanes zero = LaneSplat(0.0f), half = LaneSplat(0.5f), four = LaneSplat(4.0f);
+
+    float* u = packed.u;
+    float* v = packed.v;
+    float* p = packed.u_prev;
+    float* div = packed.v_prev;
+
+    int numTiles = packed.tiles->GetTileCount();
+    int i0, i1, j0, j1;
+
+    for (int t = 0; t < numTiles; t++) {
+        packed.tiles->GetTileBounds(t, i0, i1, j0, j1);
+        for (int j = j0; j <= j1; j++) {
+            for (int i = i0; i <= i1; i++) {
+                Lanes du = LaneDiv(LaneSub(LaneLoad(u + LX(i + 1, j)), LaneLoad(u + LX(i - 1, j))), hx);
+                Lanes dv = LaneDiv(LaneSub(LaneLoad(v + LX(i, j + 1)), LaneLoad(v + LX(i, j - 1))), hy);
+                LaneStore(div + LX(i, j), LaneDiv(LaneNeg(LaneAdd(du, dv)), axy));
+                LaneStore(p + LX(i, j), zero);
+            }
+        }
+    }
+
+    SetBoundary(div, NX, NY);
+    SetBoundary(p, NX, NY);
+
+    for (int k = 0; k < packed.iterations; k++) {
+        for (int t = 0; t < numTiles; t++) {
+            packed.tiles->GetTileBounds(t, i0, i1, j0, j1);
+            for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i++) {
+                    Lanes s = LaneAdd(LaneLoad(div + LX(i, j)), LaneMul(wx, LaneAdd(LaneLoad(p + LX(i - 1, j)), LaneLoad(p + LX(i + 1, j)))));
+                    s = LaneAdd(s, LaneMul(wy, LaneAdd(LaneLoad(p + LX(i, j - 1)), LaneLoad(p + LX(i, j + 1)))));
+                    LaneStore(p + LX(i, j), LaneDiv(s, four));
+                }
+            }
+        }
+        SetBoundary(p, NX, NY);
+    }
+
+    for (int t = 0; t < numTiles; t++) {
+        packed.tiles->GetTileBounds(t, i0, i1, j0, j1);
+        for (int j = j0; j <= j1; j++) {
+            for (int i = i0; i <= i1; i++) {
+                Lanes gx = LaneDiv(LaneMul(half, LaneSub(LaneLoad(p + LX(i + 1, j)), LaneLoad(p + LX(i - 1, j)))), hx);
+                Lanes gy = LaneDiv(LaneMul(half, LaneSub(LaneLoad(p + LX(i, j + 1)), LaneLoad(p + LX(i, j - 1)))), hy);
+                LaneStore(u + LX(i, j), LaneSub(LaneLoad(u + LX(i, j)), gx));
+                LaneStore(v + LX(i, j), LaneSub(LaneLoad(v + LX(i, j)), gy));
+            }
+        }
+    }
+
+    SetBoundary(u, NX, NY);
+    SetBoundary(v, NX, NY);
+}
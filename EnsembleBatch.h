@@ -0,0 +1,114 @@
+#ifndef ENSEMBLEBATCH_H
+#define ENSEMBLEBATCH_H
+
+#include <mutex>
+#include <vector>
+#include "Grid.h"
+
+class FluidSolver;
+class ThreadPool;
+
+// members whose cells share one SIMD vector in the interleaved layout
+#define ENSEMBLE_LANES 4
+
+// steps many independent solvers together, e.g. the members of a
+// parameter sweep, spread over one thread pool instead of a process each.
+//
+// in the interleaved layout, members with the same grid are packed in
+// groups of ENSEMBLE_LANES so that one vector holds the same cell of every
+// member of a group. each relaxation sweep, advection and projection then
+// runs once per group with a member per lane, with each member's own dt,
+// diffusion and cell size. a grouped member gives exactly the result of
+// stepping it alone with the activity mask off, whatever its own mask
+// setting, which the batch leaves as it is. its profiler records nothing
+// while grouped.
+// only Dirichlet members with full resolution velocity and no field or
+// display output are grouped, the rest are stepped on their own
+class EnsembleBatch {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, numThreads <= 0 uses the hardware concurrency
+    EnsembleBatch(int numThreads = 0, bool interleaved = false);
+
+    // destructor
+    ~EnsembleBatch();
+
+    // add a member, the solver must outlive the batch. returns its index
+    int Add(FluidSolver* solver);
+
+    // advance every member by `steps` steps. grouped members are packed
+    // before and unpacked after, so between calls every solver holds its
+    // own state and takes input as usual
+    void Step(int steps = 1);
+
+    int GetMemberCount() const { return static_cast<int>(members.size()); }
+    FluidSolver* GetMember(int member) const { return members[member]; }
+    // members stepped in an interleaved group
+    int GetInterleavedCount() const;
+    ThreadPool& GetPool() { return *pool; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // up to ENSEMBLE_LANES members with the same grid and iteration count
+    struct Group {
+        FluidSolver* lanes[ENSEMBLE_LANES];
+        int count;
+        int NX, NY;
+        int iterations;
+    };
+
+    // a group packed for stepping: ENSEMBLE_LANES floats per cell in each
+    // field and each lane's parameters. unused lanes hold zero fields and
+    // the first lane's parameters
+    struct Packed {
+        int NX, NY;
+        int iterations;
+        float* dens, * dens_prev, * u, * u_prev, * v, * v_prev;
+        float dt[ENSEMBLE_LANES], diff[ENSEMBLE_LANES];
+        float hx[ENSEMBLE_LANES], hy[ENSEMBLE_LANES];
+        const ActivityMask* tiles;
+    };
+
+    ThreadPool* pool;
+    bool interleaved;
+    std::vector<FluidSolver*> members;
+
+    // rebuilt when members are added or a grouped member changes its grid
+    // settings
+    std::vector<Group> groups;
+    std::vector<FluidSolver*> singles;
+    bool layoutValid;
+
+    // packing buffers, one per group being stepped at a time
+    std::mutex scratchMutex;
+    std::vector<std::vector<float>*> scratch;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    bool CanInterleave(const FluidSolver* solver) const;
+    bool LayoutMatches() const;
+    void BuildLayout();
+
+    void StepGroup(const Group& group, int steps);
+    void Pack(const Group& group, Packed& packed, float* storage);
+    void Unpack(const Group& group, const Packed& packed);
+
+    // the FluidSolver kernels with a member per lane, in the same order
+    static void Diffuse(const Packed& packed, FieldType fieldType);
+    static void Advect(const Packed& packed, FieldType fieldType);
+    static void Project(const Packed& packed);
+    static void SetBoundary(float* x, int NX, int NY);
+};
+
+#endif // ENSEMBLEBATCH_H
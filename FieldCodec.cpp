@@ -0,0 +1,502 @@
+#include "FieldCodec.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// rANS with 12-bit probabilities and a 32-bit state renormalised bytewise
+#define RANS_PROB_BITS 12
+#define RANS_PROB_SCALE (1 << RANS_PROB_BITS)
+#define RANS_L (1u << 23)
+
+enum PlaneKind : unsigned char {
+    PLANE_STORED,
+    PLANE_CONSTANT,
+    PLANE_RANS
+};
+
+// mode, 3 pad bytes, error bound, chunk values, chunk count
+static const size_t STREAM_HEADER_BYTES = 16;
+
+// ==================================================
+// BYTE HELPERS
+// ==================================================
+
+static void PutBytes(std::vector<unsigned char>& out, const void* src, size_t bytes)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(src);
+    out.insert(out.end(), p, p + bytes);
+}
+
+static void PutU32(std::vector<unsigned char>& out, uint32_t v)
+{
+    PutBytes(out, &v, sizeof(v));
+}
+
+static bool GetBytes(const unsigned char*& p, const unsigned char* end, void* dst, size_t bytes)
+{
+    if (static_cast<size_t>(end - p) < bytes) {
+        return false;
+    }
+    std::memcpy(dst, p, bytes);
+    p += bytes;
+    return true;
+}
+
+static uint32_t Zigzag(uint32_t d)
+{
+    return (d << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(d) >> 31);
+}
+
+static uint32_t Unzigzag(uint32_t z)
+{
+    return (z >> 1) ^ (0u - (z & 1));
+}
+
+// ==================================================
+// RANS
+// ==================================================
+
+// scale symbol counts to sum to RANS_PROB_SCALE, every present symbol >= 1
+static void NormalizeFrequencies(const uint32_t counts[256], size_t total, uint32_t freq[256])
+{
+    int sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        freq[s] = 0;
+        if (counts[s]) {
+            freq[s] = std::max<uint32_t>(1, static_cast<uint32_t>(
+                static_cast<uint64_t>(counts[s]) * RANS_PROB_SCALE / total));
+            sum += freq[s];
+            if (counts[s] > counts[largest]) {
+                largest = s;
+            }
+        }
+    }
+
+    // the rounding error usually fits in the most frequent symbol
+    int diff = RANS_PROB_SCALE - sum;
+    if (static_cast<int>(freq[largest]) + diff >= 1) {
+        freq[largest] += diff;
+        return;
+    }
+
+    // otherwise shave one off the largest frequencies until it fits
+    while (sum > RANS_PROB_SCALE) {
+        int s = static_cast<int>(std::max_element(freq, freq + 256) - freq);
+        freq[s]--;
+        sum--;
+    }
+}
+
+// append a PLANE_RANS payload, false if it would not be smaller than n
+static bool RansEncode(const unsigned char* in, size_t n, std::vector<unsigned char>& out)
+{
+    uint32_t counts[256] = {};
+    for (size_t i = 0; i < n; i++) {
+        counts[in[i]]++;
+    }
+
+    uint32_t freq[256], start[256];
+    NormalizeFrequencies(counts, n, freq);
+    uint32_t cumulative = 0;
+    for (int s = 0; s < 256; s++) {
+        start[s] = cumulative;
+        cumulative += freq[s];
+    }
+
+    // symbols are coded back to front so the decoder runs forwards, the
+    // bytes come out reversed
+    std::vector<unsigned char> reversed;
+    reversed.reserve(n / 2 + 16);
+    uint32_t x = RANS_L;
+    for (size_t i = n; i-- > 0;) {
+        uint32_t f = freq[in[i]];
+        uint32_t xMax = ((RANS_L >> RANS_PROB_BITS) << 8) * f;
+        while (x >= xMax) {
+            reversed.push_back(static_cast<unsigned char>(x & 0xff));
+            x >>= 8;
+        }
+        x = ((x / f) << RANS_PROB_BITS) + (x % f) + start[in[i]];
+    }
+    for (int b = 0; b < 4; b++) {
+        reversed.push_back(static_cast<unsigned char>(x & 0xff));
+        x >>= 8;
+    }
+
+    // presence bitmap, then each present frequency - 1 as a varint
+    size_t begin = out.size();
+    unsigned char present[32] = {};
+    for (int s = 0; s < 256; s++) {
+        if (freq[s]) {
+            present[s >> 3] |= static_cast<unsigned char>(1 << (s & 7));
+        }
+    }
+    out.push_back(PLANE_RANS);
+    PutBytes(out, present, sizeof(present));
+    for (int s = 0; s < 256; s++) {
+        if (freq[s]) {
+            uint32_t v = freq[s] - 1;
+            while (v >= 0x80) {
+                out.push_back(static_cast<unsigned char>((v & 0x7f) | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<unsigned char>(v));
+        }
+    }
+    PutU32(out, static_cast<uint32_t>(reversed.size()));
+    out.insert(out.end(), reversed.rbegin(), reversed.rend());
+
+    if (out.size() - begin >= n + 1) {
+        out.resize(begin);
+        return false;
+    }
+    return true;
+}
+
+static bool RansDecode(const unsigned char*& p, const unsigned char* end, unsigned char* outBytes, size_t n)
+{
+    unsigned char present[32];
+    if (!GetBytes(p, end, present, sizeof(present))) {
+        return false;
+    }
+
+    uint32_t freq[256] = {}, start[256];
+    uint32_t cumulative = 0;
+    for (int s = 0; s < 256; s++) {
+        start[s] = cumulative;
+        if (present[s >> 3] & (1 << (s & 7))) {
+            uint32_t v = 0;
+            for (int shift = 0;; shift += 7) {
+                if (p >= end || shift > 14) {
+                    return false;
+                }
+                unsigned char b = *p++;
+                v |= static_cast<uint32_t>(b & 0x7f) << shift;
+                if (!(b & 0x80)) {
+                    break;
+                }
+            }
+            freq[s] = v + 1;
+            cumulative += freq[s];
+        }
+    }
+    if (cumulative != RANS_PROB_SCALE) {
+        return false;
+    }
+
+    unsigned char slotSymbol[RANS_PROB_SCALE];
+    for (int s = 0; s < 256; s++) {
+        std::memset(slotSymbol + start[s], s, freq[s]);
+    }
+
+    uint32_t streamBytes;
+    if (!GetBytes(p, end, &streamBytes, sizeof(streamBytes)) ||
+        streamBytes < 4 || static_cast<size_t>(end - p) < streamBytes) {
+        return false;
+    }
+    const unsigned char* in = p;
+    const unsigned char* inEnd = p + streamBytes;
+    p = inEnd;
+
+    uint32_t x = (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+        (static_cast<uint32_t>(in[2]) << 8) | in[3];
+    in += 4;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t slot = x & (RANS_PROB_SCALE - 1);
+        unsigned char s = slotSymbol[slot];
+        outBytes[i] = s;
+        x = freq[s] * (x >> RANS_PROB_BITS) + slot - start[s];
+        while (x < RANS_L) {
+            if (in >= inEnd) {
+                return false;
+            }
+            x = (x << 8) | *in++;
+        }
+    }
+    return in == inEnd;
+}
+
+// ==================================================
+// CHUNKS
+// ==================================================
+
+// four byte planes of the zigzagged residuals
+static void EncodePlanes(const uint32_t* residuals, size_t n, std::vector<unsigned char>& out)
+{
+    std::vector<unsigned char> plane(n);
+    for (int b = 0; b < 4; b++) {
+        bool constant = true;
+        for (size_t i = 0; i < n; i++) {
+            plane[i] = static_cast<unsigned char>(residuals[i] >> (8 * b));
+            constant = constant && plane[i] == plane[0];
+        }
+
+        if (constant) {
+            out.push_back(PLANE_CONSTANT);
+            out.push_back(plane[0]);
+        }
+        else if (!RansEncode(plane.data(), n, out)) {
+            out.push_back(PLANE_STORED);
+            out.insert(out.end(), plane.begin(), plane.end());
+        }
+    }
+}
+
+static bool DecodePlanes(const unsigned char*& p, const unsigned char* end, uint32_t* residuals, size_t n)
+{
+    std::vector<unsigned char> plane(n);
+    std::fill(residuals, residuals + n, 0u);
+    for (int b = 0; b < 4; b++) {
+        if (p >= end) {
+            return false;
+        }
+        unsigned char kind = *p++;
+        if (kind == PLANE_CONSTANT) {
+            if (p >= end) {
+                return false;
+            }
+            std::fill(plane.begin(), plane.end(), *p++);
+        }
+        else if (kind == PLANE_STORED) {
+            if (!GetBytes(p, end, plane.data(), n)) {
+                return false;
+            }
+        }
+        else if (kind != PLANE_RANS || !RansDecode(p, end, plane.data(), n)) {
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            residuals[i] |= static_cast<uint32_t>(plane[i]) << (8 * b);
+        }
+    }
+    return true;
+}
+
+// quantization indices of a lossy chunk, false if any value would miss
+// the bound or overflow the index range
+static bool Quantize(const float* in, size_t n, float errorBound, int32_t* q)
+{
+    if (!(errorBound > 0.0f)) {
+        return false;
+    }
+    double step = 2.0 * errorBound;
+    for (size_t i = 0; i < n; i++) {
+        double scaled = std::nearbyint(in[i] / step);
+        if (!(std::fabs(scaled) < 1073741824.0)) {
+            return false;
+        }
+        q[i] = static_cast<int32_t>(scaled);
+        // the decoder computes exactly this, so the bound is checked on
+        // the value it will see
+        float restored = static_cast<float>(q[i] * step);
+        if (!(std::fabs(restored - in[i]) <= errorBound)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void EncodeChunk(const float* in, size_t n, CodecMode mode, float errorBound, std::vector<unsigned char>& out)
+{
+    std::vector<uint32_t> residuals(n);
+
+    if (mode == CodecMode::LOSSY) {
+        std::vector<int32_t> q(n);
+        if (Quantize(in, n, errorBound, q.data())) {
+            uint32_t prev = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t value = static_cast<uint32_t>(q[i]);
+                residuals[i] = Zigzag(value - prev);
+                prev = value;
+            }
+            out.push_back(static_cast<unsigned char>(CodecMode::LOSSY));
+            EncodePlanes(residuals.data(), n, out);
+            return;
+        }
+        mode = CodecMode::LOSSLESS;
+    }
+
+    if (mode == CodecMode::LOSSLESS || mode == CodecMode::RESIDUAL) {
+        size_t begin = out.size();
+        uint32_t prev = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t bits;
+            std::memcpy(&bits, in + i, sizeof(bits));
+            residuals[i] = (mode == CodecMode::RESIDUAL) ? bits : Zigzag(bits - prev);
+            prev = bits;
+        }
+        out.push_back(static_cast<unsigned char>(mode));
+        EncodePlanes(residuals.data(), n, out);
+        if (out.size() - begin < n * sizeof(float) + 1) {
+            return;
+        }
+        out.resize(begin);
+    }
+
+    out.push_back(static_cast<unsigned char>(CodecMode::RAW));
+    PutBytes(out, in, n * sizeof(float));
+}
+
+static bool DecodeChunk(const unsigned char* p, const unsigned char* end, float errorBound, float* out, size_t n)
+{
+    if (p >= end) {
+        return false;
+    }
+    CodecMode mode = static_cast<CodecMode>(*p++);
+
+    if (mode == CodecMode::RAW) {
+        return GetBytes(p, end, out, n * sizeof(float)) && p == end;
+    }
+    if (mode != CodecMode::LOSSLESS && mode != CodecMode::LOSSY && mode != CodecMode::RESIDUAL) {
+        return false;
+    }
+
+    std::vector<uint32_t> residuals(n);
+    if (!DecodePlanes(p, end, residuals.data(), n) || p != end) {
+        return false;
+    }
+
+    uint32_t prev = 0;
+    if (mode == CodecMode::RESIDUAL) {
+        std::memcpy(out, residuals.data(), n * sizeof(float));
+    }
+    else if (mode == CodecMode::LOSSLESS) {
+        for (size_t i = 0; i < n; i++) {
+            prev += Unzigzag(residuals[i]);
+            std::memcpy(out + i, &prev, sizeof(prev));
+        }
+    }
+    else {
+        double step = 2.0 * errorBound;
+        for (size_t i = 0; i < n; i++) {
+            prev += Unzigzag(residuals[i]);
+            out[i] = static_cast<float>(static_cast<int32_t>(prev) * step);
+        }
+    }
+    return true;
+}
+
+// ==================================================
+// FIELD CODEC
+// ==================================================
+
+void FieldCodec::Encode(const float* data, size_t count, const CodecOptions& options,
+    ThreadPool* pool, std::vector<unsigned char>& out)
+{
+    TRACE_SCOPE("EncodeField");
+
+    size_t chunkValues = static_cast<size_t>(std::min(std::max(options.chunkValues, 1), FIELD_CODEC_MAX_CHUNK));
+    uint32_t chunkCount = static_cast<uint32_t>((count + chunkValues - 1) / chunkValues);
+
+    out.push_back(static_cast<unsigned char>(options.mode));
+    out.insert(out.end(), 3, 0);
+    PutBytes(out, &options.errorBound, sizeof(float));
+    PutU32(out, static_cast<uint32_t>(chunkValues));
+    PutU32(out, chunkCount);
+
+    std::vector<std::vector<unsigned char>> chunks(chunkCount);
+    auto encodeChunks = [&](int begin, int end) {
+        for (int c = begin; c < end; c++) {
+            size_t first = c * chunkValues;
+            size_t n = std::min(chunkValues, count - first);
+            EncodeChunk(data + first, n, options.mode, options.errorBound, chunks[c]);
+        }
+    };
+    if (pool && chunkCount > 1) {
+        pool->ParallelFor(static_cast<int>(chunkCount), encodeChunks);
+    }
+    else {
+        encodeChunks(0, static_cast<int>(chunkCount));
+    }
+
+    for (const std::vector<unsigned char>& chunk : chunks) {
+        PutU32(out, static_cast<uint32_t>(chunk.size()));
+    }
+    for (const std::vector<unsigned char>& chunk : chunks) {
+        out.insert(out.end(), chunk.begin(), chunk.end());
+    }
+}
+
+bool FieldCodec::CheckCount(const unsigned char* data, size_t bytes, size_t count)
+{
+    uint32_t chunkValues, chunkCount;
+    if (bytes < STREAM_HEADER_BYTES) {
+        return false;
+    }
+    std::memcpy(&chunkValues, data + 8, sizeof(chunkValues));
+    std::memcpy(&chunkCount, data + 12, sizeof(chunkCount));
+    // capped chunks bound count by the table size, so a short stream
+    // cannot claim a huge field
+    if (chunkValues == 0 || chunkValues > FIELD_CODEC_MAX_CHUNK ||
+        chunkCount != (count + chunkValues - 1) / chunkValues ||
+        static_cast<uint64_t>(chunkCount) * 4 > bytes - STREAM_HEADER_BYTES) {
+        return false;
+    }
+
+    // every chunk holds at least its mode byte and all fit after the table
+    uint64_t payloadBytes = bytes - STREAM_HEADER_BYTES - static_cast<uint64_t>(chunkCount) * 4;
+    uint64_t total = 0;
+    const unsigned char* table = data + STREAM_HEADER_BYTES;
+    for (uint32_t c = 0; c < chunkCount; c++) {
+        uint32_t chunkBytes;
+        std::memcpy(&chunkBytes, table + 4 * static_cast<size_t>(c), sizeof(chunkBytes));
+        total += chunkBytes;
+        if (chunkBytes == 0 || total > payloadBytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FieldCodec::Decode(const unsigned char* data, size_t bytes, float* out, size_t count, ThreadPool* pool)
+{
+    TRACE_SCOPE("DecodeField");
+
+    const unsigned char* p = data;
+    const unsigned char* end = data + bytes;
+    if (!CheckCount(data, bytes, count)) {
+        return false;
+    }
+    float errorBound;
+    uint32_t chunkValues = 0, chunkCount = 0;
+    p += 4;
+    GetBytes(p, end, &errorBound, sizeof(errorBound));
+    GetBytes(p, end, &chunkValues, sizeof(chunkValues));
+    GetBytes(p, end, &chunkCount, sizeof(chunkCount));
+
+    // chunk table, turned into offsets so chunks can be decoded in any order
+    std::vector<const unsigned char*> chunkBegin(chunkCount + 1);
+    const unsigned char* payload = p + 4 * static_cast<size_t>(chunkCount);
+    chunkBegin[0] = payload;
+    for (uint32_t c = 0; c < chunkCount; c++) {
+        uint32_t chunkBytes;
+        if (!GetBytes(p, end, &chunkBytes, sizeof(chunkBytes)) ||
+            static_cast<size_t>(end - chunkBegin[c]) < chunkBytes) {
+            return false;
+        }
+        chunkBegin[c + 1] = chunkBegin[c] + chunkBytes;
+    }
+
+    std::atomic<bool> ok{ true };
+    auto decodeChunks = [&](int begin, int endChunk) {
+        for (int c = begin; c < endChunk; c++) {
+            size_t first = static_cast<size_t>(c) * chunkValues;
+            size_t n = std::min<size_t>(chunkValues, count - first);
+            if (!DecodeChunk(chunkBegin[c], chunkBegin[c + 1], errorBound, out + first, n)) {
+                ok = false;
+            }
+        }
+    };
+    if (pool && chunkCount > 1) {
+        pool->ParallelFor(static_cast<int>(chunkCount), decodeChunks);
+    }
+    else {
+        decodeChunks(0, static_cast<int>(chunkCount));
+    }
+    return ok;
+}
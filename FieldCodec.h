@@ -0,0 +1,60 @@
+#ifndef FIELDCODEC_H
+#define FIELDCODEC_H
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// values per independently coded chunk
+#define FIELD_CODEC_CHUNK 65536
+// largest chunk the encoder writes, streams claiming more are corrupt
+#define FIELD_CODEC_MAX_CHUNK (1 << 20)
+
+enum class CodecMode : unsigned char {
+    RAW,        // plain floats
+    LOSSLESS,   // delta of the float bits, byte shuffle, rANS
+    LOSSY,      // quantized to within errorBound, delta, byte shuffle, rANS
+    RESIDUAL    // bits already a residual (e.g. against the last frame), byte shuffle, rANS
+};
+
+struct CodecOptions {
+    CodecMode mode = CodecMode::LOSSLESS;
+    // largest absolute error of any value in LOSSY mode
+    float errorBound = 1e-4f;
+    // clamped to 1 .. FIELD_CODEC_MAX_CHUNK
+    int chunkValues = FIELD_CODEC_CHUNK;
+};
+
+// chunked float array compression. every chunk is coded on its own, so
+// chunks encode and decode in parallel on a ThreadPool and a corrupt chunk
+// does not take the rest of the array with it.
+//
+// a chunk stores the zigzagged difference of consecutive values (float bits
+// or quantization indices) split into four byte planes, each plane coded
+// with a static order-0 rANS model. smooth fields leave the high planes
+// nearly constant, which is where most of the ratio comes from. a lossy
+// chunk that cannot meet the bound (non-finite values, huge range) falls
+// back to lossless, a chunk that does not shrink is stored raw.
+class FieldCodec {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // append count encoded values to out. pool may be nullptr
+    static void Encode(const float* data, size_t count, const CodecOptions& options,
+        ThreadPool* pool, std::vector<unsigned char>& out);
+
+    // decode exactly count values, false if the stream is corrupt
+    static bool Decode(const unsigned char* data, size_t bytes, float* out, size_t count, ThreadPool* pool);
+
+    // true if the stream's chunk table holds count values in chunks that
+    // fit in bytes, so a count read from a file can be checked before
+    // allocating for it
+    static bool CheckCount(const unsigned char* data, size_t bytes, size_t count);
+};
+
+#endif // FIELDCODEC_H
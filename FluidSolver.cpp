@@ -1,10 +1,59 @@
 #include "FluidSolver.h"
+#include "AsyncFieldWriter.h"
+#include "Checkpoint.h"
+#include "InputLog.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
+// bilinear sample of an (nx + 2) x (ny + 2) array at grid position (x, y), clamped to the interior
+static inline float SampleBilinear(const float* f, int nx, int ny, float x, float y)
+{
+    if (x < 0.5f) x = 0.5f;
+    if (x > nx + 0.5f) x = nx + 0.5f;
+    if (y < 0.5f) y = 0.5f;
+    if (y > ny + 0.5f) y = ny + 0.5f;
+
+    int i0 = static_cast<int>(x);
+    int j0 = static_cast<int>(y);
+    float s1 = x - i0;
+    float t1 = y - j0;
+    const float* row0 = f + i0 + (nx + 2) * j0;
+    const float* row1 = row0 + (nx + 2);
+
+    return (1.0f - s1) * ((1.0f - t1) * row0[0] + t1 * row1[0]) +
+        s1 * ((1.0f - t1) * row0[1] + t1 * row1[1]);
+}
+
 // constructor
-FluidSolver::FluidSolver(int n, BoundaryCondition b) : N(n), grid(n), bc(b)
+FluidSolver::FluidSolver(int n, BoundaryCondition b, int velocityScale) : FluidSolver(n, n, b, velocityScale)
+{
+}
+
+// constructor for rectangular domains
+FluidSolver::FluidSolver(int nx, int ny, BoundaryCondition b, int velocityScale, float hx, float hy)
+    : NX(nx), NY(ny), grid(nx, ny, velocityScale), bc(b)
+{
+    // square cells with the longer side of the domain at unit length by default
+    float h = 1.0f / std::max(NX, NY);
+    this->hx = (hx > 0.0f) ? hx : h;
+    this->hy = (hy > 0.0f) ? hy : h;
+
+    MarkAllDirty();
+
+    std::cout << "FluidSolver constructor called. Initializing with " << NX << "x" << NY
+        << ", hx = " << this->hx << ", hy = " << this->hy << "." << std::endl;
+}
+
+// constructor from a mapped checkpoint
+FluidSolver::FluidSolver(const CheckpointHeader& header, MappedFile* mapping, float* const fields[6])
+    : NX(header.nx), NY(header.ny), grid(header.nx, header.ny, header.velocityScale, mapping, fields),
+    bc(static_cast<BoundaryCondition>(header.boundary)), hx(header.hx), hy(header.hy),
+    dt(header.dt), diff(header.diff), activityThreshold(header.activityThreshold), stepCount(header.stepCount)
 {
-    std::cout << "FluidSolver constructor called. Initializing with N = " << N << "." << std::endl;
+    MarkAllDirty();
+
+    std::cout << "FluidSolver restored at step " << stepCount << " with " << NX << "x" << NY << "." << std::endl;
 }
 
 // destructor
@@ -14,20 +63,35 @@ FluidSolver::~FluidSolver() {
 
 void FluidSolver::AddInputToField(FieldType fieldType, int i, int j, float s)
 {
+    if (recorder) {
+        recorder->Record(stepCount, fieldType, i, j, s);
+    }
+
     // calculate the index in the array using the IX function from Grid
     int index = IX(i, j);
 
+    // velocity input lands in the coarse cell covering (i, j), spread over
+    // its area so the injected momentum matches a full resolution grid
+    int iv = (i - 1) / grid.velocityScale + 1;
+    int jv = (j - 1) / grid.velocityScale + 1;
+    int indexV = iv + (grid.NVX + 2) * jv;
+    float sv = s / (grid.velocityScale * grid.velocityScale);
+
     switch (fieldType) {
     case DENSITY:
         grid.dens[index] += s * dt;
+        grid.mask.MarkCell(i, j);
+        MarkDirty(grid.mask.GetTileOf(i, j));
         break;
 
     case VELOCITY_U:
-        grid.u[index] += s * dt;
+        grid.u[indexV] += sv * dt;
+        grid.velMask.MarkCell(iv, jv);
         break;
 
     case VELOCITY_V:
-        grid.v[index] += s * dt;
+        grid.v[indexV] += sv * dt;
+        grid.velMask.MarkCell(iv, jv);
         break;
 
     default:
@@ -36,7 +100,87 @@ void FluidSolver::AddInputToField(FieldType fieldType, int i, int j, float s)
     }
 }
 
-// set boundary conditions (Dirichlet, Neumann, Periodic)
+// cell spacing of the grid holding a field
+void FluidSolver::FieldSpacing(FieldType fieldType, float& fx, float& fy) const
+{
+    float scale = (fieldType == DENSITY) ? 1.0f : static_cast<float>(grid.velocityScale);
+    fx = hx * scale;
+    fy = hy * scale;
+}
+
+// rebuild the active tile list and clear tiles that went quiescent
+void FluidSolver::UpdateActivity()
+{
+    ScopedPhaseTimer timer(profiler, PHASE_UPDATE_ACTIVITY);
+
+    grid.velMask.Update();
+
+    // retired tiles only hold values below the threshold, zeroing them keeps
+    // every inactive tile exactly zero so skipping it is exact
+    const int* retired = grid.velMask.GetRetiredTiles();
+    for (int t = 0; t < grid.velMask.GetRetiredCount(); t++) {
+        grid.ClearVelocityTile(retired[t]);
+    }
+
+    // density can be carried into any cell where the velocity is active
+    const int* tiles = grid.velMask.GetActiveTiles();
+    int s = grid.velocityScale;
+    int i0, i1, j0, j1;
+    for (int t = 0; t < grid.velMask.GetActiveCount(); t++) {
+        grid.velMask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+        grid.mask.MarkRange((i0 - 1) * s + 1, i1 * s, (j0 - 1) * s + 1, j1 * s);
+    }
+
+    grid.mask.Update();
+
+    retired = grid.mask.GetRetiredTiles();
+    for (int t = 0; t < grid.mask.GetRetiredCount(); t++) {
+        grid.ClearDensityTile(retired[t]);
+        MarkDirty(retired[t]);
+        if (display) {
+            grid.mask.GetTileBounds(retired[t], i0, i1, j0, j1);
+            UpdateDisplay(i0, i1, j0, j1);
+        }
+    }
+}
+
+void FluidSolver::MarkAllDirty()
+{
+    dirtyFlags.assign(grid.mask.GetTileCount(), 1);
+    dirtyTiles.resize(grid.mask.GetTileCount());
+    for (int t = 0; t < grid.mask.GetTileCount(); t++) {
+        dirtyTiles[t] = t;
+    }
+}
+
+void FluidSolver::ClearDirtyTiles()
+{
+    for (int tile : dirtyTiles) {
+        dirtyFlags[tile] = 0;
+    }
+    dirtyTiles.clear();
+}
+
+void FluidSolver::SetDisplayOutput(void* buffer, DisplayFormat format, float scale)
+{
+    display = static_cast<unsigned char*>(buffer);
+    displayFormat = format;
+    displayScale = scale;
+    if (display) {
+        UpdateDisplay(0, NX + 1, 0, NY + 1);
+    }
+}
+
+void FluidSolver::UpdateDisplay(int i0, int i1, int j0, int j1)
+{
+    int bytes = DisplayBytesPerTexel(displayFormat);
+    for (int j = j0; j <= j1; j++) {
+        ConvertForDisplay(grid.dens + IX(i0, j), display + static_cast<size_t>(IX(i0, j)) * bytes,
+            i1 - i0 + 1, displayFormat, displayScale);
+    }
+}
+
+// set boundary conditions of a solver field
 void FluidSolver::SetBoundary(FieldType fieldType)
 {
     float* x;
@@ -55,20 +199,34 @@ void FluidSolver::SetBoundary(FieldType fieldType)
         return;
     }
 
+    // dimensions of the grid holding this field
+    int NX, NY;
+    grid.FieldDims(fieldType, NX, NY);
+    SetBoundary(x, NX, NY);
+}
+
+// set boundary conditions (Dirichlet, Neumann, Periodic) of an NX x NY
+// array, also the pressure scratch arrays
+void FluidSolver::SetBoundary(float* x, int NX, int NY)
+{
+    ScopedPhaseTimer timer(profiler, PHASE_SET_BOUNDARY);
+
     switch (bc) {
     case BoundaryCondition::DIRICHLET:
         // Dirichlet  (fixed boundary values)
-        for (int i = 1; i <= N; i++) {
-            x[IX(0, i)] = 0.0f;             // Left boundary
-            x[IX(N + 1, i)] = 0.0f;         // Right boundary
+        for (int j = 1; j <= NY; j++) {
+            x[IX(0, j)] = 0.0f;             // Left boundary
+            x[IX(NX + 1, j)] = 0.0f;        // Right boundary
+        }
+        for (int i = 1; i <= NX; i++) {
             x[IX(i, 0)] = 0.0f;             // Bottom boundary
-            x[IX(i, N + 1)] = 0.0f;         // Top boundary
+            x[IX(i, NY + 1)] = 0.0f;        // Top boundary
         }
         // Handle the corners
         x[IX(0, 0)] = 0.0f;                // Bottom-left corner
-        x[IX(0, N + 1)] = 0.0f;            // Top-left corner
-        x[IX(N + 1, 0)] = 0.0f;            // Bottom-right corner
-        x[IX(N + 1, N + 1)] = 0.0f;        // Top-right corner
+        x[IX(0, NY + 1)] = 0.0f;           // Top-left corner
+        x[IX(NX + 1, 0)] = 0.0f;           // Bottom-right corner
+        x[IX(NX + 1, NY + 1)] = 0.0f;      // Top-right corner
         break;
 
     case BoundaryCondition::NEUMANN:
@@ -90,7 +248,19 @@ void FluidSolver::SetBoundary(FieldType fieldType)
 // diffuse function using Gauss-Seidel relaxation
 void FluidSolver::Diffuse(FieldType fieldType, int NumIters)
 {
-    float a = dt * diff * N * N;
+    ProfilePhase phase = (fieldType == DENSITY) ? PHASE_DIFFUSE_DENSITY : PHASE_DIFFUSE_VELOCITY;
+    ScopedPhaseTimer timer(profiler, phase);
+
+    // dimensions, spacing and activity of the grid holding this field
+    int NX, NY;
+    float hx, hy;
+    grid.FieldDims(fieldType, NX, NY);
+    FieldSpacing(fieldType, hx, hy);
+    ActivityMask& mask = grid.FieldMask(fieldType);
+
+    float ax = dt * diff / (hx * hx);
+    float ay = dt * diff / (hy * hy);
+    float c = 1 + 2 * ax + 2 * ay;
     float* x, * x0;
 
     // Determine which field we're working with
@@ -112,21 +282,46 @@ void FluidSolver::Diffuse(FieldType fieldType, int NumIters)
         return;
     }
 
-    // Gauss-Seidel relaxation
+    const int* tiles = mask.GetActiveTiles();
+    int numTiles = mask.GetActiveCount();
+    int i0, i1, j0, j1;
+
+    // Gauss-Seidel relaxation over the active tiles
     for (int k = 0; k < NumIters; k++) { // typically 20 iterations for convergence
-        for (int i = 1; i <= N; i++) {
-            for (int j = 1; j <= N; j++) {
-                x[IX(i, j)] = (x0[IX(i, j)] + a * (x[IX(i - 1, j)] + x[IX(i + 1, j)] +
-                    x[IX(i, j - 1)] + x[IX(i, j + 1)])) / (1 + 4 * a);
+        for (int t = 0; t < numTiles; t++) {
+            mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+            for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i++) {
+                    x[IX(i, j)] = (x0[IX(i, j)] + ax * (x[IX(i - 1, j)] + x[IX(i + 1, j)]) +
+                        ay * (x[IX(i, j - 1)] + x[IX(i, j + 1)])) / c;
+                }
             }
         }
         // apply boundary condition
         SetBoundary(fieldType);
     }
+
+    // max-norm residual of (c - ax - ay) x = x0 after the last sweep
+    float residual = 0.0f;
+    if (profiler.IsTrackingResiduals()) {
+        for (int t = 0; t < numTiles; t++) {
+            mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+            for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i++) {
+                    float r = x0[IX(i, j)] + ax * (x[IX(i - 1, j)] + x[IX(i + 1, j)]) +
+                        ay * (x[IX(i, j - 1)] + x[IX(i, j + 1)]) - c * x[IX(i, j)];
+                    residual = std::max(residual, std::fabs(r));
+                }
+            }
+        }
+    }
+    profiler.RecordSolve(phase, NumIters, residual);
 }
 
 void FluidSolver::Advect(FieldType fieldType)
 {
+    ScopedPhaseTimer timer(profiler, (fieldType == DENSITY) ? PHASE_ADVECT_DENSITY : PHASE_ADVECT_VELOCITY);
+
     float* d, * d0, * u, * v;
 
     switch (fieldType) {
@@ -147,41 +342,96 @@ void FluidSolver::Advect(FieldType fieldType)
         return;
     }
 
-    // use the velocity fields for advection
-    u = grid.u;
-    v = grid.v;
-
-    float dt0 = dt * N;
+    // density is carried by the current velocity, velocity by the projected
+    // velocity left in the previous buffers
+    bool density = (fieldType == DENSITY);
+    u = density ? grid.u : grid.u_prev;
+    v = density ? grid.v : grid.v_prev;
+
+    // dimensions, spacing and activity of the grid holding this field
+    int NX, NY;
+    float hx, hy;
+    grid.FieldDims(fieldType, NX, NY);
+    FieldSpacing(fieldType, hx, hy);
+    ActivityMask& mask = grid.FieldMask(fieldType);
+
+    // density on a finer grid than velocity interpolates the coarse velocity
+    bool upsample = (NX != grid.NVX);
+    float scale = 1.0f / grid.velocityScale;
+
+    // velocity to cells per step along each axis
+    float dt0x = dt / hx;
+    float dt0y = dt / hy;
     int i0, j0, i1, j1;
     float x, y, s0, t0, s1, t1;
 
-    for (int i = 1; i <= N; i++) {
-        for (int j = 1; j <= N; j++) {
-            x = i - dt0 * u[IX(i, j)];
-            y = j - dt0 * v[IX(i, j)];
-
-            if (x < 0.5f) x = 0.5f;
-            if (x > N + 0.5f) x = N + 0.5f;
-            i0 = static_cast<int>(x);
-            i1 = i0 + 1;
+    const int* tiles = mask.GetActiveTiles();
+    int numTiles = mask.GetActiveCount();
+    int ti0, ti1, tj0, tj1;
+
+    for (int t = 0; t < numTiles; t++) {
+        mask.GetTileBounds(tiles[t], ti0, ti1, tj0, tj1);
+        float maxAbs = 0.0f;
+
+        for (int j = tj0; j <= tj1; j++) {
+            for (int i = ti0; i <= ti1; i++) {
+                if (upsample) {
+                    // fine cell centre in coarse grid coordinates
+                    float xv = (i - 0.5f) * scale + 0.5f;
+                    float yv = (j - 0.5f) * scale + 0.5f;
+                    x = i - dt0x * SampleBilinear(u, grid.NVX, grid.NVY, xv, yv);
+                    y = j - dt0y * SampleBilinear(v, grid.NVX, grid.NVY, xv, yv);
+                }
+                else {
+                    x = i - dt0x * u[IX(i, j)];
+                    y = j - dt0y * v[IX(i, j)];
+                }
+
+                if (x < 0.5f) x = 0.5f;
+                if (x > NX + 0.5f) x = NX + 0.5f;
+                i0 = static_cast<int>(x);
+                i1 = i0 + 1;
+
+                if (y < 0.5f) y = 0.5f;
+                if (y > NY + 0.5f) y = NY + 0.5f;
+                j0 = static_cast<int>(y);
+                j1 = j0 + 1;
+
+                s1 = x - i0;
+                s0 = 1.0f - s1;
+                t1 = y - j0;
+                t0 = 1.0f - t1;
+
+                d[IX(i, j)] = s0 * (t0 * d0[IX(i0, j0)] + t1 * d0[IX(i0, j1)]) +
+                    s1 * (t0 * d0[IX(i1, j0)] + t1 * d0[IX(i1, j1)]);
+                maxAbs = std::max(maxAbs, std::fabs(d[IX(i, j)]));
+            }
+        }
 
-            if (y < 0.5f) y = 0.5f;
-            if (y > N + 0.5f) y = N + 0.5f;
-            j0 = static_cast<int>(y);
-            j1 = j0 + 1;
+        // keep the tile alive while the advected field is above the threshold
+        if (maxAbs > activityThreshold) {
+            mask.MarkTile(tiles[t]);
+        }
 
-            s1 = x - i0;
-            s0 = 1.0f - s1;
-            t1 = y - j0;
-            t0 = 1.0f - t1;
+        if (fieldType == DENSITY) {
+            MarkDirty(tiles[t]);
 
-            d[IX(i, j)] = s0 * (t0 * d0[IX(i0, j0)] + t1 * d0[IX(i0, j1)]) +
-                s1 * (t0 * d0[IX(i1, j0)] + t1 * d0[IX(i1, j1)]);
+            // convert the display copy while the tile is still in cache
+            if (display) {
+                UpdateDisplay(ti0, ti1, tj0, tj1);
+            }
         }
     }
 
     // apply the boundary
     SetBoundary(fieldType);
+
+    if (fieldType == DENSITY && display) {
+        UpdateDisplay(0, NX + 1, 0, 0);
+        UpdateDisplay(0, NX + 1, NY + 1, NY + 1);
+        UpdateDisplay(0, 0, 1, NY);
+        UpdateDisplay(NX + 1, NX + 1, 1, NY);
+    }
 }
 
 void FluidSolver::StepDensity()
@@ -190,7 +440,7 @@ void FluidSolver::StepDensity()
     grid.SwapBuffers(DENSITY);
 
     // diffuse the density
-    Diffuse(DENSITY);
+    Diffuse(DENSITY, relaxIterations);
 
     // swap the buffers again to prepare for the advection step
     grid.SwapBuffers(DENSITY);
@@ -201,42 +451,93 @@ void FluidSolver::StepDensity()
 
 void FluidSolver::Project()
 {
-    int i, j, k;
-    float h = 1.0f / N;
+    ScopedPhaseTimer timer(profiler, PHASE_PROJECT);
+
+    // pressure lives on the velocity grid
+    int NX = grid.NVX;
+    int NY = grid.NVY;
+    float hx, hy;
+    FieldSpacing(VELOCITY_U, hx, hy);
+    ActivityMask& mask = grid.velMask;
+
+    // axis weights of the 5-point Laplacian, both 1 for square cells so
+    // div and p keep the scaling of the isotropic solver
+    float ax = 1.0f / (hx * hx);
+    float ay = 1.0f / (hy * hy);
+    float wx = 2 * ax / (ax + ay);
+    float wy = 2 * ay / (ax + ay);
+
+    int i, j, k, t;
     float* u = grid.u;
     float* v = grid.v;
     float* p = grid.u_prev; // u_prev to store pressure temporarily
     float* div = grid.v_prev; // v_prev to store divergence temporarily
 
+    const int* tiles = mask.GetActiveTiles();
+    int numTiles = mask.GetActiveCount();
+    int i0, i1, j0, j1;
+
     // compute divergence of the velocity field
-    for (i = 1; i <= N; i++) {
-        for (j = 1; j <= N; j++) {
-            div[IX(i, j)] = -0.5f * h * (u[IX(i + 1, j)] - u[IX(i - 1, j)] +
-                v[IX(i, j + 1)] - v[IX(i, j - 1)]);
-            p[IX(i, j)] = 0;
+    for (t = 0; t < numTiles; t++) {
+        mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+        for (j = j0; j <= j1; j++) {
+            for (i = i0; i <= i1; i++) {
+                div[IX(i, j)] = -((u[IX(i + 1, j)] - u[IX(i - 1, j)]) / hx +
+                    (v[IX(i, j + 1)] - v[IX(i, j - 1)]) / hy) / (ax + ay);
+                p[IX(i, j)] = 0;
+            }
         }
     }
 
     // apply boundary conditions to div and p
-    SetBoundary(DENSITY); // for div
-    SetBoundary(DENSITY); // for p
+    SetBoundary(div, NX, NY);
+    SetBoundary(p, NX, NY);
 
     // solve for the pressure using Gauss-Seidel relaxation
-    for (k = 0; k < 20; k++) {
-        for (i = 1; i <= N; i++) {
-            for (j = 1; j <= N; j++) {
-                p[IX(i, j)] = (div[IX(i, j)] + p[IX(i - 1, j)] + p[IX(i + 1, j)] +
-                    p[IX(i, j - 1)] + p[IX(i, j + 1)]) / 4.0f;
+    for (k = 0; k < relaxIterations; k++) {
+        for (t = 0; t < numTiles; t++) {
+            mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+            for (j = j0; j <= j1; j++) {
+                for (i = i0; i <= i1; i++) {
+                    p[IX(i, j)] = (div[IX(i, j)] + wx * (p[IX(i - 1, j)] + p[IX(i + 1, j)]) +
+                        wy * (p[IX(i, j - 1)] + p[IX(i, j + 1)])) / 4.0f;
+                }
+            }
+        }
+        SetBoundary(p, NX, NY); // apply boundary conditions to p after each iteration
+    }
+
+    // max-norm residual of the pressure equation after the last sweep
+    float residual = 0.0f;
+    if (profiler.IsTrackingResiduals()) {
+        for (t = 0; t < numTiles; t++) {
+            mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+            for (j = j0; j <= j1; j++) {
+                for (i = i0; i <= i1; i++) {
+                    float r = div[IX(i, j)] + wx * (p[IX(i - 1, j)] + p[IX(i + 1, j)]) +
+                        wy * (p[IX(i, j - 1)] + p[IX(i, j + 1)]) - 4.0f * p[IX(i, j)];
+                    residual = std::max(residual, std::fabs(r));
+                }
             }
         }
-        SetBoundary(DENSITY); // apply boundary conditions to p after each iteration
     }
+    profiler.RecordSolve(PHASE_PROJECT, k, residual);
 
     // subtract the pressure gradient from the velocity field
-    for (i = 1; i <= N; i++) {
-        for (j = 1; j <= N; j++) {
-            u[IX(i, j)] -= 0.5f * (p[IX(i + 1, j)] - p[IX(i - 1, j)]) / h;
-            v[IX(i, j)] -= 0.5f * (p[IX(i, j + 1)] - p[IX(i, j - 1)]) / h;
+    for (t = 0; t < numTiles; t++) {
+        mask.GetTileBounds(tiles[t], i0, i1, j0, j1);
+        float maxAbs = 0.0f;
+        for (j = j0; j <= j1; j++) {
+            for (i = i0; i <= i1; i++) {
+                u[IX(i, j)] -= 0.5f * (p[IX(i + 1, j)] - p[IX(i - 1, j)]) / hx;
+                v[IX(i, j)] -= 0.5f * (p[IX(i, j + 1)] - p[IX(i, j - 1)]) / hy;
+                maxAbs = std::max(maxAbs, std::max(std::fabs(u[IX(i, j)]), std::fabs(v[IX(i, j)])));
+            }
+        }
+
+        // projection can spread velocity into tiles advection left quiet
+        if (maxAbs > activityThreshold) {
+            mask.MarkTile(tiles[t]);
         }
     }
 
@@ -251,8 +552,8 @@ void FluidSolver::StepVelocity()
     grid.SwapBuffers(VELOCITY_U);
     grid.SwapBuffers(VELOCITY_V);
 
-    Diffuse(VELOCITY_U, 20);
-    Diffuse(VELOCITY_V, 20);
+    Diffuse(VELOCITY_U, relaxIterations);
+    Diffuse(VELOCITY_V, relaxIterations);
 
     // project the velocity field to ensure it's divergence-free
     Project();
@@ -271,9 +572,24 @@ void FluidSolver::StepVelocity()
 
 void FluidSolver::Step()
 {
-    // step velocity field
-    StepVelocity();
+    {
+        ScopedPhaseTimer timer(profiler, PHASE_STEP);
+
+        // decide which tiles this step visits
+        UpdateActivity();
 
-    // step density field
-    StepDensity();
+        // step velocity field
+        StepVelocity();
+
+        // step density field
+        StepDensity();
+    }
+
+    profiler.EndStep();
+    stepCount++;
+
+    // the writer copies the field, the solver does not wait for the disk
+    if (output && stepCount % outputCadence == 0) {
+        output->Submit(stepCount, NX, NY, grid.dens);
+    }
 }
\ No newline at end of file
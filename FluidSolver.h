@@ -1,7 +1,15 @@
 #ifndef FLUIDSOLVER_H
 #define FLUIDSOLVER_H
 
+#include <vector>
+#include "DisplayConvert.h"
 #include "Grid.h"
+#include "SolverProfiler.h"
+
+class AsyncFieldWriter;
+class InputRecorder;
+class MappedFile;
+struct CheckpointHeader;
 
 enum class BoundaryCondition {
     DIRICHLET,
@@ -22,8 +30,12 @@ public:
     // FUNCTIONS
     // ==================================================
 
-    // constructor
-    FluidSolver(int n, BoundaryCondition b);
+    // constructor, velocityScale = 2 or 4 runs velocity and Project at N / velocityScale
+    FluidSolver(int n, BoundaryCondition b, int velocityScale = 1);
+
+    // constructor for an nx x ny domain, hx/hy <= 0 selects square cells
+    // of size 1 / max(nx, ny)
+    FluidSolver(int nx, int ny, BoundaryCondition b, int velocityScale = 1, float hx = 0.0f, float hy = 0.0f);
 
     // destructor
     ~FluidSolver();
@@ -34,10 +46,66 @@ public:
     // step
     void Step();
 
+    // steps taken since construction
+    long long GetStepCount() const { return stepCount; }
+
+    // every AddInputToField call is also passed to the recorder (nullptr to stop)
+    void SetInputRecorder(InputRecorder* inputRecorder) { recorder = inputRecorder; }
+
+    // hand a density snapshot to the writer after every `cadence` steps (nullptr to stop)
+    void SetFieldOutput(AsyncFieldWriter* writer, int cadence = 1) { output = writer; outputCadence = cadence > 0 ? cadence : 1; }
+
+    // keep a display copy of the density, (NX + 2) x (NY + 2) texels of
+    // value * scale in the given format, up to date after every Step. the
+    // conversion is fused into the density advection, so each tile is
+    // converted while it is still in cache (nullptr to stop)
+    void SetDisplayOutput(void* buffer, DisplayFormat format = DisplayFormat::HALF16, float scale = 1.0f);
+
+    // density tiles whose cells changed since the last ClearDirtyTiles:
+    // tiles that took input, were advected or were zeroed. the boundary ring
+    // only changes next to a dirty tile at the domain edge. all tiles start dirty
+    int GetDirtyTileCount() const { return static_cast<int>(dirtyTiles.size()); }
+    const int* GetDirtyTiles() const { return dirtyTiles.data(); }
+    int GetDensityTileCount() const { return grid.mask.GetTileCount(); }
+    void GetDensityTileBounds(int tile, int& i0, int& i1, int& j0, int& j1) const { grid.mask.GetTileBounds(tile, i0, i1, j0, j1); }
+    void ClearDirtyTiles();
+    // for callers that change what is shown for a tile without changing the
+    // density, e.g. interpolation between steps, so the display picks it up
+    void MarkDensityTileDirty(int tile) { MarkDirty(tile); }
+
     // getters for rendering
     float* GetDensity() const { return grid.GetDensity(); }
     float* GetVelocityU() const { return grid.GetVelocityU(); }
     float* GetVelocityV() const { return grid.GetVelocityV(); }
+    // density arrays are (GetNX() + 2) x (GetNY() + 2)
+    int GetNX() const { return NX; }
+    int GetNY() const { return NY; }
+    // velocity arrays are (GetVelocityNX() + 2) x (GetVelocityNY() + 2)
+    int GetVelocityNX() const { return grid.NVX; }
+    int GetVelocityNY() const { return grid.NVY; }
+    int GetVelocityScale() const { return grid.velocityScale; }
+    BoundaryCondition GetBoundaryCondition() const { return bc; }
+
+    // time step and diffusion coefficient, e.g. for parameter sweeps
+    void SetTimeStep(float timeStep) { dt = timeStep; }
+    void SetDiffusion(float diffusion) { diff = diffusion; }
+    float GetTimeStep() const { return dt; }
+    float GetDiffusion() const { return diff; }
+
+    // Gauss-Seidel sweeps of each diffusion and pressure solve, fewer trade
+    // accuracy for step time
+    void SetRelaxationIterations(int iterations) { relaxIterations = iterations > 1 ? iterations : 1; }
+    int GetRelaxationIterations() const { return relaxIterations; }
+
+    // activity mask: kernels skip tiles whose fields stay below the threshold
+    void SetActivityMaskEnabled(bool enable) { grid.mask.SetEnabled(enable); grid.velMask.SetEnabled(enable); }
+    bool IsActivityMaskEnabled() const { return grid.mask.IsEnabled(); }
+    void SetActivityThreshold(float threshold) { activityThreshold = threshold; }
+    int GetActiveTileCount() const { return grid.mask.GetActiveCount() + grid.velMask.GetActiveCount(); }
+
+    // per-phase timings, iteration counts and residuals of recent steps
+    SolverProfiler& GetProfiler() { return profiler; }
+    const SolverProfiler& GetProfiler() const { return profiler; }
 
 private:
 
@@ -46,27 +114,63 @@ private:
     // ==================================================
 
     // grid width/height (not including boundary)
-    int N;
+    int NX, NY;
     // Grid object to manage grid data
     Grid grid;
     // boundary condition
     BoundaryCondition bc;
+    // cell spacing of the density grid
+    float hx, hy;
 
     // delta time
     float dt = 0.8f;
     // diffusion coefficient
     float diff = 0.0001f;
+    // values below this count as quiescent for the activity mask
+    float activityThreshold = 1e-5f;
+    // relaxation sweeps per solve
+    int relaxIterations = 20;
+
+    SolverProfiler profiler;
+
+    long long stepCount = 0;
+    InputRecorder* recorder = nullptr;
+    AsyncFieldWriter* output = nullptr;
+    int outputCadence = 1;
+
+    unsigned char* display = nullptr;
+    DisplayFormat displayFormat = DisplayFormat::HALF16;
+    float displayScale = 1.0f;
+
+    // per-tile flag and list of the dirty density tiles
+    std::vector<unsigned char> dirtyFlags;
+    std::vector<int> dirtyTiles;
 
     // ==================================================
     // FUNCTIONS
     // ==================================================
 
+    // the benchmark times the private phases directly
+    friend class SolverBench;
+    friend class Checkpoint;
+    friend class EnsembleBatch;
+
+    // restore from a mapped checkpoint, see Checkpoint::Load
+    FluidSolver(const CheckpointHeader& header, MappedFile* mapping, float* const fields[6]);
+
+    void FieldSpacing(FieldType fieldType, float& fx, float& fy) const;
+    void UpdateActivity();
     void SetBoundary(FieldType fieldType);
+    void SetBoundary(float* x, int NX, int NY);
     void Diffuse(FieldType fieldType, int NumIters=20);
     void Advect(FieldType fieldType);
     void StepDensity();
     void Project();
     void StepVelocity();
+    // convert the inclusive density cell range i0..i1 x j0..j1 into the display copy
+    void UpdateDisplay(int i0, int i1, int j0, int j1);
+    void MarkDirty(int tile) { if (!dirtyFlags[tile]) { dirtyFlags[tile] = 1; dirtyTiles.push_back(tile); } }
+    void MarkAllDirty();
     
 };
 
@@ -0,0 +1,347 @@
+#include "FluidSolver3D.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// constructor
+FluidSolver3D::FluidSolver3D(int n, BoundaryCondition b, int numThreads)
+    : N(n), grid(n), bc(b), pool(numThreads)
+{
+    std::cout << "FluidSolver3D constructor called. Initializing with N = " << N
+        << " on " << pool.GetThreadCount() << " threads." << std::endl;
+}
+
+// destructor
+FluidSolver3D::~FluidSolver3D() {
+
+}
+
+float* FluidSolver3D::Field(FieldType fieldType) const
+{
+    switch (fieldType) {
+    case DENSITY: return grid.dens;
+    case VELOCITY_U: return grid.u;
+    case VELOCITY_V: return grid.v;
+    case VELOCITY_W: return grid.w;
+    default: return nullptr;
+    }
+}
+
+float* FluidSolver3D::PrevField(FieldType fieldType) const
+{
+    switch (fieldType) {
+    case DENSITY: return grid.dens_prev;
+    case VELOCITY_U: return grid.u_prev;
+    case VELOCITY_V: return grid.v_prev;
+    case VELOCITY_W: return grid.w_prev;
+    default: return nullptr;
+    }
+}
+
+void FluidSolver3D::AddInputToField(FieldType fieldType, int i, int j, int k, float s)
+{
+    float* x = Field(fieldType);
+    if (!x) {
+        std::cerr << "Error: Invalid field type." << std::endl;
+        return;
+    }
+    x[IX3(i, j, k)] += s * dt;
+}
+
+// set boundary conditions (Dirichlet, Neumann, Periodic) on all six faces
+void FluidSolver3D::SetBoundary(float* x)
+{
+    ScopedPhaseTimer timer(profiler, PHASE_SET_BOUNDARY);
+
+    switch (bc) {
+    case BoundaryCondition::DIRICHLET:
+        // Dirichlet (fixed boundary values), faces include edges and corners
+        for (int b = 0; b < N + 2; b++) {
+            for (int a = 0; a < N + 2; a++) {
+                x[IX3(0, a, b)] = 0.0f;         // x faces
+                x[IX3(N + 1, a, b)] = 0.0f;
+                x[IX3(a, 0, b)] = 0.0f;         // y faces
+                x[IX3(a, N + 1, b)] = 0.0f;
+                x[IX3(a, b, 0)] = 0.0f;         // z faces
+                x[IX3(a, b, N + 1)] = 0.0f;
+            }
+        }
+        break;
+
+    case BoundaryCondition::NEUMANN:
+    case BoundaryCondition::PERIODIC: {
+        // Neumann (zero gradient) copies the interior layer next to each
+        // face, periodic the layer at the opposite face. the faces are
+        // filled one axis after another, each across the ghost cells the
+        // axes before it filled, so edges and corners are consistent
+        bool wrap = (bc == BoundaryCondition::PERIODIC);
+        int low = wrap ? N : 1;
+        int high = wrap ? 1 : N;
+        for (int b = 1; b <= N; b++) {
+            for (int a = 1; a <= N; a++) {
+                x[IX3(0, a, b)] = x[IX3(low, a, b)];
+                x[IX3(N + 1, a, b)] = x[IX3(high, a, b)];
+            }
+        }
+        for (int b = 1; b <= N; b++) {
+            for (int a = 0; a < N + 2; a++) {
+                x[IX3(a, 0, b)] = x[IX3(a, low, b)];
+                x[IX3(a, N + 1, b)] = x[IX3(a, high, b)];
+            }
+        }
+        for (int b = 0; b < N + 2; b++) {
+            for (int a = 0; a < N + 2; a++) {
+                x[IX3(a, b, 0)] = x[IX3(a, b, low)];
+                x[IX3(a, b, N + 1)] = x[IX3(a, b, high)];
+            }
+        }
+        break;
+    }
+
+    default:
+        std::cerr << "Error: Invalid boundary condition." << std::endl;
+        break;
+    }
+}
+
+void FluidSolver3D::RelaxRedBlack(float* x, const float* x0, float a, float c)
+{
+    const int sj = N + 2;
+    const int sk = (N + 2) * (N + 2);
+    float inv = 1.0f / c;
+
+    // cells of one colour only read cells of the other, so slabs are independent
+    for (int color = 0; color < 2; color++) {
+        pool.ParallelFor(N, [&](int kBegin, int kEnd) {
+            for (int k = kBegin + 1; k <= kEnd; k++) {
+                for (int j = 1; j <= N; j++) {
+                    int start = 1 + ((j + k + color) & 1);
+                    for (int i = start; i <= N; i += 2) {
+                        int idx = IX3(i, j, k);
+                        x[idx] = (x0[idx] + a * (x[idx - 1] + x[idx + 1] + x[idx - sj] +
+                            x[idx + sj] + x[idx - sk] + x[idx + sk])) * inv;
+                    }
+                }
+            }
+        });
+    }
+}
+
+float FluidSolver3D::Residual(const float* x, const float* x0, float a, float c) const
+{
+    const int sj = N + 2;
+    const int sk = (N + 2) * (N + 2);
+    float residual = 0.0f;
+
+    for (int k = 1; k <= N; k++) {
+        for (int j = 1; j <= N; j++) {
+            for (int i = 1; i <= N; i++) {
+                int idx = IX3(i, j, k);
+                float r = x0[idx] + a * (x[idx - 1] + x[idx + 1] + x[idx - sj] +
+                    x[idx + sj] + x[idx - sk] + x[idx + sk]) - c * x[idx];
+                residual = std::max(residual, std::fabs(r));
+            }
+        }
+    }
+    return residual;
+}
+
+// diffuse function using red-black Gauss-Seidel relaxation
+void FluidSolver3D::Diffuse(FieldType fieldType, int NumIters)
+{
+    ProfilePhase phase = (fieldType == DENSITY) ? PHASE_DIFFUSE_DENSITY : PHASE_DIFFUSE_VELOCITY;
+    ScopedPhaseTimer timer(profiler, phase);
+
+    float a = dt * diff * N * N;
+    float* x = Field(fieldType);
+    float* x0 = PrevField(fieldType);
+    if (!x) {
+        std::cerr << "Error: Invalid field type." << std::endl;
+        return;
+    }
+
+    for (int k = 0; k < NumIters; k++) {
+        RelaxRedBlack(x, x0, a, 1 + 6 * a);
+        // apply boundary condition
+        SetBoundary(x);
+    }
+
+    profiler.RecordSolve(phase, NumIters,
+        profiler.IsTrackingResiduals() ? Residual(x, x0, a, 1 + 6 * a) : 0.0f);
+}
+
+void FluidSolver3D::Advect(FieldType fieldType)
+{
+    ScopedPhaseTimer timer(profiler, (fieldType == DENSITY) ? PHASE_ADVECT_DENSITY : PHASE_ADVECT_VELOCITY);
+
+    float* d = Field(fieldType);
+    const float* d0 = PrevField(fieldType);
+    if (!d) {
+        std::cerr << "Error: Invalid field type." << std::endl;
+        return;
+    }
+
+    // density is carried by the current velocity, velocity by the projected
+    // velocity left in the previous buffers
+    bool density = (fieldType == DENSITY);
+    const float* u = density ? grid.u : grid.u_prev;
+    const float* v = density ? grid.v : grid.v_prev;
+    const float* w = density ? grid.w : grid.w_prev;
+
+    float dt0 = dt * N;
+
+    pool.ParallelFor(N, [&](int kBegin, int kEnd) {
+        for (int k = kBegin + 1; k <= kEnd; k++) {
+            for (int j = 1; j <= N; j++) {
+                for (int i = 1; i <= N; i++) {
+                    int idx = IX3(i, j, k);
+                    float x = i - dt0 * u[idx];
+                    float y = j - dt0 * v[idx];
+                    float z = k - dt0 * w[idx];
+
+                    x = (x < 0.5f) ? 0.5f : (x > N + 0.5f) ? N + 0.5f : x;
+                    y = (y < 0.5f) ? 0.5f : (y > N + 0.5f) ? N + 0.5f : y;
+                    z = (z < 0.5f) ? 0.5f : (z > N + 0.5f) ? N + 0.5f : z;
+
+                    int i0 = static_cast<int>(x);
+                    int j0 = static_cast<int>(y);
+                    int k0 = static_cast<int>(z);
+                    float s1 = x - i0, s0 = 1.0f - s1;
+                    float t1 = y - j0, t0 = 1.0f - t1;
+                    float r1 = z - k0, r0 = 1.0f - r1;
+
+                    // trilinear interpolation
+                    d[idx] =
+                        r0 * (s0 * (t0 * d0[IX3(i0, j0, k0)] + t1 * d0[IX3(i0, j0 + 1, k0)]) +
+                              s1 * (t0 * d0[IX3(i0 + 1, j0, k0)] + t1 * d0[IX3(i0 + 1, j0 + 1, k0)])) +
+                        r1 * (s0 * (t0 * d0[IX3(i0, j0, k0 + 1)] + t1 * d0[IX3(i0, j0 + 1, k0 + 1)]) +
+                              s1 * (t0 * d0[IX3(i0 + 1, j0, k0 + 1)] + t1 * d0[IX3(i0 + 1, j0 + 1, k0 + 1)]));
+                }
+            }
+        }
+    });
+
+    // apply the boundary
+    SetBoundary(d);
+}
+
+void FluidSolver3D::StepDensity()
+{
+    // swap the previous and current density buffers
+    grid.SwapBuffers(DENSITY);
+
+    // diffuse the density
+    Diffuse(DENSITY);
+
+    // swap the buffers again to prepare for the advection step
+    grid.SwapBuffers(DENSITY);
+
+    // advect the density using the velocity fields
+    Advect(DENSITY);
+}
+
+void FluidSolver3D::Project()
+{
+    ScopedPhaseTimer timer(profiler, PHASE_PROJECT);
+
+    float h = 1.0f / N;
+    float* u = grid.u;
+    float* v = grid.v;
+    float* w = grid.w;
+    float* p = grid.u_prev; // u_prev to store pressure temporarily
+    float* div = grid.v_prev; // v_prev to store divergence temporarily
+    const int sj = N + 2;
+    const int sk = (N + 2) * (N + 2);
+
+    // compute divergence of the velocity field
+    pool.ParallelFor(N, [&](int kBegin, int kEnd) {
+        for (int k = kBegin + 1; k <= kEnd; k++) {
+            for (int j = 1; j <= N; j++) {
+                for (int i = 1; i <= N; i++) {
+                    int idx = IX3(i, j, k);
+                    div[idx] = -0.5f * h * (u[idx + 1] - u[idx - 1] + v[idx + sj] - v[idx - sj] +
+                        w[idx + sk] - w[idx - sk]);
+                    p[idx] = 0.0f;
+                }
+            }
+        }
+    });
+    SetBoundary(div);
+    SetBoundary(p);
+
+    // solve for the pressure
+    for (int k = 0; k < 20; k++) {
+        RelaxRedBlack(p, div, 1.0f, 6.0f);
+        SetBoundary(p);
+    }
+
+    profiler.RecordSolve(PHASE_PROJECT, 20,
+        profiler.IsTrackingResiduals() ? Residual(p, div, 1.0f, 6.0f) : 0.0f);
+
+    // subtract the pressure gradient from the velocity field
+    pool.ParallelFor(N, [&](int kBegin, int kEnd) {
+        for (int k = kBegin + 1; k <= kEnd; k++) {
+            for (int j = 1; j <= N; j++) {
+                for (int i = 1; i <= N; i++) {
+                    int idx = IX3(i, j, k);
+                    u[idx] -= 0.5f * (p[idx + 1] - p[idx - 1]) / h;
+                    v[idx] -= 0.5f * (p[idx + sj] - p[idx - sj]) / h;
+                    w[idx] -= 0.5f * (p[idx + sk] - p[idx - sk]) / h;
+                }
+            }
+        }
+    });
+
+    // apply boundary conditions to the velocity field
+    SetBoundary(u);
+    SetBoundary(v);
+    SetBoundary(w);
+}
+
+void FluidSolver3D::StepVelocity()
+{
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+    grid.SwapBuffers(VELOCITY_W);
+
+    Diffuse(VELOCITY_U, 20);
+    Diffuse(VELOCITY_V, 20);
+    Diffuse(VELOCITY_W, 20);
+
+    // project the velocity field to ensure it's divergence-free
+    Project();
+
+    // swap the buffers to prepare for the advection step
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+    grid.SwapBuffers(VELOCITY_W);
+
+    // advect the velocity fields
+    Advect(VELOCITY_U);
+    Advect(VELOCITY_V);
+    Advect(VELOCITY_W);
+
+    // project the velocity field again to ensure it's divergence-free after advection
+    Project();
+}
+
+void FluidSolver3D::Step()
+{
+    {
+        ScopedPhaseTimer timer(profiler, PHASE_STEP);
+
+        // step velocity field
+        StepVelocity();
+
+        // step density field
+        StepDensity();
+    }
+
+    if (profiler.IsEnabled()) {
+        for (int t = 0; t < pool.GetThreadCount(); t++) {
+            profiler.AddThreadBusy(t, pool.GetBusyMs(t));
+        }
+    }
+    pool.ResetBusyTime();
+    profiler.EndStep();
+}
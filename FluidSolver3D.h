@@ -0,0 +1,88 @@
+#ifndef FLUIDSOLVER3D_H
+#define FLUIDSOLVER3D_H
+
+#include "FluidSolver.h"
+#include "Grid3D.h"
+#include "SolverProfiler.h"
+#include "ThreadPool.h"
+
+// volumetric variant of FluidSolver on an N x N x N grid.
+// relaxation uses red-black Gauss-Seidel so every sweep can be split into
+// z-slabs across the thread pool; inner loops run along contiguous x.
+class FluidSolver3D {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, numThreads <= 0 uses the hardware concurrency
+    FluidSolver3D(int n, BoundaryCondition b, int numThreads = 0);
+
+    // destructor
+    ~FluidSolver3D();
+
+    // add input to a specified field at a location
+    void AddInputToField(FieldType fieldType, int i, int j, int k, float s);
+
+    // step
+    void Step();
+
+    // getters for rendering
+    float* GetDensity() const { return grid.GetDensity(); }
+    float* GetVelocityU() const { return grid.GetVelocityU(); }
+    float* GetVelocityV() const { return grid.GetVelocityV(); }
+    float* GetVelocityW() const { return grid.GetVelocityW(); }
+
+    int GetThreadCount() const { return pool.GetThreadCount(); }
+
+    // per-phase timings, iteration counts, residuals and thread busy time
+    SolverProfiler& GetProfiler() { return profiler; }
+    const SolverProfiler& GetProfiler() const { return profiler; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // grid width/height/depth (not including boundary)
+    int N;
+    // Grid3D object to manage grid data
+    Grid3D grid;
+    // boundary condition
+    BoundaryCondition bc;
+    // workers for the slab-parallel kernels
+    ThreadPool pool;
+
+    // delta time
+    float dt = 0.8f;
+    // diffusion coefficient
+    float diff = 0.0001f;
+
+    SolverProfiler profiler;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // the benchmark times the private phases directly
+    friend class SolverBench;
+
+    float* Field(FieldType fieldType) const;
+    float* PrevField(FieldType fieldType) const;
+
+    void SetBoundary(float* x);
+    // one red-black Gauss-Seidel sweep of x = (x0 + a * (sum of 6 neighbours)) / c
+    void RelaxRedBlack(float* x, const float* x0, float a, float c);
+    // max-norm residual of c x - a * (sum of 6 neighbours) = x0
+    float Residual(const float* x, const float* x0, float a, float c) const;
+    void Diffuse(FieldType fieldType, int NumIters = 20);
+    void Advect(FieldType fieldType);
+    void StepDensity();
+    void Project();
+    void StepVelocity();
+};
+
+#endif // FLUIDSOLVER3D_H
@@ -0,0 +1,236 @@
+#include "FrameSink.h"
+#include "DeltaStream.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// constructor
+StepPattern::StepPattern(const std::string& pattern) : pattern(pattern)
+{
+    int conversions = 0;
+    bool longLongInteger = false;
+    bool star = false;
+    std::string* text = &prefix;
+
+    for (size_t c = 0; c < pattern.size(); c++) {
+        if (pattern[c] != '%') {
+            *text += pattern[c];
+            continue;
+        }
+        if (c + 1 < pattern.size() && pattern[c + 1] == '%') {
+            *text += '%';
+            c++;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        size_t start = c++;
+        bool zero = false, left = false;
+        while (c < pattern.size() && std::strchr("-+ #0", pattern[c])) {
+            zero = zero || pattern[c] == '0';
+            left = left || pattern[c] == '-';
+            c++;
+        }
+        // width, then a precision that is ignored; '*' would take an argument
+        int digits = 0;
+        bool precision = false;
+        while (c < pattern.size() && (std::isdigit(static_cast<unsigned char>(pattern[c])) || pattern[c] == '*' || pattern[c] == '.')) {
+            star = star || pattern[c] == '*';
+            precision = precision || pattern[c] == '.';
+            if (!precision && pattern[c] != '*') {
+                digits = std::min(digits * 10 + (pattern[c] - '0'), 64);
+            }
+            c++;
+        }
+        size_t lengthStart = c;
+        while (c < pattern.size() && std::strchr("hljztL", pattern[c])) {
+            c++;
+        }
+        std::string length = pattern.substr(lengthStart, c - lengthStart);
+        char conversion = (c < pattern.size()) ? pattern[c] : '\0';
+        conversions++;
+
+        bool integer = conversion != '\0' && std::strchr("diu", conversion);
+        if (integer && !hasConversion) {
+            hasConversion = true;
+            longLongInteger = (length == "ll");
+            zeroPad = zero && !left;
+            leftAlign = left;
+            width = digits;
+            text = &suffix;
+        }
+        else {
+            // anything else stays in the name as written
+            *text += pattern.substr(start, c - start + (conversion != '\0' ? 1 : 0));
+        }
+    }
+
+    printable = conversions == 1 && hasConversion && longLongInteger && !star;
+    if (!printable && conversions > 0) {
+        std::cerr << "Warning: " << pattern << " is not a single %lld conversion, "
+            << (hasConversion ? "substituting the step for its first integer." : "using it as a literal name.") << std::endl;
+    }
+}
+
+std::string StepPattern::Format(long long step) const
+{
+    if (printable) {
+        char path[1024];
+        std::snprintf(path, sizeof(path), pattern.c_str(), step);
+        return path;
+    }
+    if (!hasConversion) {
+        return prefix;
+    }
+
+    std::string number = std::to_string(step < 0 ? -step : step);
+    std::string sign = step < 0 ? "-" : "";
+    int padding = std::max(width - static_cast<int>(sign.size() + number.size()), 0);
+    if (zeroPad) {
+        number = sign + std::string(padding, '0') + number;
+    }
+    else if (leftAlign) {
+        number = sign + number + std::string(padding, ' ');
+    }
+    else {
+        number = std::string(padding, ' ') + sign + number;
+    }
+    return prefix + number + suffix;
+}
+
+bool RawFrameSink::WriteFrame(const FieldFrame& frame)
+{
+    std::string name = pattern.Format(frame.step);
+    const char* path = name.c_str();
+
+    FILE* out = std::fopen(path, "wb");
+    if (!out) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return false;
+    }
+    size_t written = std::fwrite(frame.data.data(), sizeof(float), frame.data.size(), out);
+    bool ok = (std::fclose(out) == 0) && written == frame.data.size();
+    if (!ok) {
+        std::cerr << "Error: short write to " << path << std::endl;
+    }
+    return ok;
+}
+
+// constructor
+CompressedFrameSink::CompressedFrameSink(const std::string& pattern, const CodecOptions& options, int threads)
+    : pattern(pattern), options(options)
+{
+    pool = new ThreadPool(threads);
+}
+
+// destructor
+CompressedFrameSink::~CompressedFrameSink()
+{
+    delete pool;
+}
+
+bool CompressedFrameSink::WriteFrame(const FieldFrame& frame)
+{
+    std::string path = pattern.Format(frame.step);
+
+    SnapshotFieldRef field = { DENSITY, frame.nx, frame.ny, frame.data.data() };
+    SnapshotStats stats;
+    if (!Snapshot::Write(path.c_str(), frame.step, &field, 1, options, pool, &stats)) {
+        return false;
+    }
+    rawBytes += stats.rawBytes;
+    storedBytes += stats.storedBytes;
+    return true;
+}
+
+// constructor
+DeltaFrameSink::DeltaFrameSink(const std::string& path, int keyframeInterval, int threads)
+    : path(path), keyframeInterval(keyframeInterval)
+{
+    pool = new ThreadPool(threads);
+    writer = new DeltaStreamWriter();
+}
+
+// destructor
+DeltaFrameSink::~DeltaFrameSink()
+{
+    delete writer;
+    delete pool;
+}
+
+bool DeltaFrameSink::WriteFrame(const FieldFrame& frame)
+{
+    if (!writer->IsOpen() && !writer->Open(path.c_str(), frame.nx, frame.ny, keyframeInterval, 64, pool)) {
+        return false;
+    }
+    return writer->WriteFrame(frame.step, frame.data.data());
+}
+
+static bool IsVideoTarget(const std::string& target)
+{
+    return (!target.empty() && target[0] == '|') ||
+        (target.size() > 4 && target.compare(target.size() - 4, 4, ".y4m") == 0);
+}
+
+// constructor
+ImageFrameSink::ImageFrameSink(const std::string& target, const ImageOptions& options, int threads)
+    : target(target), imagePattern(IsVideoTarget(target) ? std::string() : target), options(options)
+{
+    video = IsVideoTarget(target);
+    pool = new ThreadPool(threads);
+    writer = new Y4mWriter();
+}
+
+// destructor
+ImageFrameSink::~ImageFrameSink()
+{
+    delete writer;
+    delete pool;
+}
+
+bool ImageFrameSink::Close()
+{
+    return writer->Close();
+}
+
+bool ImageFrameSink::WriteFrame(const FieldFrame& frame)
+{
+    // the first frame fixes the output size
+    if (options.width <= 0 || options.height <= 0) {
+        options.width = frame.nx;
+        options.height = frame.ny;
+    }
+    int width = options.width;
+    int height = options.height;
+
+    if (options.hi <= options.lo) {
+        float largest = 0.0f;
+        for (float value : frame.data) {
+            largest = std::max(largest, value);
+        }
+        options.hi = largest > options.lo ? largest : options.lo + 1.0f;
+    }
+
+    // the boundary ring is left out
+    FieldView view = { 1.0f, 1.0f, static_cast<float>(frame.nx + 1), static_cast<float>(frame.ny + 1) };
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    RenderField(frame.data.data(), frame.nx + 2, frame.ny + 2, view, options.lo, options.hi, options.colormap,
+        width, height, scratch, rgb.data(), pool);
+
+    if (!video) {
+        return WritePng(imagePattern.Format(frame.step).c_str(), rgb.data(), width, height);
+    }
+
+    // the video size is fixed by its first frame
+    if (!writer->IsOpen()) {
+        if (videoFailed || !writer->Open(target.c_str(), width, height, options.fps)) {
+            videoFailed = true;
+            return false;
+        }
+    }
+    return writer->WriteFrame(rgb.data());
+}
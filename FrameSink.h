@@ -0,0 +1,170 @@
+#ifndef FRAMESINK_H
+#define FRAMESINK_H
+
+#include <string>
+#include <vector>
+#include "FieldCodec.h"
+#include "ImageWriter.h"
+
+class DeltaStreamWriter;
+class Y4mWriter;
+class ThreadPool;
+
+// one snapshot of a field, (nx + 2) x (ny + 2) floats including boundary
+struct FieldFrame {
+    long long step;
+    int nx, ny;
+    std::vector<float> data;
+};
+
+// file names taking the step from a printf-style pattern, e.g.
+// "out/dens_%06lld.raw". only a pattern with exactly one integer
+// conversion taking a long long goes to snprintf; in any other the first
+// integer conversion is replaced by the step (keeping its width and zero
+// padding) and the rest is copied literally, so a user pattern is never
+// used as a format with the wrong arguments
+class StepPattern {
+
+public:
+
+    explicit StepPattern(const std::string& pattern);
+
+    std::string Format(long long step) const;
+
+private:
+
+    std::string pattern;
+    // pattern can be passed to snprintf with the step
+    bool printable;
+    // otherwise: literal text around the first integer conversion
+    std::string prefix, suffix;
+    bool hasConversion = false;
+    bool zeroPad = false;
+    bool leftAlign = false;
+    int width = 0;
+};
+
+// destination of the frames drained by AsyncFieldWriter. WriteFrame runs
+// on the writer thread only
+class FrameSink {
+
+public:
+
+    virtual ~FrameSink() {}
+
+    // false on an I/O error, the writer counts it and carries on
+    virtual bool WriteFrame(const FieldFrame& frame) = 0;
+};
+
+// writes each frame to its own raw float file named by a printf pattern
+// taking the step, e.g. "out/dens_%06lld.raw"
+class RawFrameSink : public FrameSink {
+
+public:
+
+    explicit RawFrameSink(const std::string& pattern) : pattern(pattern) {}
+
+    bool WriteFrame(const FieldFrame& frame) override;
+
+private:
+
+    StepPattern pattern;
+};
+
+// writes each frame as a one-field Snapshot named by a printf pattern,
+// chunks compressed in parallel on the sink's own thread pool
+class CompressedFrameSink : public FrameSink {
+
+public:
+
+    // threads <= 0 uses the hardware concurrency
+    CompressedFrameSink(const std::string& pattern, const CodecOptions& options, int threads = 0);
+    ~CompressedFrameSink();
+
+    bool WriteFrame(const FieldFrame& frame) override;
+
+    // bytes before and after compression over every frame written
+    size_t GetRawBytes() const { return rawBytes; }
+    size_t GetStoredBytes() const { return storedBytes; }
+
+private:
+
+    StepPattern pattern;
+    CodecOptions options;
+    ThreadPool* pool;
+    size_t rawBytes = 0;
+    size_t storedBytes = 0;
+};
+
+// appends every frame to one DeltaStream file, keyframes every
+// keyframeInterval frames and tile residuals in between
+class DeltaFrameSink : public FrameSink {
+
+public:
+
+    // the stream is opened on the first frame, which fixes the grid size
+    DeltaFrameSink(const std::string& path, int keyframeInterval = 32, int threads = 0);
+
+    // destructor, writes the keyframe index
+    ~DeltaFrameSink();
+
+    bool WriteFrame(const FieldFrame& frame) override;
+
+    DeltaStreamWriter& GetWriter() { return *writer; }
+
+private:
+
+    std::string path;
+    int keyframeInterval;
+    ThreadPool* pool;
+    DeltaStreamWriter* writer;
+};
+
+// how ImageFrameSink draws a field
+struct ImageOptions {
+    Colormap colormap = Colormap::INFERNO;
+    // values from lo to hi span the colormap, hi <= lo takes 0 .. the
+    // largest value of the first frame and keeps it for the rest
+    float lo = 0.0f;
+    float hi = 1.0f;
+    // output size, 0 uses the frame's interior size
+    int width = 0;
+    int height = 0;
+    int fps = 30;
+};
+
+// draws each frame's interior with a colormap on the CPU and writes it as
+// a PNG named by a printf pattern taking the step, or appends it to one
+// Y4M video when the target ends in ".y4m" or is a command ("|ffmpeg ...").
+// no window or GL context is involved, so it runs on display-less machines
+class ImageFrameSink : public FrameSink {
+
+public:
+
+    // threads <= 0 uses the hardware concurrency
+    ImageFrameSink(const std::string& target, const ImageOptions& options, int threads = 0);
+
+    // destructor, closes the video
+    ~ImageFrameSink();
+
+    bool WriteFrame(const FieldFrame& frame) override;
+
+    // false if the video stream failed, e.g. the encoder exited early
+    bool Close();
+
+private:
+
+    std::string target;
+    // PNG names, unused for video
+    StepPattern imagePattern;
+    ImageOptions options;
+    bool video;
+    // the video could not be opened, later frames fail without retrying
+    bool videoFailed = false;
+    ThreadPool* pool;
+    Y4mWriter* writer;
+    std::vector<float> scratch;
+    std::vector<unsigned char> rgb;
+};
+
+#endif // FRAMESINK_H
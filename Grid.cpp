@@ -1,31 +1,94 @@
 #include "Grid.h"
+#include "MappedFile.h"
+#include <algorithm>
 #include <iostream>
 
+// validate the velocity downsampling factor against the grid dimensions
+static int CheckVelocityScale(int nx, int ny, int velocityScale)
+{
+    if (velocityScale < 1 || nx % velocityScale != 0 || ny % velocityScale != 0) {
+        std::cerr << "Error: velocity scale " << velocityScale << " does not divide " << nx << "x" << ny
+            << ", using full resolution velocity." << std::endl;
+        return 1;
+    }
+    return velocityScale;
+}
+
 // constructor implementation
-Grid::Grid(int n) : N(n), size((N + 2) * (N + 2)) 
+Grid::Grid(int nx, int ny, int velocityScale)
+    : NX(nx), NY(ny), size((NX + 2) * (NY + 2)),
+    velocityScale(CheckVelocityScale(nx, ny, velocityScale)),
+    NVX(nx / this->velocityScale), NVY(ny / this->velocityScale), sizeV((NVX + 2) * (NVY + 2)),
+    mask(nx, ny), velMask(NVX, NVY)
 {
-    std::cout << "Grid constructor called. Initializing with N = " << N << ", size = " << size << "." <<  std::endl;
+    std::cout << "Grid constructor called. Initializing with " << NX << "x" << NY << ", size = " << size << "." <<  std::endl;
+    if (NVX != NX) {
+        std::cout << "Velocity grid " << NVX << "x" << NVY << ", size = " << sizeV << "." << std::endl;
+    }
 
     // allocate memory for arrays
-    u = new float[size];
-    v = new float[size];
-    u_prev = new float[size];
-    v_prev = new float[size];
+    u = new float[sizeV];
+    v = new float[sizeV];
+    u_prev = new float[sizeV];
+    v_prev = new float[sizeV];
     dens = new float[size];
     dens_prev = new float[size];
     std::cout << "Memory allocated for arrays." << std::endl;
 
     // initialize arrays to zero
-    for (int i = 0; i < size; ++i) {
+    for (int i = 0; i < sizeV; ++i) {
         u[i] = v[i] = u_prev[i] = v_prev[i] = 0.0f;
+    }
+    for (int i = 0; i < size; ++i) {
         dens[i] = dens_prev[i] = 0.0f;
     }
     std::cout << "Arrays initialized to zero." << std::endl;
 }
 
+// constructor over arrays mapped from a checkpoint
+Grid::Grid(int nx, int ny, int velocityScale, MappedFile* mapping, float* const fields[6])
+    : NX(nx), NY(ny), size((NX + 2) * (NY + 2)),
+    velocityScale(CheckVelocityScale(nx, ny, velocityScale)),
+    NVX(nx / this->velocityScale), NVY(ny / this->velocityScale), sizeV((NVX + 2) * (NVY + 2)),
+    mask(nx, ny), velMask(NVX, NVY), mapping(mapping)
+{
+    std::cout << "Grid constructor called. Mapping " << NX << "x" << NY << " from a checkpoint." << std::endl;
+
+    dens = fields[0];
+    dens_prev = fields[1];
+    u = fields[2];
+    u_prev = fields[3];
+    v = fields[4];
+    v_prev = fields[5];
+}
+
+void Grid::ReleaseMapping()
+{
+    if (!mapping) {
+        return;
+    }
+
+    float** fields[6] = { &dens, &dens_prev, &u, &u_prev, &v, &v_prev };
+    for (int f = 0; f < 6; f++) {
+        int count = (f < 2) ? size : sizeV;
+        float* owned = new float[count];
+        std::copy(*fields[f], *fields[f] + count, owned);
+        *fields[f] = owned;
+    }
+
+    delete mapping;
+    mapping = nullptr;
+}
+
 // destructor implementation
 Grid::~Grid() 
 {
+    // mapped arrays go away with the mapping
+    if (mapping) {
+        delete mapping;
+        return;
+    }
+
     // deallocate memory
     std::cout << "Grid destructor called. Deallocating memory." << std::endl;
     delete[] u;
@@ -54,3 +117,33 @@ void Grid::SwapBuffers(FieldType fieldType)
         break;
     }
 }
+
+void Grid::FieldDims(FieldType fieldType, int& nx, int& ny) const
+{
+    nx = (fieldType == DENSITY) ? NX : NVX;
+    ny = (fieldType == DENSITY) ? NY : NVY;
+}
+
+void Grid::ClearDensityTile(int tile)
+{
+    int i0, i1, j0, j1;
+    mask.GetTileBounds(tile, i0, i1, j0, j1);
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            dens[IX(i, j)] = dens_prev[IX(i, j)] = 0.0f;
+        }
+    }
+}
+
+void Grid::ClearVelocityTile(int tile)
+{
+    // velocity arrays are indexed on the NVX x NVY grid
+    int NX = NVX;
+    int i0, i1, j0, j1;
+    velMask.GetTileBounds(tile, i0, i1, j0, j1);
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            u[IX(i, j)] = v[IX(i, j)] = u_prev[IX(i, j)] = v_prev[IX(i, j)] = 0.0f;
+        }
+    }
+}
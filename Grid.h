@@ -1,16 +1,20 @@
 #ifndef GRID_H
 #define GRID_H
 
-#define IX(i, j) ((i) + (N + 2) * (j))
+#include "ActivityMask.h"
+
+#define IX(i, j) ((i) + (NX + 2) * (j))
 #define SWAP(x, y) { float* tmp = x; x = y; y = tmp; }
 
 class FluidSolver;
+class MappedFile;
 
 // for functions that select fields to operate on
 enum FieldType {
     DENSITY,
     VELOCITY_U,
-    VELOCITY_V
+    VELOCITY_V,
+    VELOCITY_W  // 3D grids only
 };
 
 class Grid {
@@ -26,8 +30,8 @@ public:
     // FUNCTIONS
     // ==================================================
 
-    // constructor
-    Grid(int n);
+    // constructor, velocity lives on an (nx / velocityScale) x (ny / velocityScale) grid
+    Grid(int nx, int ny, int velocityScale = 1);
 
     // destructor
     ~Grid();
@@ -41,27 +45,58 @@ public:
 private:
 
     friend class FluidSolver;
+    friend class Checkpoint;
+    friend class EnsembleBatch;
 
     // ==================================================
     // VARIABLES
     // ==================================================
 
-    // N = non-boundary grid dimension
+    // NX, NY = non-boundary grid dimensions
     // size = array size including boundary cells
-    int N;
+    int NX, NY;
     int size;
 
+    // NVX, NVY = non-boundary dimensions of the velocity grid (NX, NY / velocityScale)
+    // sizeV = velocity array size including boundary cells
+    int velocityScale;
+    int NVX, NVY;
+    int sizeV;
+
     // u = horizontal velocity
     // v = vertical velocity
     // dens = fluid density
     float *u, *v, *u_prev, *v_prev, *dens, *dens_prev;
 
+    // per-tile activity of the density and velocity grids
+    ActivityMask mask;
+    ActivityMask velMask;
+
+    // set when the arrays live in a checkpoint mapping instead of the heap
+    MappedFile* mapping = nullptr;
+
     // ==================================================
     // FUNCTIONS
     // ==================================================
 
+    // adopt dens, dens_prev, u, u_prev, v, v_prev from a mapped checkpoint
+    // and take ownership of the mapping
+    Grid(int nx, int ny, int velocityScale, MappedFile* mapping, float* const fields[6]);
+
+    // copy mapped arrays to the heap and drop the mapping, so the
+    // checkpoint file can be replaced
+    void ReleaseMapping();
+
     // swap the current and previous buffers for the specified field
     void SwapBuffers(FieldType fieldType);
+
+    // non-boundary dimensions and activity mask of the grid holding a field
+    void FieldDims(FieldType fieldType, int& nx, int& ny) const;
+    ActivityMask& FieldMask(FieldType fieldType) { return (fieldType == DENSITY) ? mask : velMask; }
+
+    // zero the current and previous buffers inside one activity tile
+    void ClearDensityTile(int tile);
+    void ClearVelocityTile(int tile);
 };
 
 #endif // GRID_H
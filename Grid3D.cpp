@@ -0,0 +1,58 @@
+#include "Grid3D.h"
+#include <cstring>
+#include <iostream>
+
+// constructor implementation
+Grid3D::Grid3D(int n) : N(n), size((N + 2) * (N + 2) * (N + 2))
+{
+    std::cout << "Grid3D constructor called. Initializing with N = " << N << ", size = " << size << "." << std::endl;
+
+    // allocate memory for arrays
+    u = new float[size];
+    v = new float[size];
+    w = new float[size];
+    u_prev = new float[size];
+    v_prev = new float[size];
+    w_prev = new float[size];
+    dens = new float[size];
+    dens_prev = new float[size];
+
+    // initialize arrays to zero
+    float* fields[] = { u, v, w, u_prev, v_prev, w_prev, dens, dens_prev };
+    for (float* field : fields) {
+        std::memset(field, 0, sizeof(float) * size);
+    }
+}
+
+// destructor implementation
+Grid3D::~Grid3D()
+{
+    delete[] u;
+    delete[] v;
+    delete[] w;
+    delete[] u_prev;
+    delete[] v_prev;
+    delete[] w_prev;
+    delete[] dens;
+    delete[] dens_prev;
+}
+
+void Grid3D::SwapBuffers(FieldType fieldType)
+{
+    switch (fieldType) {
+    case DENSITY:
+        SWAP(dens_prev, dens);
+        break;
+    case VELOCITY_U:
+        SWAP(u_prev, u);
+        break;
+    case VELOCITY_V:
+        SWAP(v_prev, v);
+        break;
+    case VELOCITY_W:
+        SWAP(w_prev, w);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef GRID3D_H
+#define GRID3D_H
+
+#include "Grid.h"
+
+#define IX3(i, j, k) ((i) + (N + 2) * ((j) + (N + 2) * (k)))
+
+class FluidSolver3D;
+
+class Grid3D {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    Grid3D(int n);
+
+    // destructor
+    ~Grid3D();
+
+    // getters for rendering
+    float* GetDensity() const { return dens; }
+    float* GetVelocityU() const { return u; }
+    float* GetVelocityV() const { return v; }
+    float* GetVelocityW() const { return w; }
+
+private:
+
+    friend class FluidSolver3D;
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // N = non-boundary grid dimension
+    // size = array size including boundary cells
+    int N;
+    int size;
+
+    // u, v, w = velocity along x, y, z
+    // dens = fluid density
+    float *u, *v, *w, *u_prev, *v_prev, *w_prev, *dens, *dens_prev;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // swap the current and previous buffers for the specified field
+    void SwapBuffers(FieldType fieldType);
+};
+
+#endif // GRID3D_H
@@ -0,0 +1,74 @@
+#include "HaloTransport.h"
+#include <algorithm>
+
+bool HaloTransport::ExchangeHalo(const float* sendDown, float* receiveDown, const float* sendUp, float* receiveUp,
+    size_t count)
+{
+    int rank = GetRank();
+    size_t bytes = count * sizeof(float);
+
+    // the lower rank of each pair sends first, so the exchange cannot
+    // deadlock even when a message does not fit the transport's buffering
+    if (rank > 0) {
+        if (!Receive(rank - 1, receiveDown, bytes) || !Send(rank - 1, sendDown, bytes)) {
+            return false;
+        }
+    }
+    if (rank + 1 < GetRankCount()) {
+        if (!Send(rank + 1, sendUp, bytes) || !Receive(rank + 1, receiveUp, bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// reductions gather on rank 0 and send the result back out
+
+bool HaloTransport::AllReduceMax(float& value)
+{
+    int ranks = GetRankCount();
+    if (GetRank() != 0) {
+        return Send(0, &value, sizeof(value)) && Receive(0, &value, sizeof(value));
+    }
+    for (int r = 1; r < ranks; r++) {
+        float other;
+        if (!Receive(r, &other, sizeof(other))) {
+            return false;
+        }
+        value = std::max(value, other);
+    }
+    for (int r = 1; r < ranks; r++) {
+        if (!Send(r, &value, sizeof(value))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HaloTransport::AllReduceSum(double& value)
+{
+    int ranks = GetRankCount();
+    if (GetRank() != 0) {
+        return Send(0, &value, sizeof(value)) && Receive(0, &value, sizeof(value));
+    }
+    // summed in rank order, so every run adds the same way
+    for (int r = 1; r < ranks; r++) {
+        double other;
+        if (!Receive(r, &other, sizeof(other))) {
+            return false;
+        }
+        value += other;
+    }
+    for (int r = 1; r < ranks; r++) {
+        if (!Send(r, &value, sizeof(value))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HaloTransport::Barrier()
+{
+    float unused = 0.0f;
+    return AllReduceMax(unused);
+}
@@ -0,0 +1,41 @@
+#ifndef HALOTRANSPORT_H
+#define HALOTRANSPORT_H
+
+#include <cstddef>
+
+// messages between the ranks of a decomposed run (see DecomposedSolver).
+// a transport only has to move bytes from one rank to another in order;
+// the exchanges and reductions the solver needs are built on Send and
+// Receive here, and a transport with native collectives (e.g. MPI) can
+// override them
+class HaloTransport {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    virtual ~HaloTransport() {}
+
+    virtual int GetRank() const = 0;
+    virtual int GetRankCount() const = 0;
+
+    // blocking point-to-point transfer, messages from one rank to another
+    // arrive in the order they were sent. false once the transport failed
+    virtual bool Send(int peer, const void* data, size_t bytes) = 0;
+    virtual bool Receive(int peer, void* data, size_t bytes) = 0;
+
+    // swap count floats with the ranks below (rank - 1) and above (rank + 1).
+    // the buffers towards a missing neighbour are ignored
+    virtual bool ExchangeHalo(const float* sendDown, float* receiveDown, const float* sendUp, float* receiveUp,
+        size_t count);
+
+    // combine a value over all ranks, every rank gets the result
+    virtual bool AllReduceMax(float& value);
+    virtual bool AllReduceSum(double& value);
+
+    virtual bool Barrier();
+};
+
+#endif // HALOTRANSPORT_H
@@ -0,0 +1,357 @@
+#include "HudOverlay.h"
+#include "FluidSolver.h"
+#include "ShaderUtil.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// classic 5x7 LCD font for ' ' .. '~', five columns per glyph with the top
+// row in bit 0
+static const unsigned char FONT_5X7[95][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+    { 0x14, 0x7f, 0x14, 0x7f, 0x14 }, { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1c, 0x22, 0x41, 0x00 },
+    { 0x00, 0x41, 0x22, 0x1c, 0x00 }, { 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 }, { 0x18, 0x14, 0x12, 0x7f, 0x10 },
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e }, { 0x00, 0x36, 0x36, 0x00, 0x00 },
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3e },
+    { 0x7e, 0x11, 0x11, 0x11, 0x7e }, { 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },
+    { 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 }, { 0x7f, 0x09, 0x09, 0x09, 0x01 },
+    { 0x3e, 0x41, 0x49, 0x49, 0x7a }, { 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 },
+    { 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 }, { 0x7f, 0x40, 0x40, 0x40, 0x40 },
+    { 0x7f, 0x02, 0x0c, 0x02, 0x7f }, { 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },
+    { 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e }, { 0x7f, 0x09, 0x19, 0x29, 0x46 },
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f },
+    { 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+    { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 },
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },
+    { 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, { 0x38, 0x44, 0x44, 0x48, 0x7f },
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x0c, 0x52, 0x52, 0x52, 0x3e },
+    { 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3d, 0x00 },
+    { 0x7f, 0x10, 0x28, 0x44, 0x00 }, { 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 },
+    { 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, { 0x7c, 0x14, 0x14, 0x14, 0x08 },
+    { 0x08, 0x14, 0x14, 0x18, 0x7c }, { 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+    { 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c }, { 0x1c, 0x20, 0x40, 0x20, 0x1c },
+    { 0x3c, 0x40, 0x30, 0x40, 0x3c }, { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c },
+    { 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, { 0x00, 0x00, 0x7f, 0x00, 0x00 },
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 }
+};
+
+// atlas of 6 x 8 cells: the 95 glyphs, then a solid cell for panels and bars
+#define FONT_CELL_W 6
+#define FONT_CELL_H 8
+#define FONT_CELLS 96
+#define FONT_SOLID 95
+
+// top-level phases stacked in the step graph, SetBoundary runs inside them
+static const ProfilePhase GRAPH_PHASES[] = {
+    PHASE_UPDATE_ACTIVITY, PHASE_DIFFUSE_VELOCITY, PHASE_PROJECT,
+    PHASE_ADVECT_VELOCITY, PHASE_DIFFUSE_DENSITY, PHASE_ADVECT_DENSITY
+};
+static const int GRAPH_PHASE_COUNT = sizeof(GRAPH_PHASES) / sizeof(GRAPH_PHASES[0]);
+static const unsigned char PHASE_COLORS[GRAPH_PHASE_COUNT][4] = {
+    { 160, 160, 160, 255 }, {  80, 160, 255, 255 }, { 255,  90,  90, 255 },
+    {  90, 220, 220, 255 }, { 180, 120, 255, 255 }, { 255, 200,  60, 255 }
+};
+
+static const unsigned char TEXT_COLOR[4] = { 230, 230, 230, 255 };
+static const unsigned char PANEL_COLOR[4] = { 0, 0, 0, 170 };
+static const unsigned char GRAPH_COLOR[4] = { 255, 255, 255, 40 };
+static const unsigned char FRAME_COLOR[4] = { 120, 230, 120, 255 };
+static const unsigned char MARK_COLOR[4] = { 255, 255, 255, 110 };
+
+// text lines before the first phase line, see buildText
+#define HUD_PHASE_LINE 3
+
+HudOverlay::HudOverlay()
+    : program(0),
+    fontTexture(0),
+    VAO(0),
+    VBO(0),
+    historyNext(0),
+    historyCount(0),
+    lastText(std::chrono::steady_clock::now()),
+    lastSteps(0),
+    framesSinceText(0),
+    frameMsSinceText(0.0),
+    costMs(0.0)
+{
+    // positions are framebuffer pixels from the top left
+    const char* vertexSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in vec2 aTexCoord;
+    layout (location = 2) in vec4 aColor;
+    uniform vec2 screen;
+    out vec2 TexCoord;
+    out vec4 Color;
+    void main() {
+        gl_Position = vec4(aPos.x / screen.x * 2.0 - 1.0, 1.0 - aPos.y / screen.y * 2.0, 0.0, 1.0);
+        TexCoord = aTexCoord;
+        Color = aColor;
+    }
+    )";
+
+    const char* fragmentSource = R"(
+    #version 330 core
+    in vec2 TexCoord;
+    in vec4 Color;
+    out vec4 FragColor;
+    uniform sampler2D font;
+    void main() {
+        FragColor = vec4(Color.rgb, Color.a * texture(font, TexCoord).r);
+    }
+    )";
+
+    program = createShaderProgram(vertexSource, fragmentSource);
+
+    // rasterize the font into a one-channel atlas
+    std::vector<unsigned char> atlas(FONT_CELLS * FONT_CELL_W * FONT_CELL_H, 0);
+    int atlasWidth = FONT_CELLS * FONT_CELL_W;
+    for (int g = 0; g < FONT_CELLS; g++) {
+        for (int y = 0; y < FONT_CELL_H; y++) {
+            for (int x = 0; x < FONT_CELL_W; x++) {
+                bool on = (g == FONT_SOLID) || (x < 5 && y < 7 && ((FONT_5X7[g][x] >> y) & 1));
+                atlas[y * atlasWidth + g * FONT_CELL_W + x] = on ? 255 : 0;
+            }
+        }
+    }
+
+    glGenTextures(1, &fontTexture);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, FONT_CELL_H, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::memset(frameHistory, 0, sizeof(frameHistory));
+    std::memset(phaseHistory, 0, sizeof(phaseHistory));
+}
+
+HudOverlay::~HudOverlay()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteTextures(1, &fontTexture);
+    glDeleteProgram(program);
+}
+
+void HudOverlay::addFrame(double frameMs, const FluidSolver& solver)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const SolverProfiler& profiler = solver.GetProfiler();
+    frameHistory[historyNext] = static_cast<float>(frameMs);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        phaseHistory[historyNext][p] = static_cast<float>(profiler.GetStats(static_cast<ProfilePhase>(p)).lastMs);
+    }
+    historyNext = (historyNext + 1) % HUD_HISTORY;
+    historyCount = std::min(historyCount + 1, HUD_HISTORY);
+
+    framesSinceText++;
+    frameMsSinceText += frameMs;
+    double seconds = std::chrono::duration<double>(start - lastText).count();
+    if (lines.empty() || seconds >= 0.25) {
+        buildText(solver, seconds);
+        lastText = start;
+        framesSinceText = 0;
+        frameMsSinceText = 0.0;
+    }
+
+    costMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// rates are averaged over the time since the last refresh
+void HudOverlay::buildText(const FluidSolver& solver, double seconds)
+{
+    const SolverProfiler& profiler = solver.GetProfiler();
+    char line[128];
+    lines.clear();
+
+    long long steps = profiler.GetStepCount();
+    double fps = seconds > 0.0 ? framesSinceText / seconds : 0.0;
+    double stepsPerSecond = seconds > 0.0 ? (steps - lastSteps) / seconds : 0.0;
+    double meanFrameMs = framesSinceText > 0 ? frameMsSinceText / framesSinceText : 0.0;
+    lastSteps = steps;
+
+    std::snprintf(line, sizeof(line), "%5.1f fps  %6.2f ms/frame  %6.1f steps/s", fps, meanFrameMs, stepsPerSecond);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "step %lld  grid %dx%d  active tiles %d", solver.GetStepCount(),
+        solver.GetNX(), solver.GetNY(), solver.GetActiveTileCount());
+    lines.push_back(line);
+    lines.push_back("phase            mean ms  iters  residual");
+
+    // the phase lines follow in GRAPH_PHASES order so the legend lines up
+    bool residuals = profiler.IsTrackingResiduals();
+    for (ProfilePhase p : GRAPH_PHASES) {
+        int n = std::snprintf(line, sizeof(line), "%-16s %8.3f", SolverProfiler::PhaseName(p), profiler.GetStats(p).meanMs);
+        if (p == PHASE_DIFFUSE_VELOCITY || p == PHASE_PROJECT || p == PHASE_DIFFUSE_DENSITY) {
+            if (residuals) {
+                std::snprintf(line + n, sizeof(line) - n, "  %5d  %.2e", profiler.GetIterations(p), profiler.GetResidual(p));
+            }
+            else {
+                std::snprintf(line + n, sizeof(line) - n, "  %5d", profiler.GetIterations(p));
+            }
+        }
+        lines.push_back(line);
+    }
+    std::snprintf(line, sizeof(line), "%-16s %8.3f", SolverProfiler::PhaseName(PHASE_SET_BOUNDARY),
+        profiler.GetStats(PHASE_SET_BOUNDARY).meanMs);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "%-16s %8.3f", "step", profiler.GetStats(PHASE_STEP).meanMs);
+    lines.push_back(line);
+
+    std::snprintf(line, sizeof(line), "hud %.3f ms   H hides", costMs);
+    lines.push_back(line);
+}
+
+void HudOverlay::addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1,
+    const unsigned char* rgba)
+{
+    Vertex a = { x0, y0, u0, v0, rgba[0], rgba[1], rgba[2], rgba[3] };
+    Vertex b = { x1, y0, u1, v0, rgba[0], rgba[1], rgba[2], rgba[3] };
+    Vertex c = { x1, y1, u1, v1, rgba[0], rgba[1], rgba[2], rgba[3] };
+    Vertex d = { x0, y1, u0, v1, rgba[0], rgba[1], rgba[2], rgba[3] };
+    vertices.push_back(a);
+    vertices.push_back(b);
+    vertices.push_back(c);
+    vertices.push_back(c);
+    vertices.push_back(d);
+    vertices.push_back(a);
+}
+
+void HudOverlay::addRect(float x0, float y0, float x1, float y1, const unsigned char* rgba)
+{
+    // the middle of the solid cell
+    float u = (FONT_SOLID * FONT_CELL_W + FONT_CELL_W * 0.5f) / (FONT_CELLS * FONT_CELL_W);
+    addQuad(x0, y0, x1, y1, u, 0.5f, u, 0.5f, rgba);
+}
+
+void HudOverlay::addText(float x, float y, const char* text, int scale, const unsigned char* rgba)
+{
+    float atlasWidth = static_cast<float>(FONT_CELLS * FONT_CELL_W);
+    for (const char* c = text; *c; c++, x += FONT_CELL_W * scale) {
+        int g = *c - ' ';
+        if (g <= 0 || g >= FONT_SOLID) {
+            continue;
+        }
+        addQuad(x, y, x + FONT_CELL_W * scale, y + FONT_CELL_H * scale,
+            g * FONT_CELL_W / atlasWidth, 0.0f, (g + 1) * FONT_CELL_W / atlasWidth, 1.0f, rgba);
+    }
+}
+
+void HudOverlay::draw(int width, int height)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    TRACE_SCOPE("DrawHud");
+    auto start = std::chrono::steady_clock::now();
+
+    // double size on large (high dpi) framebuffers
+    int scale = height >= 1400 ? 2 : 1;
+    float margin = 8.0f * scale;
+    float lineHeight = 10.0f * scale;
+    float barWidth = 2.0f * scale;
+    float graphWidth = HUD_HISTORY * barWidth;
+    float graphHeight = 48.0f * scale;
+
+    size_t columns = 0;
+    for (const std::string& line : lines) {
+        columns = std::max(columns, line.size());
+    }
+    float textWidth = (columns + 2) * FONT_CELL_W * scale;
+    float panelWidth = std::max(textWidth, graphWidth) + 2.0f * margin;
+    float panelHeight = lines.size() * lineHeight + 2.0f * graphHeight + 4.0f * margin;
+
+    vertices.clear();
+    addRect(margin, margin, margin + panelWidth, margin + panelHeight, PANEL_COLOR);
+
+    // text, with a colour key in front of each graphed phase
+    float x = 2.0f * margin;
+    float y = 2.0f * margin;
+    for (size_t l = 0; l < lines.size(); l++) {
+        int phase = static_cast<int>(l) - HUD_PHASE_LINE;
+        if (phase >= 0 && phase < GRAPH_PHASE_COUNT) {
+            addRect(x, y + scale, x + 5.0f * scale, y + 6.0f * scale, PHASE_COLORS[phase]);
+        }
+        addText(x + 2 * FONT_CELL_W * scale, y, lines[l].c_str(), scale, TEXT_COLOR);
+        y += lineHeight;
+    }
+
+    // frame time, oldest on the left, scaled to at least 33 ms with a mark at 16.7 ms
+    y += margin;
+    float frameMax = 33.3f;
+    for (int k = 0; k < historyCount; k++) {
+        frameMax = std::max(frameMax, frameHistory[k]);
+    }
+    addRect(x, y, x + graphWidth, y + graphHeight, GRAPH_COLOR);
+    int oldest = (historyNext - historyCount + HUD_HISTORY) % HUD_HISTORY;
+    for (int k = 0; k < historyCount; k++) {
+        float ms = frameHistory[(oldest + k) % HUD_HISTORY];
+        float bx = x + (HUD_HISTORY - historyCount + k) * barWidth;
+        addRect(bx, y + graphHeight * (1.0f - ms / frameMax), bx + barWidth, y + graphHeight, FRAME_COLOR);
+    }
+    float mark = y + graphHeight * (1.0f - 16.7f / frameMax);
+    addRect(x, mark, x + graphWidth, mark + scale, MARK_COLOR);
+
+    // step time stacked by phase
+    y += graphHeight + margin;
+    float stepMax = 0.0f;
+    for (int k = 0; k < historyCount; k++) {
+        stepMax = std::max(stepMax, phaseHistory[k][PHASE_STEP]);
+    }
+    addRect(x, y, x + graphWidth, y + graphHeight, GRAPH_COLOR);
+    if (stepMax > 0.0f) {
+        for (int k = 0; k < historyCount; k++) {
+            const float* ms = phaseHistory[(oldest + k) % HUD_HISTORY];
+            float bx = x + (HUD_HISTORY - historyCount + k) * barWidth;
+            float top = y + graphHeight;
+            for (int p = 0; p < GRAPH_PHASE_COUNT; p++) {
+                float h = graphHeight * ms[GRAPH_PHASES[p]] / stepMax;
+                addRect(bx, top - h, bx + barWidth, top, PHASE_COLORS[p]);
+                top -= h;
+            }
+        }
+    }
+
+    // one upload and one draw call, blended over the scene
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(program);
+    glUniform2f(glGetUniformLocation(program, "screen"), static_cast<float>(width), static_cast<float>(height));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisable(GL_BLEND);
+
+    costMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,88 @@
+#ifndef HUDOVERLAY_H
+#define HUDOVERLAY_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SolverProfiler.h"
+
+class FluidSolver;
+
+// frames kept for the HUD graphs
+#define HUD_HISTORY 128
+
+// on-screen performance readout: frame and step rates, per-phase solver
+// times, relaxation iterations and residuals as text, plus graphs of the
+// frame time and of the step split by phase.
+//
+// everything is one vertex buffer of textured quads drawn in a single
+// call: text from a built-in 5x7 bitmap font, panels and graph bars from a
+// solid texel of the same atlas. the text is refreshed a few times a
+// second so it stays readable, the graphs every frame.
+class HudOverlay {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, creates the GL objects so needs a current context
+    HudOverlay();
+
+    // destructor, call while the context is still current
+    ~HudOverlay();
+
+    // record one frame's wall time and the solver's counters after its steps
+    void addFrame(double frameMs, const FluidSolver& solver);
+
+    // draw over the current framebuffer
+    void draw(int width, int height);
+
+    // CPU time of the last addFrame + draw
+    double getCostMs() const { return costMs; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    struct Vertex {
+        float x, y;
+        float u, v;
+        unsigned char r, g, b, a;
+    };
+
+    GLuint program;
+    GLuint fontTexture;
+    GLuint VAO, VBO;
+    std::vector<Vertex> vertices;
+
+    // graph history, a ring of HUD_HISTORY frames
+    float frameHistory[HUD_HISTORY];
+    float phaseHistory[HUD_HISTORY][PHASE_COUNT];
+    int historyNext;
+    int historyCount;
+
+    // text and the counters it was last computed from
+    std::vector<std::string> lines;
+    std::chrono::steady_clock::time_point lastText;
+    long long lastSteps;
+    int framesSinceText;
+    double frameMsSinceText;
+
+    double costMs;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void buildText(const FluidSolver& solver, double seconds);
+    void addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const unsigned char* rgba);
+    void addRect(float x0, float y0, float x1, float y1, const unsigned char* rgba);
+    void addText(float x, float y, const char* text, int scale, const unsigned char* rgba);
+};
+
+#endif // HUDOVERLAY_H
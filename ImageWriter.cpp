@@ -0,0 +1,439 @@
+#include "ImageWriter.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// POSIX popen takes no binary flag
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_WRITE_MODE "wb"
+#else
+#define PIPE_WRITE_MODE "w"
+#endif
+
+// ==================================================
+// COLORMAPS
+// ==================================================
+
+// matplotlib's inferno at eleven evenly spaced points
+static const unsigned char INFERNO_POINTS[11][3] = {
+    {   0,   0,   4 }, {  22,  11,  57 }, {  66,  10, 104 }, { 106,  23, 110 },
+    { 147,  38, 103 }, { 188,  55,  84 }, { 221,  81,  58 }, { 243, 120,  25 },
+    { 252, 165,  10 }, { 246, 215,  70 }, { 252, 255, 164 }
+};
+
+// 256 RGB entries, built on first use
+static const unsigned char* ColormapTable(Colormap colormap)
+{
+    static unsigned char gray[256 * 3];
+    static unsigned char inferno[256 * 3];
+    static bool built = [] {
+        for (int i = 0; i < 256; i++) {
+            gray[i * 3] = gray[i * 3 + 1] = gray[i * 3 + 2] = static_cast<unsigned char>(i);
+
+            float t = i / 255.0f * 10.0f;
+            int k = std::min(static_cast<int>(t), 9);
+            float f = t - k;
+            for (int c = 0; c < 3; c++) {
+                float value = INFERNO_POINTS[k][c] + f * (INFERNO_POINTS[k + 1][c] - INFERNO_POINTS[k][c]);
+                inferno[i * 3 + c] = static_cast<unsigned char>(value + 0.5f);
+            }
+        }
+        return true;
+    }();
+    (void)built;
+    return colormap == Colormap::INFERNO ? inferno : gray;
+}
+
+void RenderField(const float* field, int fieldWidth, int fieldHeight, const FieldView& view,
+    float lo, float hi, Colormap colormap, int width, int height, std::vector<float>& scratch,
+    unsigned char* rgb, ThreadPool* pool)
+{
+    TRACE_SCOPE("RenderField");
+
+    scratch.resize(static_cast<size_t>(width) * height);
+    DownsampleField(field, fieldWidth, fieldHeight, view, scratch.data(), width, height, DownsampleFilter::BOX, pool);
+
+    const unsigned char* table = ColormapTable(colormap);
+    float scale = (hi > lo) ? 255.0f / (hi - lo) : 0.0f;
+    for (int y = 0; y < height; y++) {
+        // field rows run bottom up, image rows top down
+        const float* src = scratch.data() + static_cast<size_t>(height - 1 - y) * width;
+        unsigned char* dst = rgb + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; x++) {
+            // written so NaN lands on 0
+            float t = (src[x] - lo) * scale;
+            int index = (t > 0.0f) ? static_cast<int>(std::min(t, 255.0f) + 0.5f) : 0;
+            std::memcpy(dst + x * 3, table + index * 3, 3);
+        }
+    }
+}
+
+// ==================================================
+// DEFLATE
+// ==================================================
+
+// bits go out least significant first, as deflate packs them
+struct BitWriter {
+    std::vector<unsigned char>& out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+    void Put(uint32_t value, int n) {
+        bits |= static_cast<uint64_t>(value) << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(static_cast<unsigned char>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void PutCode(uint32_t code, int n) {
+        uint32_t reversed = 0;
+        for (int b = 0; b < n; b++) {
+            reversed = (reversed << 1) | ((code >> b) & 1);
+        }
+        Put(reversed, n);
+    }
+
+    void Flush() {
+        if (count > 0) {
+            out.push_back(static_cast<unsigned char>(bits));
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+static int FloorLog2(unsigned v)
+{
+    int log = 0;
+    while (v >>= 1) {
+        log++;
+    }
+    return log;
+}
+
+// fixed literal/length code of RFC 1951 3.2.6
+static void PutLiteral(BitWriter& writer, int symbol)
+{
+    if (symbol < 144) writer.PutCode(0x30 + symbol, 8);
+    else if (symbol < 256) writer.PutCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280) writer.PutCode(symbol - 256, 7);
+    else writer.PutCode(0xc0 + symbol - 280, 8);
+}
+
+static void PutMatch(BitWriter& writer, int length, int distance)
+{
+    // length 3 .. 258, codes 257 .. 285
+    int m = length - 3;
+    if (length == 258) {
+        PutLiteral(writer, 285);
+    }
+    else if (m < 8) {
+        PutLiteral(writer, 257 + m);
+    }
+    else {
+        int log = FloorLog2(m);
+        int extraBits = log - 2;
+        int low = (m >> extraBits) & 3;
+        PutLiteral(writer, 257 + 4 * (log - 1) + low);
+        writer.Put(m - ((4 + low) << extraBits), extraBits);
+    }
+
+    // distance 1 .. 32768, five bit codes 0 .. 29
+    int d = distance - 1;
+    if (d < 4) {
+        writer.PutCode(d, 5);
+    }
+    else {
+        int log = FloorLog2(d);
+        int extraBits = log - 1;
+        int low = (d >> extraBits) & 1;
+        writer.PutCode(2 * log + low, 5);
+        writer.Put(d - ((2 + low) << extraBits), extraBits);
+    }
+}
+
+// zlib stream of one fixed Huffman block. matches come from a single
+// candidate per 3-byte hash, taken greedily: far from optimal, but
+// colormapped fields are long runs and repeated rows, which this catches
+static void Deflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    const int HASH_BITS = 15;
+    const int WINDOW = 32768;
+    const int MAX_MATCH = 258;
+
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    BitWriter writer(out);
+    writer.Put(1, 1);   // final block
+    writer.Put(1, 2);   // fixed Huffman codes
+
+    std::vector<int64_t> head(static_cast<size_t>(1) << HASH_BITS, -1);
+    auto hash = [&](size_t i) {
+        uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        int length = 0;
+        size_t distance = 0;
+        if (i + 3 <= size) {
+            uint32_t h = hash(i);
+            int64_t candidate = head[h];
+            head[h] = static_cast<int64_t>(i);
+            if (candidate >= 0 && i - candidate <= WINDOW) {
+                size_t limit = std::min(static_cast<size_t>(MAX_MATCH), size - i);
+                const unsigned char* a = data + candidate;
+                const unsigned char* b = data + i;
+                while (length < static_cast<int>(limit) && a[length] == b[length]) {
+                    length++;
+                }
+                distance = i - candidate;
+            }
+        }
+
+        if (length >= 3) {
+            PutMatch(writer, length, static_cast<int>(distance));
+            // positions inside the match become candidates too
+            for (size_t k = i + 1; k < i + length && k + 3 <= size; k++) {
+                head[hash(k)] = static_cast<int64_t>(k);
+            }
+            i += length;
+        }
+        else {
+            PutLiteral(writer, data[i]);
+            i++;
+        }
+    }
+    PutLiteral(writer, 256);
+    writer.Flush();
+
+    uint32_t a = 1, b = 0;
+    for (size_t k = 0; k < size; k++) {
+        a = (a + data[k]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<unsigned char>(adler >> shift));
+    }
+}
+
+// ==================================================
+// PNG
+// ==================================================
+
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool built = [] {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)built;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void PutU32BE(std::vector<unsigned char>& out, uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<unsigned char>(v >> shift));
+    }
+}
+
+static void PutChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+    PutU32BE(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutU32BE(out, Crc32(out.data() + start, out.size() - start));
+}
+
+bool WritePng(const char* path, const unsigned char* rgb, int width, int height)
+{
+    TRACE_SCOPE("WritePng");
+
+    // each row takes whichever of the none, sub and up filters leaves the
+    // smallest residuals, the usual cheap heuristic
+    size_t stride = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    std::vector<unsigned char> candidate[3];
+    for (std::vector<unsigned char>& c : candidate) {
+        c.resize(stride);
+    }
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = rgb + y * stride;
+        const unsigned char* up = y > 0 ? row - stride : nullptr;
+        long long cost[3] = { 0, 0, 0 };
+        for (size_t x = 0; x < stride; x++) {
+            unsigned char left = x >= 3 ? row[x - 3] : 0;
+            unsigned char above = up ? up[x] : 0;
+            candidate[0][x] = row[x];
+            candidate[1][x] = static_cast<unsigned char>(row[x] - left);
+            candidate[2][x] = static_cast<unsigned char>(row[x] - above);
+            for (int f = 0; f < 3; f++) {
+                cost[f] += std::abs(static_cast<signed char>(candidate[f][x]));
+            }
+        }
+        int best = static_cast<int>(std::min_element(cost, cost + 3) - cost);
+        unsigned char* dst = filtered.data() + y * (stride + 1);
+        dst[0] = static_cast<unsigned char>(best);
+        std::memcpy(dst + 1, candidate[best].data(), stride);
+    }
+
+    std::vector<unsigned char> header;
+    PutU32BE(header, static_cast<uint32_t>(width));
+    PutU32BE(header, static_cast<uint32_t>(height));
+    // 8 bits per channel, RGB, deflate, adaptive filtering, not interlaced
+    const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+    header.insert(header.end(), format, format + 5);
+
+    std::vector<unsigned char> compressed;
+    Deflate(filtered.data(), filtered.size(), compressed);
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> png(signature, signature + 8);
+    PutChunk(png, "IHDR", header);
+    PutChunk(png, "IDAT", compressed);
+    PutChunk(png, "IEND", std::vector<unsigned char>());
+
+    FILE* out = std::fopen(path, "wb");
+    if (!out) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return false;
+    }
+    size_t written = std::fwrite(png.data(), 1, png.size(), out);
+    bool ok = (std::fclose(out) == 0) && written == png.size();
+    if (!ok) {
+        std::cerr << "Error: short write to " << path << std::endl;
+    }
+    return ok;
+}
+
+// ==================================================
+// Y4M
+// ==================================================
+
+// constructor
+Y4mWriter::Y4mWriter()
+    : file(nullptr), pipe(false), failed(false), width(0), height(0)
+{
+}
+
+// destructor
+Y4mWriter::~Y4mWriter()
+{
+    Close();
+}
+
+bool Y4mWriter::Open(const char* target, int width, int height, int fps)
+{
+    Close();
+
+    pipe = target[0] == '|';
+    file = pipe ? popen(target + 1, PIPE_WRITE_MODE) : std::fopen(target, "wb");
+    if (!file) {
+        std::cerr << "Error: cannot open " << target << std::endl;
+        return false;
+    }
+    failed = false;
+    this->width = width;
+    this->height = height;
+
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    planes.resize(static_cast<size_t>(width) * height + 2 * static_cast<size_t>(chromaWidth) * chromaHeight);
+
+    if (std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps) < 0) {
+        failed = true;
+    }
+    return !failed;
+}
+
+bool Y4mWriter::WriteFrame(const unsigned char* rgb)
+{
+    if (!file) {
+        return false;
+    }
+    TRACE_SCOPE("WriteY4mFrame");
+
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    unsigned char* yPlane = planes.data();
+    unsigned char* uPlane = yPlane + static_cast<size_t>(width) * height;
+    unsigned char* vPlane = uPlane + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    // BT.601 limited range in 8.8 fixed point, chroma from the mean colour
+    // of each 2 x 2 block (clamped at odd edges)
+    for (int y = 0; y < height; y++) {
+        const unsigned char* p = rgb + static_cast<size_t>(y) * width * 3;
+        unsigned char* dst = yPlane + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++) {
+            int r = p[x * 3], g = p[x * 3 + 1], b = p[x * 3 + 2];
+            dst[x] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++) {
+        int y0 = 2 * cy, y1 = std::min(2 * cy + 1, height - 1);
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            int x0 = 2 * cx, x1 = std::min(2 * cx + 1, width - 1);
+            int sum[3] = { 0, 0, 0 };
+            const int xs[2] = { x0, x1 };
+            const int ys[2] = { y0, y1 };
+            for (int yy : ys) {
+                for (int xx : xs) {
+                    const unsigned char* p = rgb + (static_cast<size_t>(yy) * width + xx) * 3;
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            int r = (sum[0] + 2) >> 2, g = (sum[1] + 2) >> 2, b = (sum[2] + 2) >> 2;
+            size_t c = static_cast<size_t>(cy) * chromaWidth + cx;
+            uPlane[c] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[c] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    if (std::fputs("FRAME\n", file) < 0 || std::fwrite(planes.data(), 1, planes.size(), file) != planes.size()) {
+        if (!failed) {
+            std::cerr << "Error: short write to the video stream" << std::endl;
+        }
+        failed = true;
+    }
+    return !failed;
+}
+
+bool Y4mWriter::Close()
+{
+    if (!file) {
+        return true;
+    }
+    int status = pipe ? pclose(file) : std::fclose(file);
+    file = nullptr;
+    return status == 0 && !failed;
+}
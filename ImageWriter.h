@@ -0,0 +1,65 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <cstdio>
+#include <vector>
+#include "DisplayDownsample.h"
+
+class ThreadPool;
+
+enum class Colormap {
+    GRAY,
+    INFERNO     // black through purple and orange to pale yellow
+};
+
+// fill rgb (3 bytes per pixel, top row first) with the view of a
+// fieldWidth x fieldHeight field resampled to width x height, values from
+// lo to hi spread over the colormap. scratch holds the resampled floats
+void RenderField(const float* field, int fieldWidth, int fieldHeight, const FieldView& view,
+    float lo, float hi, Colormap colormap, int width, int height, std::vector<float>& scratch,
+    unsigned char* rgb, ThreadPool* pool);
+
+// 8-bit RGB PNG, deflated with fixed Huffman codes and a greedy LZ77 pass
+bool WritePng(const char* path, const unsigned char* rgb, int width, int height);
+
+// YUV4MPEG2 video (4:2:0, BT.601 limited range) to a file, or to the stdin
+// of a command when the target starts with '|', e.g.
+// "|ffmpeg -y -i - -c:v libx264 out.mp4"
+class Y4mWriter {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    Y4mWriter();
+
+    // destructor, closes the stream
+    ~Y4mWriter();
+
+    bool Open(const char* target, int width, int height, int fps = 30);
+
+    // one width x height RGB frame, top row first
+    bool WriteFrame(const unsigned char* rgb);
+
+    // false if a write failed or the command exited with an error
+    bool Close();
+
+    bool IsOpen() const { return file != nullptr; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    FILE* file;
+    bool pipe;
+    bool failed;
+    int width, height;
+    std::vector<unsigned char> planes;
+};
+
+#endif // IMAGEWRITER_H
@@ -0,0 +1,216 @@
+#include "InputLog.h"
+#include "FluidSolver.h"
+#include <cstring>
+#include <iostream>
+
+static const char INPUT_LOG_MAGIC[4] = { 'F', 'S', 'I', 'N' };
+
+// offset of the step count in the header
+static const long INPUT_LOG_STEPS_OFFSET = 4 + 4 + 4 * 4;
+
+static void WriteVarint(FILE* f, unsigned long long v)
+{
+    while (v >= 0x80) {
+        std::fputc(static_cast<int>((v & 0x7f) | 0x80), f);
+        v >>= 7;
+    }
+    std::fputc(static_cast<int>(v), f);
+}
+
+static bool ReadVarint(const unsigned char*& p, const unsigned char* end, unsigned long long& v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        v |= static_cast<unsigned long long>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ==================================================
+// RECORDER
+// ==================================================
+
+// constructor
+InputRecorder::InputRecorder() : file(nullptr), startStep(0), blockStep(0), eventCount(0)
+{
+}
+
+// destructor
+InputRecorder::~InputRecorder()
+{
+    if (file) {
+        // without a step count the log ends after its last input
+        long long last = pending.empty() ? blockStep : pending.back().step;
+        Close(startStep + last + 1);
+    }
+}
+
+bool InputRecorder::Open(const char* path, const FluidSolver& solver)
+{
+    if (file) {
+        Close(solver.GetStepCount());
+    }
+
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Error: cannot open input log " << path << std::endl;
+        return false;
+    }
+
+    uint32_t version = INPUT_LOG_VERSION;
+    int32_t config[4] = { solver.GetNX(), solver.GetNY(), solver.GetVelocityScale(),
+        static_cast<int32_t>(solver.GetBoundaryCondition()) };
+    int64_t steps = 0;
+    std::fwrite(INPUT_LOG_MAGIC, 1, 4, file);
+    std::fwrite(&version, sizeof(version), 1, file);
+    std::fwrite(config, sizeof(config), 1, file);
+    std::fwrite(&steps, sizeof(steps), 1, file);
+
+    startStep = solver.GetStepCount();
+    blockStep = 0;
+    eventCount = 0;
+    pending.clear();
+    return true;
+}
+
+void InputRecorder::Record(long long stepCount, FieldType fieldType, int i, int j, float s)
+{
+    if (!file) {
+        return;
+    }
+    long long step = stepCount - startStep;
+    if (!pending.empty() && pending.back().step != step) {
+        Flush();
+    }
+    pending.push_back({ step, fieldType, i, j, s });
+    eventCount++;
+}
+
+void InputRecorder::Flush()
+{
+    if (pending.empty()) {
+        return;
+    }
+
+    // steps are delta coded against the previous block (the first against 0)
+    long long step = pending.front().step;
+    WriteVarint(file, static_cast<unsigned long long>(step - blockStep));
+    WriteVarint(file, pending.size());
+    for (const InputEvent& e : pending) {
+        uint8_t field = static_cast<uint8_t>(e.fieldType);
+        int32_t i = e.i;
+        int32_t j = e.j;
+        std::fwrite(&field, 1, 1, file);
+        std::fwrite(&i, sizeof(i), 1, file);
+        std::fwrite(&j, sizeof(j), 1, file);
+        std::fwrite(&e.s, sizeof(e.s), 1, file);
+    }
+
+    blockStep = step;
+    pending.clear();
+}
+
+void InputRecorder::Close(long long stepCount)
+{
+    if (!file) {
+        return;
+    }
+    Flush();
+
+    int64_t total = stepCount - startStep;
+    std::fseek(file, INPUT_LOG_STEPS_OFFSET, SEEK_SET);
+    std::fwrite(&total, sizeof(total), 1, file);
+    std::fclose(file);
+    file = nullptr;
+}
+
+// ==================================================
+// REPLAY
+// ==================================================
+
+bool InputReplay::Open(const char* path)
+{
+    events.clear();
+    cursor = 0;
+
+    FILE* f = std::fopen(path, "rb");
+    if (!f) {
+        std::cerr << "Error: cannot open input log " << path << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    std::fclose(f);
+
+    uint32_t version = 0;
+    int32_t config[4];
+    int64_t steps = 0;
+    if (data.size() < INPUT_LOG_STEPS_OFFSET + sizeof(steps) ||
+        std::memcmp(data.data(), INPUT_LOG_MAGIC, 4) != 0) {
+        std::cerr << "Error: " << path << " is not an input log." << std::endl;
+        return false;
+    }
+    std::memcpy(&version, data.data() + 4, sizeof(version));
+    if (version != INPUT_LOG_VERSION) {
+        std::cerr << "Error: unsupported input log version " << version << "." << std::endl;
+        return false;
+    }
+    std::memcpy(config, data.data() + 8, sizeof(config));
+    std::memcpy(&steps, data.data() + INPUT_LOG_STEPS_OFFSET, sizeof(steps));
+    header = { config[0], config[1], config[2], config[3], steps };
+    if (header.nx <= 0 || header.ny <= 0) {
+        std::cerr << "Error: invalid grid in input log " << path << "." << std::endl;
+        return false;
+    }
+
+    const unsigned char* p = data.data() + INPUT_LOG_STEPS_OFFSET + sizeof(steps);
+    const unsigned char* end = data.data() + data.size();
+    const size_t eventBytes = 1 + 4 + 4 + 4;
+    long long step = 0;
+    while (p < end) {
+        unsigned long long delta, count;
+        // divided rather than multiplied, a corrupt count cannot overflow
+        if (!ReadVarint(p, end, delta) || !ReadVarint(p, end, count) ||
+            count > static_cast<size_t>(end - p) / eventBytes) {
+            std::cerr << "Error: truncated input log " << path << "." << std::endl;
+            return false;
+        }
+        step += static_cast<long long>(delta);
+        for (unsigned long long e = 0; e < count; e++) {
+            int32_t i, j;
+            float s;
+            std::memcpy(&i, p + 1, sizeof(i));
+            std::memcpy(&j, p + 5, sizeof(j));
+            std::memcpy(&s, p + 9, sizeof(s));
+
+            // the solver indexes its arrays with these unchecked
+            if (p[0] > VELOCITY_V || i < 1 || i > header.nx || j < 1 || j > header.ny) {
+                std::cerr << "Error: input outside the grid in input log " << path << "." << std::endl;
+                events.clear();
+                return false;
+            }
+            events.push_back({ step, static_cast<FieldType>(p[0]), i, j, s });
+            p += eventBytes;
+        }
+    }
+    return true;
+}
+
+void InputReplay::Apply(FluidSolver& solver, long long step)
+{
+    while (cursor < events.size() && events[cursor].step <= step) {
+        const InputEvent& e = events[cursor++];
+        // a solver of another size than the log's gets only the inputs it holds
+        if (e.i <= solver.GetNX() && e.j <= solver.GetNY()) {
+            solver.AddInputToField(e.fieldType, e.i, e.j, e.s);
+        }
+    }
+}
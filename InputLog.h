@@ -0,0 +1,118 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "Grid.h"
+
+class FluidSolver;
+
+// one AddInputToField call, tagged with the step it precedes (counted
+// from the start of the recording)
+struct InputEvent {
+    long long step;
+    FieldType fieldType;
+    int i, j;
+    float s;
+};
+
+// solver configuration stored in the log header so a replay rebuilds the
+// same solver
+struct InputLogHeader {
+    int nx, ny;
+    int velocityScale;
+    int boundary;
+    // steps run while recording, so the replay also runs the idle tail
+    long long steps;
+};
+
+// binary input log, little-endian:
+//   "FSIN", u32 version, i32 nx, ny, velocityScale, boundary, i64 steps
+//   then one block per step with input: varint step delta, varint count,
+//   count x (u8 field, i32 i, i32 j, f32 s)
+#define INPUT_LOG_VERSION 2
+
+// captures every input a FluidSolver receives. attach with
+// FluidSolver::SetInputRecorder; events are buffered per step and flushed
+// when the step changes.
+class InputRecorder {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    InputRecorder();
+
+    // destructor, closes the log
+    ~InputRecorder();
+
+    // start a log for this solver's configuration at its current step
+    bool Open(const char* path, const FluidSolver& solver);
+    // flush, patch the steps run since Open into the header and close.
+    // stepCount is the solver's FluidSolver::GetStepCount()
+    void Close(long long stepCount);
+    bool IsOpen() const { return file != nullptr; }
+
+    // called by the solver with its step counter
+    void Record(long long stepCount, FieldType fieldType, int i, int j, float s);
+
+    long long GetEventCount() const { return eventCount; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    FILE* file;
+    // solver step at Open and the step of the last written block
+    long long startStep;
+    long long blockStep;
+    long long eventCount;
+    std::vector<InputEvent> pending;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void Flush();
+};
+
+// reads a log back and feeds it to a solver step by step
+class InputReplay {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // load the whole log into memory, false if it is truncated or holds
+    // an unknown field or a cell outside 1..nx, 1..ny
+    bool Open(const char* path);
+
+    const InputLogHeader& GetHeader() const { return header; }
+    long long GetEventCount() const { return static_cast<long long>(events.size()); }
+
+    // apply every event recorded before `step`, call once per step in order
+    void Apply(FluidSolver& solver, long long step);
+
+    // restart from the first event
+    void Rewind() { cursor = 0; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    InputLogHeader header = { 0, 0, 1, 0, 0 };
+    std::vector<InputEvent> events;
+    size_t cursor = 0;
+};
+
+#endif // INPUTLOG_H
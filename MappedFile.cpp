@@ -0,0 +1,273 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// constructor
+MappedFile::MappedFile() : data(nullptr), size(0)
+#ifdef _WIN32
+    , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#else
+    , fd(-1)
+#endif
+{
+}
+
+// destructor
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Create(const char* path, size_t bytes)
+{
+    Close();
+
+    std::string temp = std::string(path) + ".tmp";
+    fileHandle = CreateFileA(temp.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error: cannot create " << temp << std::endl;
+        return false;
+    }
+    targetPath = path;
+    tempPath = temp;
+
+    // sizing the file allocates it, so a full disk fails here rather than
+    // when the pages are written back
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(bytes);
+    if (!SetFilePointerEx(fileHandle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(fileHandle)) {
+        std::cerr << "Error: cannot reserve " << bytes << " bytes for " << temp << std::endl;
+        Close();
+        return false;
+    }
+
+    unsigned long long size64 = bytes;
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffffu), nullptr);
+    if (!mappingHandle) {
+        std::cerr << "Error: cannot map " << temp << std::endl;
+        Close();
+        return false;
+    }
+
+    data = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, bytes));
+    if (!data) {
+        std::cerr << "Error: cannot map " << temp << std::endl;
+        Close();
+        return false;
+    }
+    size = bytes;
+    return true;
+}
+
+bool MappedFile::Commit()
+{
+    if (tempPath.empty()) {
+        return false;
+    }
+
+    bool ok = FlushViewOfFile(data, 0) && FlushFileBuffers(fileHandle);
+    std::string temp = tempPath;
+    std::string target = targetPath;
+    // keep the temporary file through Close, it is removed below on failure
+    tempPath.clear();
+    Close();
+
+    if (!ok || !MoveFileExA(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        std::cerr << "Error: cannot write " << target << std::endl;
+        DeleteFileA(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Open(const char* path, bool copyOnWrite)
+{
+    Close();
+
+    fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        std::cerr << "Error: " << path << " is empty." << std::endl;
+        Close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY,
+        0, 0, nullptr);
+    if (!mappingHandle) {
+        std::cerr << "Error: cannot map " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    data = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ,
+        0, 0, 0));
+    if (!data) {
+        std::cerr << "Error: cannot map " << path << std::endl;
+        Close();
+        return false;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+    }
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+
+    // an uncommitted file is abandoned
+    if (!tempPath.empty()) {
+        DeleteFileA(tempPath.c_str());
+        tempPath.clear();
+    }
+    targetPath.clear();
+}
+
+#else
+
+bool MappedFile::Create(const char* path, size_t bytes)
+{
+    Close();
+
+    // written beside the target and renamed over it, so a crash or a
+    // mapping of the old file never sees a partial checkpoint
+    std::string temp = std::string(path) + ".tmp";
+    fd = open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: cannot create " << temp << std::endl;
+        return false;
+    }
+    targetPath = path;
+    tempPath = temp;
+
+    // reserve the blocks up front: a full disk is an error here instead of
+    // a SIGBUS when the mapping is written
+#ifdef __APPLE__
+    int reserved = ftruncate(fd, static_cast<off_t>(bytes)) == 0 ? 0 : errno;
+#else
+    int reserved = posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+#endif
+    if (reserved != 0) {
+        std::cerr << "Error: cannot reserve " << bytes << " bytes for " << temp << ": " << std::strerror(reserved) << std::endl;
+        Close();
+        return false;
+    }
+
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "Error: cannot map " << temp << std::endl;
+        Close();
+        return false;
+    }
+    data = static_cast<unsigned char*>(p);
+    size = bytes;
+    return true;
+}
+
+bool MappedFile::Commit()
+{
+    if (tempPath.empty()) {
+        return false;
+    }
+
+    bool ok = msync(data, size, MS_SYNC) == 0 && fsync(fd) == 0;
+    std::string temp = tempPath;
+    std::string target = targetPath;
+    // keep the temporary file through Close, it is removed below on failure
+    tempPath.clear();
+    Close();
+
+    if (!ok || rename(temp.c_str(), target.c_str()) != 0) {
+        std::cerr << "Error: cannot write " << target << std::endl;
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Open(const char* path, bool copyOnWrite)
+{
+    Close();
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Error: " << path << " is empty." << std::endl;
+        Close();
+        return false;
+    }
+
+    size_t bytes = static_cast<size_t>(st.st_size);
+    void* p = copyOnWrite ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+        : mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "Error: cannot map " << path << std::endl;
+        Close();
+        return false;
+    }
+    data = static_cast<unsigned char*>(p);
+    size = bytes;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) {
+        munmap(data, size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    data = nullptr;
+    size = 0;
+    fd = -1;
+
+    // an uncommitted file is abandoned
+    if (!tempPath.empty()) {
+        unlink(tempPath.c_str());
+        tempPath.clear();
+    }
+    targetPath.clear();
+}
+
+#endif
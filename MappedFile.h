@@ -0,0 +1,61 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// memory-mapped file (mmap on POSIX, file mappings on Windows). the
+// mapping is released by the destructor.
+class MappedFile {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    MappedFile();
+
+    // destructor
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // create `path`.tmp with `bytes` reserved on disk and map it writable.
+    // Commit flushes it and renames it over `path`; closing without a
+    // commit deletes it, so `path` is never left half written
+    bool Create(const char* path, size_t bytes);
+    bool Commit();
+
+    // map an existing file. copy-on-write mappings are writable but never
+    // change the file: pages are copied privately on first write
+    bool Open(const char* path, bool copyOnWrite);
+
+    void Close();
+
+    unsigned char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    unsigned char* data;
+    size_t size;
+    // target and temporary name of a created file until it is committed
+    std::string targetPath;
+    std::string tempPath;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+};
+
+#endif // MAPPEDFILE_H
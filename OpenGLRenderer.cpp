@@ -1,30 +1,118 @@
 #include "OpenGLRenderer.h"
 #include "FluidSolver.h"
+#include "HudOverlay.h"
+#include "ShaderUtil.h"
+#include "StepScheduler.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
-OpenGLRenderer::OpenGLRenderer(int width, int height, const char* title, int n, FluidSolver* fluidSolver)
+OpenGLRenderer::OpenGLRenderer(int width, int height, const char* title, int nx, int ny, FluidSolver* fluidSolver)
     : m_width(width),
     m_height(height),
     m_title(title),
     m_window(nullptr),
-    N(n),
+    glLoaded(false),
+    NX(nx),
+    NY(ny),
     m_fluidSolver(fluidSolver),
-    EBO(0),
     shaderProgram(0),
-    texture(0),
     VAO(0),
-    VBO(0)
+    VBO(0),
+    EBO(0),
+    texture(0),
+    pboIndex(0),
+    uploadBytes(static_cast<size_t>(nx + 2) * (ny + 2) * sizeof(float)),
+    uploadFormat(DisplayFormat::FLOAT32),
+    uploadScale(1.0f),
+    fusedConversion(false),
+    uploadedTexels(0),
+    totalTexels(0),
+    uploadStalls(0),
+    pboCapacity(0),
+    fullUploadPending(false),
+    textureAllocated(false),
+    lodTexture(0),
+    lodWidth(0),
+    lodHeight(0),
+    lodActive(false),
+    lodFilter(DownsampleFilter::BOX),
+    lodPool(nullptr),
+    lodView{ 0.0f, 0.0f, 0.0f, 0.0f },
+    fbWidth(width),
+    fbHeight(height),
+    viewZoom(1.0f),
+    viewCenterX((nx + 2) * 0.5f),
+    viewCenterY((ny + 2) * 0.5f),
+    pendingScroll(0.0),
+    panning(false),
+    panLastX(0.0),
+    panLastY(0.0),
+    glyphProgram(0),
+    lineProgram(0),
+    glyphVAO(0),
+    glyphShapeVBO(0),
+    glyphInstanceVBO(0),
+    lineVAO(0),
+    lineVBO(0),
+    lineVertexCount(0),
+    showGlyphs(false),
+    showStreamlines(false),
+    tracer(nullptr),
+    hud(nullptr),
+    showHud(false),
+    scheduler(nullptr)
 {
+    for (int k = 0; k < PBO_RING_SIZE; k++) {
+        pbo[k] = 0;
+        pboFence[k] = nullptr;
+    }
 }
 
 OpenGLRenderer::~OpenGLRenderer() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteTextures(1, &texture);
+    if (fusedConversion) {
+        m_fluidSolver->SetDisplayOutput(nullptr);
+    }
+    delete lodPool;
+    delete tracer;
+
+    // without a loaded context (initialize failed early) the gl calls
+    // are null pointers and there is nothing to delete
+    if (glLoaded) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteTextures(1, &texture);
+        glDeleteTextures(1, &lodTexture);
+        glDeleteProgram(shaderProgram);
+        for (int k = 0; k < PBO_RING_SIZE; k++) {
+            if (pboFence[k]) {
+                glDeleteSync(pboFence[k]);
+            }
+        }
+        glDeleteBuffers(PBO_RING_SIZE, pbo);
+        delete hud;
+        glDeleteVertexArrays(1, &glyphVAO);
+        glDeleteVertexArrays(1, &lineVAO);
+        GLuint overlayBuffers[] = { glyphShapeVBO, glyphInstanceVBO, lineVBO };
+        glDeleteBuffers(3, overlayBuffers);
+        glDeleteProgram(glyphProgram);
+        glDeleteProgram(lineProgram);
+    }
     glfwTerminate();
 }
 
+void OpenGLRenderer::setUploadFormat(DisplayFormat format, float scale, bool fused) {
+    uploadFormat = format;
+    uploadScale = scale;
+    fusedConversion = fused;
+    uploadBytes = static_cast<size_t>(NX + 2) * (NY + 2) * DisplayBytesPerTexel(format);
+}
+
 bool OpenGLRenderer::initialize() {
     // init glfw
     if (!glfwInit()) {
@@ -53,12 +141,17 @@ bool OpenGLRenderer::initialize() {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return false;
     }
+    glLoaded = true;
 
-    // set viewport
-    glViewport(0, 0, m_width, m_height);
+    // set viewport, the framebuffer can be larger than the window on high dpi screens
+    glfwGetFramebufferSize(m_window, &fbWidth, &fbHeight);
+    glViewport(0, 0, fbWidth, fbHeight);
 
-    // register framebuffer size callback
+    // register framebuffer size and scroll callbacks
+    glfwSetWindowUserPointer(m_window, this);
     glfwSetFramebufferSizeCallback(m_window, framebuffer_size_callback);
+    glfwSetScrollCallback(m_window, scroll_callback);
+    glfwSetKeyCallback(m_window, key_callback);
 
     // set shader buffrs textures
     setupShadersAndBuffers();
@@ -66,48 +159,22 @@ bool OpenGLRenderer::initialize() {
     return true;
 }
 
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, NULL);
-    glCompileShader(shader);
-
-    // error check
-    GLint success;
-    GLchar infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+static GLint textureInternalFormat(DisplayFormat format) {
+    switch (format) {
+    case DisplayFormat::HALF16: return GL_R16F;
+    case DisplayFormat::UNORM16: return GL_R16;
+    case DisplayFormat::UNORM8: return GL_R8;
+    default: return GL_R32F;
     }
-
-    return shader;
 }
 
-// create and link a shader program from vertex and fragment shader sources
-GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource) {
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-    // create shader program and link shaders
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // check for linking errors
-    GLint success;
-    GLchar infoLog[512];
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+static GLenum textureType(DisplayFormat format) {
+    switch (format) {
+    case DisplayFormat::HALF16: return GL_HALF_FLOAT;
+    case DisplayFormat::UNORM16: return GL_UNSIGNED_SHORT;
+    case DisplayFormat::UNORM8: return GL_UNSIGNED_BYTE;
+    default: return GL_FLOAT;
     }
-
-    // clean up shaders
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
 }
 
 void OpenGLRenderer::setupShadersAndBuffers() {
@@ -181,14 +248,462 @@ void OpenGLRenderer::setupShadersAndBuffers() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // 8 and 16-bit rows are not 4-byte multiples
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // window resolution texture, sized on first use
+    glGenTextures(1, &lodTexture);
+    glBindTexture(GL_TEXTURE_2D, lodTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    displayCopy.resize(uploadBytes);
+    if (fusedConversion) {
+        m_fluidSolver->SetDisplayOutput(displayCopy.data(), uploadFormat, uploadScale);
+    }
+
+    // upload ring, its storage is sized by the first upload so a grid that
+    // is only ever shown downsampled never gets grid sized buffers
+    glGenBuffers(PBO_RING_SIZE, pbo);
+
+    setupVelocityOverlay();
+    hud = new HudOverlay();
+}
+
+void OpenGLRenderer::setHudVisible(bool visible) {
+    showHud = visible;
+    m_fluidSolver->GetProfiler().SetResidualTracking(visible);
+}
+
+void OpenGLRenderer::setupVelocityOverlay() {
+    // arrows: a unit shape along +x, turned, scaled and placed per instance.
+    // positions are in density cells and mapped through the current view
+    const char* glyphVertexSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aShape;
+    layout (location = 1) in vec4 aGlyph;
+    uniform vec4 view;
+    uniform float glyphLength;
+    uniform float speedScale;
+    out float speed;
+    void main() {
+        speed = length(aGlyph.zw) * speedScale;
+        vec2 dir = speed > 0.0 ? normalize(aGlyph.zw) : vec2(0.0);
+        vec2 offset = aShape.x * dir + aShape.y * vec2(-dir.y, dir.x);
+        vec2 p = aGlyph.xy + glyphLength * min(speed, 1.0) * offset;
+        gl_Position = vec4((p - view.xy) / (view.zw - view.xy) * 2.0 - 1.0, 0.0, 1.0);
+    }
+    )";
+
+    // streamlines: segments in density cells with a relative speed per vertex
+    const char* lineVertexSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in float aSpeed;
+    uniform vec4 view;
+    out float speed;
+    void main() {
+        speed = aSpeed;
+        gl_Position = vec4((aPos - view.xy) / (view.zw - view.xy) * 2.0 - 1.0, 0.0, 1.0);
+    }
+    )";
+
+    // brighter where the flow is faster
+    const char* overlayFragmentSource = R"(
+    #version 330 core
+    in float speed;
+    out vec4 FragColor;
+    uniform vec3 color;
+    void main() {
+        FragColor = vec4(color * (0.35 + 0.65 * clamp(speed, 0.0, 1.0)), 1.0);
+    }
+    )";
+
+    glyphProgram = createShaderProgram(glyphVertexSource, overlayFragmentSource);
+    lineProgram = createShaderProgram(lineVertexSource, overlayFragmentSource);
+
+    // shaft and two barbs as GL_LINES, tail at the sample point
+    float shape[] = {
+        0.0f,  0.0f,    1.0f,  0.0f,
+        1.0f,  0.0f,    0.7f,  0.2f,
+        1.0f,  0.0f,    0.7f, -0.2f
+    };
+
+    glGenVertexArrays(1, &glyphVAO);
+    glGenBuffers(1, &glyphShapeVBO);
+    glGenBuffers(1, &glyphInstanceVBO);
+    glBindVertexArray(glyphVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, glyphShapeVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(shape), shape, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // one x, y, u, v per instance
+    glBindBuffer(GL_ARRAY_BUFFER, glyphInstanceVBO);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glGenVertexArrays(1, &lineVAO);
+    glGenBuffers(1, &lineVBO);
+    glBindVertexArray(lineVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// arrows are resampled from the current velocity every frame, a few
+// thousand bilinear lookups. streamlines come from the tracer thread and
+// are redrawn from the last finished set until a newer one is ready
+void OpenGLRenderer::drawVelocityOverlay() {
+    if (!showGlyphs && !showStreamlines) {
+        return;
+    }
+    TRACE_SCOPE("DrawVelocity");
+
+    FieldView view = visibleRegion();
+    VelocityField field = { m_fluidSolver->GetVelocityU(), m_fluidSolver->GetVelocityV(),
+        m_fluidSolver->GetVelocityNX(), m_fluidSolver->GetVelocityNY(), m_fluidSolver->GetVelocityScale() };
+
+    if (showStreamlines) {
+        if (!tracer) {
+            tracer = new StreamlineTracer();
+        }
+        tracer->Submit(field);
+        if (tracer->TakeLines(lines)) {
+            glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+            glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(float), lines.data(), GL_STREAM_DRAW);
+            lineVertexCount = static_cast<int>(lines.size() / 3);
+        }
+
+        glUseProgram(lineProgram);
+        glUniform4f(glGetUniformLocation(lineProgram, "view"), view.x0, view.y0, view.x1, view.y1);
+        glUniform3f(glGetUniformLocation(lineProgram, "color"), 0.2f, 0.8f, 1.0f);
+        glBindVertexArray(lineVAO);
+        glDrawArrays(GL_LINES, 0, lineVertexCount);
+    }
+
+    if (showGlyphs) {
+        int columns = std::max(fbWidth / GLYPH_SPACING, 1);
+        int rows = std::max(fbHeight / GLYPH_SPACING, 1);
+        glyphs.clear();
+        float maxSpeed = SampleVelocityGlyphs(field, view, columns, rows, glyphs);
+
+        // orphan and refill the one instance buffer
+        glBindBuffer(GL_ARRAY_BUFFER, glyphInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, glyphs.size() * sizeof(float), glyphs.data(), GL_STREAM_DRAW);
+
+        // the fastest arrow spans most of the gap to its neighbour
+        float spacing = std::min((view.x1 - view.x0) / columns, (view.y1 - view.y0) / rows);
+        glUseProgram(glyphProgram);
+        glUniform4f(glGetUniformLocation(glyphProgram, "view"), view.x0, view.y0, view.x1, view.y1);
+        glUniform1f(glGetUniformLocation(glyphProgram, "glyphLength"), 0.9f * spacing);
+        glUniform1f(glGetUniformLocation(glyphProgram, "speedScale"), maxSpeed > 0.0f ? 1.0f / maxSpeed : 0.0f);
+        glUniform3f(glGetUniformLocation(glyphProgram, "color"), 1.0f, 0.85f, 0.2f);
+        glBindVertexArray(glyphVAO);
+        glDrawArraysInstanced(GL_LINES, 0, 6, columns * rows);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// grow every ring buffer to hold bytes. glBufferData gives each one new
+// storage, so uploads still in flight keep reading the old
+void OpenGLRenderer::ensureUploadCapacity(size_t bytes) {
+    if (bytes <= pboCapacity) {
+        return;
+    }
+    for (int k = 0; k < PBO_RING_SIZE; k++) {
+        if (pboFence[k]) {
+            glDeleteSync(pboFence[k]);
+            pboFence[k] = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[k]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    pboCapacity = bytes;
 }
 
-void OpenGLRenderer::renderDensityGrid(float* densityGrid) {
-    // update the texture with the new density grid
+// wait until the next ring buffer is free, bind it and map its first bytes.
+// nullptr (and nothing bound) if the mapping failed
+unsigned char* OpenGLRenderer::mapUploadBuffer(size_t bytes) {
+    int k = pboIndex;
+
+    // the buffer is free again once the update that read it has executed
+    bool signaled = true;
+    if (pboFence[k]) {
+        GLenum status = glClientWaitSync(pboFence[k], 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            TRACE_SCOPE("WaitUploadFence");
+            uploadStalls++;
+            status = glClientWaitSync(pboFence[k], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        }
+        signaled = (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED);
+        glDeleteSync(pboFence[k]);
+        pboFence[k] = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[k]);
+
+    // unsynchronized: the fence above already guarantees the GPU is done
+    // with this buffer, so the driver must not wait on it again. if the wait
+    // timed out or failed the GPU may still read it, and the driver has to
+    // synchronize. GL 3.3 has no persistent mapping, the buffer is mapped
+    // per upload instead
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    if (signaled) {
+        access |= GL_MAP_UNSYNCHRONIZED_BIT;
+    }
+    unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, access));
+    if (!mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return mapped;
+}
+
+// unmap the current ring buffer after the texture updates reading it are
+// queued, fence it and move to the next one
+void OpenGLRenderer::fenceUploadBuffer() {
+    pboFence[pboIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pboIndex = (pboIndex + 1) % PBO_RING_SIZE;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// turn the solver's dirty tiles into texel rectangles: runs of dirty
+// tiles along a tile row, merged with the run below when it spans the same
+// tiles, grown by one cell where they touch the boundary ring
+void OpenGLRenderer::collectDirtyRects() {
+    int W = NX + 2;
+    int H = NY + 2;
+    int tilesX = (NX + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+
+    dirtyRects.clear();
+    sortedDirty.assign(m_fluidSolver->GetDirtyTiles(), m_fluidSolver->GetDirtyTiles() + m_fluidSolver->GetDirtyTileCount());
+    std::sort(sortedDirty.begin(), sortedDirty.end());
+
+    // runs of the tile row above (first tile, last tile, rectangle) and of the current one
+    std::vector<int> aboveRuns, rowRuns;
+    int row = -2;
+
+    size_t texels = 0;
+    for (size_t d = 0; d < sortedDirty.size(); ) {
+        int first = sortedDirty[d];
+        int last = first;
+        while (d + 1 < sortedDirty.size() && sortedDirty[d + 1] == last + 1 && (last + 1) % tilesX != 0) {
+            last = sortedDirty[++d];
+        }
+        d++;
+
+        int runRow = first / tilesX;
+        if (runRow != row) {
+            if (runRow == row + 1) {
+                aboveRuns.swap(rowRuns);
+            }
+            else {
+                aboveRuns.clear();
+            }
+            rowRuns.clear();
+            row = runRow;
+        }
+
+        int i0, i1, j0, j1, unused0, unused1;
+        m_fluidSolver->GetDensityTileBounds(first, i0, unused0, j0, j1);
+        m_fluidSolver->GetDensityTileBounds(last, unused0, i1, unused1, unused1);
+        if (i0 == 1) i0 = 0;
+        if (j0 == 1) j0 = 0;
+        if (i1 == NX) i1 = NX + 1;
+        if (j1 == NY) j1 = NY + 1;
+
+        // extend the rectangle of the same run one tile row down
+        int rect = -1;
+        for (size_t r = 0; r < aboveRuns.size(); r += 3) {
+            if (aboveRuns[r] == first && aboveRuns[r + 1] == last) {
+                rect = aboveRuns[r + 2];
+                break;
+            }
+        }
+        if (rect >= 0) {
+            DirtyRect& grow = dirtyRects[rect];
+            texels += static_cast<size_t>(grow.w) * (j1 + 1 - (grow.y + grow.h));
+            grow.h = j1 + 1 - grow.y;
+        }
+        else {
+            rect = static_cast<int>(dirtyRects.size());
+            dirtyRects.push_back({ i0, j0, i1 - i0 + 1, j1 - j0 + 1 });
+            texels += static_cast<size_t>(i1 - i0 + 1) * (j1 - j0 + 1);
+        }
+        rowRuns.push_back(first);
+        rowRuns.push_back(last);
+        rowRuns.push_back(rect);
+    }
+
+    // past half the texture one full upload is cheaper than many small ones.
+    // after the downsampled view the whole texture is out of date
+    if (fullUploadPending || texels * 2 > static_cast<size_t>(W) * H) {
+        dirtyRects.clear();
+        dirtyRects.push_back({ 0, 0, W, H });
+        texels = static_cast<size_t>(W) * H;
+        fullUploadPending = false;
+    }
+
+    uploadedTexels += texels;
+    totalTexels += static_cast<size_t>(W) * H;
+}
+
+// convert (or copy) the dirty rectangles into the next ring buffer at their
+// place in the full texture layout and update just those texture regions.
+// the texture updates return as soon as they are queued and the GPU pulls
+// the pixels while the CPU runs the next solver step
+void OpenGLRenderer::uploadDensity(const float* densityGrid) {
+    TRACE_SCOPE("UploadDensity");
+
+    collectDirtyRects();
+    m_fluidSolver->ClearDirtyTiles();
+    if (dirtyRects.empty()) {
+        return;
+    }
+
+    int W = NX + 2;
+    int bytes = DisplayBytesPerTexel(uploadFormat);
+    GLenum type = textureType(uploadFormat);
+
+    // allocate the storage once, frames only replace its contents. GL 3.3
+    // has no glTexStorage2D, so this is the one glTexImage2D call
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, N + 2, N + 2, 0, GL_RED, GL_FLOAT, densityGrid);
+    if (!textureAllocated) {
+        glTexImage2D(GL_TEXTURE_2D, 0, textureInternalFormat(uploadFormat), NX + 2, NY + 2, 0, GL_RED,
+            type, nullptr);
+        textureAllocated = true;
+    }
+
+    ensureUploadCapacity(uploadBytes);
+    unsigned char* mapped = mapUploadBuffer(uploadBytes);
+
+    // rows go into the buffer (or, without a mapping, the display copy) at
+    // their full-texture offsets, the rest of it is never read
+    unsigned char* staging = mapped ? mapped : displayCopy.data();
+    for (const DirtyRect& rect : dirtyRects) {
+        for (int j = rect.y; j < rect.y + rect.h; j++) {
+            size_t offset = static_cast<size_t>(j) * W + rect.x;
+            if (fusedConversion) {
+                if (mapped) {
+                    std::memcpy(staging + offset * bytes, displayCopy.data() + offset * bytes,
+                        static_cast<size_t>(rect.w) * bytes);
+                }
+            }
+            else {
+                ConvertForDisplay(densityGrid + offset, staging + offset * bytes, rect.w, uploadFormat, uploadScale);
+            }
+        }
+    }
+
+    // without a mapping (e.g. lost context) the upload reads client memory
+    const unsigned char* source = mapped ? nullptr : displayCopy.data();
+    if (mapped) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // with an unpack buffer bound the pointer is an offset into it
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, W);
+    for (const DirtyRect& rect : dirtyRects) {
+        size_t offset = (static_cast<size_t>(rect.y) * W + rect.x) * bytes;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RED, type, source + offset);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    if (mapped) {
+        fenceUploadBuffer();
+    }
+}
+
+// resample the visible region to the framebuffer size and upload that
+// instead of the grid. skipped while neither the density nor the view changed
+void OpenGLRenderer::uploadDownsampled(const float* densityGrid) {
+    TRACE_SCOPE("UploadDownsampled");
+
+    int w = std::max(fbWidth, 1);
+    int h = std::max(fbHeight, 1);
+    FieldView view = visibleRegion();
+
+    bool resized = w != lodWidth || h != lodHeight;
+    bool moved = view.x0 != lodView.x0 || view.y0 != lodView.y0 || view.x1 != lodView.x1 || view.y1 != lodView.y1;
+    bool changed = m_fluidSolver->GetDirtyTileCount() > 0;
+    m_fluidSolver->ClearDirtyTiles();
+    fullUploadPending = true;
+    if (lodActive && !resized && !moved && !changed) {
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, lodTexture);
+    if (resized) {
+        glTexImage2D(GL_TEXTURE_2D, 0, textureInternalFormat(uploadFormat), w, h, 0, GL_RED,
+            textureType(uploadFormat), nullptr);
+        lodWidth = w;
+        lodHeight = h;
+        lodField.resize(static_cast<size_t>(w) * h);
+    }
+    lodView = view;
+
+    if (!lodPool) {
+        lodPool = new ThreadPool();
+    }
+    DownsampleField(densityGrid, NX + 2, NY + 2, view, lodField.data(), w, h, lodFilter, lodPool);
+
+    size_t bytes = static_cast<size_t>(w) * h * DisplayBytesPerTexel(uploadFormat);
+    ensureUploadCapacity(bytes);
+    unsigned char* mapped = mapUploadBuffer(bytes);
+    if (!mapped) {
+        lodStaging.resize(bytes);
+    }
+    ConvertForDisplay(lodField.data(), mapped ? mapped : lodStaging.data(), lodField.size(), uploadFormat, uploadScale);
+
+    if (mapped) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RED, textureType(uploadFormat),
+        mapped ? nullptr : lodStaging.data());
+    if (mapped) {
+        fenceUploadBuffer();
+    }
+}
+
+// the native texture is used while every cell gets at least a pixel
+bool OpenGLRenderer::useDownsampledView() const {
+    return viewZoom > 1.0f || NX + 2 > fbWidth || NY + 2 > fbHeight;
+}
+
+FieldView OpenGLRenderer::visibleRegion() const {
+    float halfW = (NX + 2) * 0.5f / viewZoom;
+    float halfH = (NY + 2) * 0.5f / viewZoom;
+    return { viewCenterX - halfW, viewCenterY - halfH, viewCenterX + halfW, viewCenterY + halfH };
+}
+
+void OpenGLRenderer::renderDensityGrid(const float* densityGrid) {
+    // update the texture with the new density grid, or its window
+    // resolution version when the grid outgrows the window
+    bool downsampled = useDownsampledView();
+    if (downsampled) {
+        uploadDownsampled(densityGrid);
+    }
+    else {
+        uploadDensity(densityGrid);
+    }
+    lodActive = downsampled;
 
     // render the quad
+    TRACE_SCOPE("DrawQuad");
+    glBindTexture(GL_TEXTURE_2D, downsampled ? lodTexture : texture);
     glUseProgram(shaderProgram);
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -196,31 +711,123 @@ void OpenGLRenderer::renderDensityGrid(float* densityGrid) {
 
 void OpenGLRenderer::run() {
     // main loop
+    auto lastFrame = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(m_window)) {
+        TRACE_SCOPE("Frame");
+
+        // the frame time is start to start, so it includes the swap
+        auto now = std::chrono::steady_clock::now();
+        double frameMs = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+        lastFrame = now;
+
         // input
         processInput();
 
-        // step fluid simulation
-        m_fluidSolver->Step();
+        // step fluid simulation, by the wall time of the last frame when scheduled
+        if (scheduler) {
+            scheduler->Advance(frameMs / 1000.0);
+        }
+        else {
+            m_fluidSolver->Step();
+        }
 
         // rendering commands here
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // get density grid from fluid solver
-        float* densityGrid = m_fluidSolver->GetDensity();
+        // get density grid from fluid solver, blended between steps when scheduled
+        const float* densityGrid = scheduler ? scheduler->GetDisplayDensity() : m_fluidSolver->GetDensity();
 
         // render density grid
         renderDensityGrid(densityGrid);
+        drawVelocityOverlay();
+
+        if (showHud) {
+            hud->addFrame(frameMs, *m_fluidSolver);
+            hud->draw(fbWidth, fbHeight);
+        }
 
         // swap buffers and poll IO events
-        glfwSwapBuffers(m_window);
+        {
+            TRACE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(m_window);
+        }
         glfwPollEvents();
     }
 }
 
 void OpenGLRenderer::framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    OpenGLRenderer* renderer = static_cast<OpenGLRenderer*>(glfwGetWindowUserPointer(window));
+    if (renderer) {
+        renderer->fbWidth = width;
+        renderer->fbHeight = height;
+    }
+}
+
+void OpenGLRenderer::scroll_callback(GLFWwindow* window, double /*xoffset*/, double yoffset) {
+    OpenGLRenderer* renderer = static_cast<OpenGLRenderer*>(glfwGetWindowUserPointer(window));
+    if (renderer) {
+        renderer->pendingScroll += yoffset;
+    }
+}
+
+// V toggles the velocity arrows, L the streamlines, H the HUD
+void OpenGLRenderer::key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
+    OpenGLRenderer* renderer = static_cast<OpenGLRenderer*>(glfwGetWindowUserPointer(window));
+    if (!renderer || action != GLFW_PRESS) {
+        return;
+    }
+    if (key == GLFW_KEY_V) {
+        renderer->showGlyphs = !renderer->showGlyphs;
+    }
+    else if (key == GLFW_KEY_L) {
+        renderer->showStreamlines = !renderer->showStreamlines;
+    }
+    else if (key == GLFW_KEY_H) {
+        renderer->setHudVisible(!renderer->showHud);
+    }
+}
+
+// scroll zooms about the cell under the cursor, dragging with the middle
+// button pans and home shows the whole field again
+void OpenGLRenderer::updateView(double xpos, double ypos, int windowWidth, int windowHeight) {
+    float fieldW = static_cast<float>(NX + 2);
+    float fieldH = static_cast<float>(NY + 2);
+
+    if (pendingScroll != 0.0) {
+        FieldView view = visibleRegion();
+        float fx = view.x0 + static_cast<float>(xpos / windowWidth) * (view.x1 - view.x0);
+        float fy = view.y0 + static_cast<float>((windowHeight - ypos) / windowHeight) * (view.y1 - view.y0);
+
+        // at most zoomed in to 16 cells across
+        float maxZoom = std::max(1.0f, std::min(fieldW, fieldH) / 16.0f);
+        float zoom = viewZoom * std::pow(1.25f, static_cast<float>(pendingScroll));
+        zoom = std::min(std::max(zoom, 1.0f), maxZoom);
+        viewCenterX = fx + (viewCenterX - fx) * viewZoom / zoom;
+        viewCenterY = fy + (viewCenterY - fy) * viewZoom / zoom;
+        viewZoom = zoom;
+        pendingScroll = 0.0;
+    }
+
+    bool middle = glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+    if (middle && panning) {
+        viewCenterX -= static_cast<float>((xpos - panLastX) / windowWidth) * fieldW / viewZoom;
+        viewCenterY += static_cast<float>((ypos - panLastY) / windowHeight) * fieldH / viewZoom; // invert Y
+    }
+    panning = middle;
+    panLastX = xpos;
+    panLastY = ypos;
+
+    if (glfwGetKey(m_window, GLFW_KEY_HOME) == GLFW_PRESS) {
+        viewZoom = 1.0f;
+    }
+
+    // keep the view inside the field
+    float halfW = fieldW * 0.5f / viewZoom;
+    float halfH = fieldH * 0.5f / viewZoom;
+    viewCenterX = std::min(std::max(viewCenterX, halfW), fieldW - halfW);
+    viewCenterY = std::min(std::max(viewCenterY, halfH), fieldH - halfH);
 }
 
 void OpenGLRenderer::processInput() {
@@ -238,9 +845,18 @@ void OpenGLRenderer::processInput() {
 
     static double lastXpos = xpos, lastYpos = ypos;
 
-    // mouse coordinates to grid coordinates
-    int gridX = static_cast<int>(xpos / m_width * N);
-    int gridY = static_cast<int>((m_height - ypos) / m_height * N); // invert Y
+    int windowWidth, windowHeight;
+    glfwGetWindowSize(m_window, &windowWidth, &windowHeight);
+    windowWidth = std::max(windowWidth, 1);
+    windowHeight = std::max(windowHeight, 1);
+    updateView(xpos, ypos, windowWidth, windowHeight);
+
+    // mouse coordinates to grid coordinates through the current view
+    FieldView view = visibleRegion();
+    float fx = view.x0 + static_cast<float>(xpos / windowWidth) * (view.x1 - view.x0);
+    float fy = view.y0 + static_cast<float>((windowHeight - ypos) / windowHeight) * (view.y1 - view.y0); // invert Y
+    int gridX = std::min(std::max(static_cast<int>(std::floor(fx)), 1), NX);
+    int gridY = std::min(std::max(static_cast<int>(std::floor(fy)), 1), NY);
 
     if (rightMouseButtonState == GLFW_PRESS) {
         // right-click: add fluid density at  current mouse position
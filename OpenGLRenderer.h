@@ -3,8 +3,23 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <vector>
+#include "DisplayConvert.h"
+#include "DisplayDownsample.h"
+#include "VelocityOverlay.h"
 
 class FluidSolver;
+class HudOverlay;
+class StepScheduler;
+class ThreadPool;
+
+// pixel buffers the density uploads rotate through. with three, the buffer
+// being written was last read by the GPU two frames ago, so its fence has
+// normally signalled and mapping never waits
+#define PBO_RING_SIZE 3
+
+// pixels between velocity arrows
+#define GLYPH_SPACING 24
 
 class OpenGLRenderer {
 public:
@@ -19,12 +34,39 @@ public:
     // FUNCTIONS
     // ==================================================
 
-    OpenGLRenderer(int width, int height, const char* title, int n, FluidSolver* fluidSolver);
+    OpenGLRenderer(int width, int height, const char* title, int nx, int ny, FluidSolver* fluidSolver);
     ~OpenGLRenderer();
 
     bool initialize();
     void run();
 
+    // texel format of the density texture, value * scale is displayed. with
+    // fused the solver converts during its density advection instead of the
+    // renderer converting the whole field per frame. call before initialize
+    void setUploadFormat(DisplayFormat format, float scale = 1.0f, bool fused = false);
+
+    // filter of the window resolution display, used when the grid has more
+    // cells than the framebuffer has pixels or the view is zoomed
+    void setDownsampleFilter(DownsampleFilter filter) { lodFilter = filter; }
+
+    // draw velocity arrows and streamlines over the density, also toggled
+    // with V and L while running
+    void setVelocityOverlay(bool arrows, bool streamlines) { showGlyphs = arrows; showStreamlines = streamlines; }
+
+    // performance HUD, also toggled with H. while shown the solver tracks
+    // relaxation residuals, which costs it an extra sweep per solve
+    void setHudVisible(bool visible);
+
+    // step the solver through the scheduler instead of once per frame and
+    // show its interpolated density (nullptr for one step per frame)
+    void setScheduler(StepScheduler* stepScheduler) { scheduler = stepScheduler; }
+
+    // density uploads that waited on the GPU for a free pixel buffer
+    long long getUploadStalls() const { return uploadStalls; }
+
+    // share of the texture uploaded since initialize, dirty tiles only
+    double getUploadedFraction() const { return totalTexels ? static_cast<double>(uploadedTexels) / totalTexels : 0.0; }
+
 private:
 
     // ==================================================
@@ -34,21 +76,103 @@ private:
     int m_width, m_height;
     const char* m_title;
     GLFWwindow* m_window;
-    int N;
+    // the GL functions are loaded, so the objects below can be deleted
+    bool glLoaded;
+    int NX, NY;
     FluidSolver* m_fluidSolver;
 
     GLuint shaderProgram;
     GLuint VAO, VBO, EBO;
     GLuint texture;
 
+    // density upload ring, each buffer fenced after the texture update
+    // that reads from it
+    GLuint pbo[PBO_RING_SIZE];
+    GLsync pboFence[PBO_RING_SIZE];
+    int pboIndex;
+    size_t uploadBytes;
+
+    DisplayFormat uploadFormat;
+    float uploadScale;
+    bool fusedConversion;
+    // converted density, kept current by the solver when fused
+    std::vector<unsigned char> displayCopy;
+
+    // texel rectangles covering the solver's dirty tiles this frame
+    struct DirtyRect {
+        int x, y, w, h;
+    };
+    std::vector<DirtyRect> dirtyRects;
+    std::vector<int> sortedDirty;
+    unsigned long long uploadedTexels;
+    unsigned long long totalTexels;
+    // uploads that had to wait for the GPU to release their buffer
+    long long uploadStalls;
+    // bytes each ring buffer holds, grown for a large window
+    size_t pboCapacity;
+    // the native texture missed updates while the downsampled one was shown
+    bool fullUploadPending;
+    // the native texture gets its storage on the first native upload
+    bool textureAllocated;
+
+    // window resolution display: the visible region resampled to the
+    // framebuffer size, so its cost does not grow with the grid
+    GLuint lodTexture;
+    int lodWidth, lodHeight;
+    bool lodActive;
+    DownsampleFilter lodFilter;
+    std::vector<float> lodField;
+    std::vector<unsigned char> lodStaging;
+    ThreadPool* lodPool;
+    FieldView lodView;
+
+    // framebuffer size in pixels
+    int fbWidth, fbHeight;
+
+    // view: zoom 1 shows the whole field, the centre is in cells
+    float viewZoom;
+    float viewCenterX, viewCenterY;
+    double pendingScroll;
+    bool panning;
+    double panLastX, panLastY;
+
+    // velocity overlay: one arrow shape drawn per instance from a buffer of
+    // sampled vectors, and streamlines traced off the render thread
+    GLuint glyphProgram, lineProgram;
+    GLuint glyphVAO, glyphShapeVBO, glyphInstanceVBO;
+    GLuint lineVAO, lineVBO;
+    int lineVertexCount;
+    bool showGlyphs, showStreamlines;
+    std::vector<float> glyphs;
+    std::vector<float> lines;
+    StreamlineTracer* tracer;
+
+    HudOverlay* hud;
+    bool showHud;
+
+    StepScheduler* scheduler;
+
     // ==================================================
     // FUNCTIONS
     // ==================================================
 
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+    static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+    static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
     void processInput();
     void setupShadersAndBuffers();
-    void renderDensityGrid(float* densityGrid);
+    void renderDensityGrid(const float* densityGrid);
+    void uploadDensity(const float* densityGrid);
+    void collectDirtyRects();
+    void uploadDownsampled(const float* densityGrid);
+    unsigned char* mapUploadBuffer(size_t bytes);
+    void fenceUploadBuffer();
+    void ensureUploadCapacity(size_t bytes);
+    bool useDownsampledView() const;
+    FieldView visibleRegion() const;
+    void updateView(double xpos, double ypos, int windowWidth, int windowHeight);
+    void setupVelocityOverlay();
+    void drawVelocityOverlay();
 
     // Helper methods to add fluid and velocity
     void addFluid(int x, int y);
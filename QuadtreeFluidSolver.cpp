@@ -0,0 +1,329 @@
+#include "QuadtreeFluidSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// constructor
+QuadtreeFluidSolver::QuadtreeFluidSolver(int minDepth, int maxDepth)
+    : N(1 << maxDepth), grid(minDepth, maxDepth)
+{
+    std::cout << "QuadtreeFluidSolver constructor called. Finest N = " << N << "." << std::endl;
+
+    for (int f = 0; f < 3; f++) {
+        raster[f] = new float[(N + 2) * (N + 2)];
+        std::fill(raster[f], raster[f] + (N + 2) * (N + 2), 0.0f);
+        rasterValid[f] = false;
+    }
+}
+
+// destructor
+QuadtreeFluidSolver::~QuadtreeFluidSolver()
+{
+    for (int f = 0; f < 3; f++) {
+        delete[] raster[f];
+    }
+}
+
+void QuadtreeFluidSolver::AddInputToField(FieldType fieldType, int i, int j, float s)
+{
+    if (fieldType != DENSITY && fieldType != VELOCITY_U && fieldType != VELOCITY_V) {
+        std::cerr << "Error: Invalid field type." << std::endl;
+        return;
+    }
+
+    // interior cells 1..N map to finest cells 0..N-1
+    i = std::min(std::max(i, 1), N) - 1;
+    j = std::min(std::max(j, 1), N) - 1;
+
+    // sources always get the finest resolution
+    int leaf = grid.FindLeaf(i, j);
+    bool split = false;
+    while (grid.nodes[leaf].depth < grid.maxDepth) {
+        grid.Split(leaf);
+        leaf = grid.FindLeaf(i, j);
+        split = true;
+    }
+    if (split) {
+        grid.BuildTopology();
+    }
+
+    grid.nodes[leaf].f[grid.cur[fieldType]] += s * dt;
+    rasterValid[fieldType] = false;
+}
+
+float* QuadtreeFluidSolver::Rasterize(FieldType fieldType) const
+{
+    if (rasterValid[fieldType]) {
+        return raster[fieldType];
+    }
+
+    float* out = raster[fieldType];
+    for (int n : grid.leaves) {
+        const QuadNode& leaf = grid.nodes[n];
+        float value = leaf.f[grid.cur[fieldType]];
+        for (int j = 0; j < leaf.isize; j++) {
+            float* row = out + (leaf.ix + 1) + (N + 2) * (leaf.iy + j + 1);
+            std::fill(row, row + leaf.isize, value);
+        }
+    }
+
+    rasterValid[fieldType] = true;
+    return out;
+}
+
+void QuadtreeFluidSolver::Gradient(int slot)
+{
+    size_t count = grid.leaves.size();
+    gradX.assign(count, 0.0f);
+    gradY.assign(count, 0.0f);
+    lower.resize(count);
+    upper.resize(count);
+
+    for (size_t k = 0; k < count; k++) {
+        float fa = grid.nodes[grid.leaves[k]].f[slot];
+        float side[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        lower[k] = upper[k] = fa;
+
+        for (int dir = 0; dir < 4; dir++) {
+            float flux = 0.0f, length = 0.0f;
+            for (int l = grid.linkStart[4 * k + dir]; l < grid.linkStart[4 * k + dir + 1]; l++) {
+                const QuadLink& link = grid.links[l];
+                float fb = (link.leaf < 0) ? 0.0f : grid.nodes[grid.leaves[link.leaf]].f[slot];
+                flux += link.length * (fb - fa) / link.dist;
+                length += link.length;
+                lower[k] = std::min(lower[k], fb);
+                upper[k] = std::max(upper[k], fb);
+            }
+            side[dir] = flux / length;
+        }
+
+        // one-sided slopes point outwards, average them into central differences
+        gradX[k] = 0.5f * (side[1] - side[0]);
+        gradY[k] = 0.5f * (side[3] - side[2]);
+    }
+}
+
+void QuadtreeFluidSolver::Adapt()
+{
+    size_t count = grid.leaves.size();
+    float h = 1.0f / N;
+
+    // per-cell density jump
+    Gradient(grid.cur[DENSITY]);
+    std::vector<float> indicator(count);
+    for (size_t k = 0; k < count; k++) {
+        float size = grid.nodes[grid.leaves[k]].isize * h;
+        indicator[k] = size * std::sqrt(gradX[k] * gradX[k] + gradY[k] * gradY[k]) / refineDensity;
+    }
+
+    // per-cell velocity curl
+    Gradient(grid.cur[VELOCITY_V]);
+    std::vector<float> dvdx = gradX;
+    Gradient(grid.cur[VELOCITY_U]);
+    for (size_t k = 0; k < count; k++) {
+        float size = grid.nodes[grid.leaves[k]].isize * h;
+        float curl = std::fabs(dvdx[k] - gradY[k]);
+        indicator[k] = std::max(indicator[k], size * curl / refineVorticity);
+    }
+
+    std::vector<int> leafNodes = grid.leaves;
+    std::vector<int> merged;
+    for (size_t k = 0; k < count; k++) {
+        int n = leafNodes[k];
+        const QuadNode& leaf = grid.nodes[n];
+
+        if (indicator[k] > 1.0f && leaf.depth < grid.maxDepth) {
+            grid.Split(n);
+            continue;
+        }
+
+        // coarsen with hysteresis once all four siblings are quiet leaves;
+        // the first child of a block decides for its parent
+        int parent = leaf.parent;
+        if (parent < 0 || grid.nodes[parent].depth < grid.minDepth || grid.nodes[parent].child != n) {
+            continue;
+        }
+        bool quiet = true;
+        for (int c = 0; c < 4 && quiet; c++) {
+            int sibling = grid.leafIndex[n + c];
+            quiet = sibling >= 0 && indicator[sibling] < 0.25f;
+        }
+        if (quiet) {
+            merged.push_back(parent);
+        }
+    }
+    for (int parent : merged) {
+        grid.Merge(parent);
+    }
+
+    grid.BuildTopology();
+}
+
+// diffuse function using Gauss-Seidel relaxation over the leaves
+void QuadtreeFluidSolver::Diffuse(FieldType fieldType, int NumIters)
+{
+    int x = grid.cur[fieldType];
+    int x0 = grid.prev[fieldType];
+    float h = 1.0f / N;
+    size_t count = grid.leaves.size();
+
+    for (int k = 0; k < NumIters; k++) {
+        for (size_t a = 0; a < count; a++) {
+            QuadNode& leaf = grid.nodes[grid.leaves[a]];
+            float size = leaf.isize * h;
+            float c = dt * diff / (size * size);
+
+            // walls hold zero like the dense Dirichlet boundary
+            float sum = 0.0f, weight = 0.0f;
+            for (int l = grid.linkStart[4 * a]; l < grid.linkStart[4 * a + 4]; l++) {
+                const QuadLink& link = grid.links[l];
+                float w = link.length / link.dist;
+                if (link.leaf >= 0) {
+                    sum += w * grid.nodes[grid.leaves[link.leaf]].f[x];
+                }
+                weight += w;
+            }
+            leaf.f[x] = (leaf.f[x0] + c * sum) / (1.0f + c * weight);
+        }
+    }
+}
+
+void QuadtreeFluidSolver::Advect(FieldType fieldType)
+{
+    // density is carried by the current velocity, velocity by the projected
+    // velocity left in the previous buffers
+    int u = (fieldType == DENSITY) ? grid.cur[VELOCITY_U] : grid.prev[VELOCITY_U];
+    int v = (fieldType == DENSITY) ? grid.cur[VELOCITY_V] : grid.prev[VELOCITY_V];
+    int d = grid.cur[fieldType];
+    int d0 = grid.prev[fieldType];
+
+    Gradient(d0);
+
+    float h = 1.0f / N;
+    size_t count = grid.leaves.size();
+    for (size_t k = 0; k < count; k++) {
+        QuadNode& leaf = grid.nodes[grid.leaves[k]];
+        float cx = (leaf.ix + 0.5f * leaf.isize) * h;
+        float cy = (leaf.iy + 0.5f * leaf.isize) * h;
+
+        float x = cx - dt * leaf.f[u];
+        float y = cy - dt * leaf.f[v];
+        x = std::min(std::max(x, 0.5f * h), 1.0f - 0.5f * h);
+        y = std::min(std::max(y, 0.5f * h), 1.0f - 0.5f * h);
+
+        // linear reconstruction inside the source leaf, limited to its neighbourhood
+        int src = grid.FindLeaf(static_cast<int>(x * N), static_cast<int>(y * N));
+        int s = grid.leafIndex[src];
+        const QuadNode& from = grid.nodes[src];
+        float sx = (from.ix + 0.5f * from.isize) * h;
+        float sy = (from.iy + 0.5f * from.isize) * h;
+        float value = from.f[d0] + gradX[s] * (x - sx) + gradY[s] * (y - sy);
+        leaf.f[d] = std::min(std::max(value, lower[s]), upper[s]);
+    }
+}
+
+void QuadtreeFluidSolver::StepDensity()
+{
+    // swap the previous and current density buffers
+    grid.SwapBuffers(DENSITY);
+
+    // diffuse the density
+    Diffuse(DENSITY);
+
+    // swap the buffers again to prepare for the advection step
+    grid.SwapBuffers(DENSITY);
+
+    // advect the density using the velocity fields
+    Advect(DENSITY);
+}
+
+void QuadtreeFluidSolver::Project()
+{
+    int u = grid.cur[VELOCITY_U];
+    int v = grid.cur[VELOCITY_V];
+    size_t count = grid.leaves.size();
+
+    // integrated divergence from face-averaged normal velocities, walls are closed
+    static const float sign[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+    for (size_t a = 0; a < count; a++) {
+        QuadNode& leaf = grid.nodes[grid.leaves[a]];
+        float flux = 0.0f;
+        for (int dir = 0; dir < 4; dir++) {
+            int component = (dir < 2) ? u : v;
+            for (int l = grid.linkStart[4 * a + dir]; l < grid.linkStart[4 * a + dir + 1]; l++) {
+                const QuadLink& link = grid.links[l];
+                if (link.leaf < 0) {
+                    continue;
+                }
+                float face = 0.5f * (leaf.f[component] + grid.nodes[grid.leaves[link.leaf]].f[component]);
+                flux += sign[dir] * face * link.length;
+            }
+        }
+        leaf.f[QUAD_DIVERGENCE] = flux;
+        leaf.f[QUAD_PRESSURE] = 0.0f;
+    }
+
+    // solve for the pressure using Gauss-Seidel relaxation, p = 0 beyond the walls
+    for (int k = 0; k < 20; k++) {
+        for (size_t a = 0; a < count; a++) {
+            QuadNode& leaf = grid.nodes[grid.leaves[a]];
+            float sum = 0.0f, weight = 0.0f;
+            for (int l = grid.linkStart[4 * a]; l < grid.linkStart[4 * a + 4]; l++) {
+                const QuadLink& link = grid.links[l];
+                float w = link.length / link.dist;
+                if (link.leaf >= 0) {
+                    sum += w * grid.nodes[grid.leaves[link.leaf]].f[QUAD_PRESSURE];
+                }
+                weight += w;
+            }
+            leaf.f[QUAD_PRESSURE] = (sum - leaf.f[QUAD_DIVERGENCE]) / weight;
+        }
+    }
+
+    // subtract the pressure gradient from the velocity field
+    Gradient(QUAD_PRESSURE);
+    for (size_t a = 0; a < count; a++) {
+        QuadNode& leaf = grid.nodes[grid.leaves[a]];
+        leaf.f[u] -= gradX[a];
+        leaf.f[v] -= gradY[a];
+    }
+}
+
+void QuadtreeFluidSolver::StepVelocity()
+{
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+
+    Diffuse(VELOCITY_U, 20);
+    Diffuse(VELOCITY_V, 20);
+
+    // project the velocity field to ensure it's divergence-free
+    Project();
+
+    // swap the buffers to prepare for the advection step
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+
+    // advect the velocity fields
+    Advect(VELOCITY_U);
+    Advect(VELOCITY_V);
+
+    // project the velocity field again to ensure it's divergence-free after advection
+    Project();
+}
+
+void QuadtreeFluidSolver::Step()
+{
+    // follow the features of the current state
+    Adapt();
+
+    // step velocity field
+    StepVelocity();
+
+    // step density field
+    StepDensity();
+
+    for (int f = 0; f < 3; f++) {
+        rasterValid[f] = false;
+    }
+}
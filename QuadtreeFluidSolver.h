@@ -0,0 +1,86 @@
+#ifndef QUADTREEFLUIDSOLVER_H
+#define QUADTREEFLUIDSOLVER_H
+
+#include "QuadtreeGrid.h"
+#include <vector>
+
+// stable fluids on an adaptive quadtree over the unit square.
+// leaves refine where the density gradient or vorticity across a cell is
+// high (and at every input) and coarsen back where the flow is featureless,
+// so detail near sources costs a fraction of a uniform 2^maxDepth grid.
+class QuadtreeFluidSolver {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, finest resolution is 2^maxDepth cells per side
+    QuadtreeFluidSolver(int minDepth, int maxDepth);
+
+    // destructor
+    ~QuadtreeFluidSolver();
+
+    // add input at finest-level cell (i, j), 1 <= i, j <= N as in FluidSolver
+    void AddInputToField(FieldType fieldType, int i, int j, float s);
+
+    // step
+    void Step();
+
+    // refinement thresholds on the per-cell density jump and velocity curl
+    void SetRefineThresholds(float density, float vorticity) { refineDensity = density; refineVorticity = vorticity; }
+
+    // getters for rendering, (N + 2)^2 rasters at the finest resolution
+    float* GetDensity() const { return Rasterize(DENSITY); }
+    float* GetVelocityU() const { return Rasterize(VELOCITY_U); }
+    float* GetVelocityV() const { return Rasterize(VELOCITY_V); }
+
+    int GetLeafCount() const { return grid.GetLeafCount(); }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // finest grid width/height (not including boundary)
+    int N;
+    // QuadtreeGrid object to manage the tree
+    QuadtreeGrid grid;
+
+    // delta time
+    float dt = 0.8f;
+    // diffusion coefficient
+    float diff = 0.0001f;
+
+    float refineDensity = 0.05f;
+    float refineVorticity = 0.002f;
+
+    // per-leaf scratch: gradients and local bounds of the field being advected
+    std::vector<float> gradX, gradY, lower, upper;
+
+    // rasters handed out by the getters, rebuilt lazily after each step
+    mutable float* raster[3];
+    mutable bool rasterValid[3];
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    float* Rasterize(FieldType fieldType) const;
+
+    // central-difference gradient of a slot from the face links (plus local min/max)
+    void Gradient(int slot);
+
+    // refine/coarsen the tree from the current fields
+    void Adapt();
+
+    void Diffuse(FieldType fieldType, int NumIters = 20);
+    void Advect(FieldType fieldType);
+    void StepDensity();
+    void Project();
+    void StepVelocity();
+};
+
+#endif // QUADTREEFLUIDSOLVER_H
@@ -0,0 +1,180 @@
+#include "QuadtreeGrid.h"
+#include <algorithm>
+#include <iostream>
+
+// constructor
+QuadtreeGrid::QuadtreeGrid(int minDepth, int maxDepth)
+    : minDepth(minDepth), maxDepth(maxDepth), resolution(1 << maxDepth)
+{
+    std::cout << "QuadtreeGrid constructor called. Depth " << minDepth << " to " << maxDepth
+        << " (finest " << resolution << "x" << resolution << ")." << std::endl;
+
+    for (int s = 0; s < 3; s++) {
+        cur[s] = s;
+        prev[s] = 3 + s;
+    }
+
+    // root covering the unit square
+    QuadNode root = {};
+    root.isize = resolution;
+    root.parent = -1;
+    root.child = -1;
+    nodes.push_back(root);
+
+    // refine uniformly down to minDepth
+    for (int d = 0; d < minDepth; d++) {
+        size_t count = nodes.size();
+        for (size_t n = 0; n < count; n++) {
+            if (nodes[n].child < 0 && nodes[n].depth == d) {
+                Split(static_cast<int>(n));
+            }
+        }
+    }
+
+    BuildTopology();
+}
+
+// destructor
+QuadtreeGrid::~QuadtreeGrid()
+{
+
+}
+
+int QuadtreeGrid::FindNode(int i, int j, int maxNodeDepth) const
+{
+    int n = 0;
+    while (nodes[n].child >= 0 && nodes[n].depth < maxNodeDepth) {
+        const QuadNode& node = nodes[n];
+        int half = node.isize / 2;
+        int c = (i >= node.ix + half ? 1 : 0) + (j >= node.iy + half ? 2 : 0);
+        n = node.child + c;
+    }
+    return n;
+}
+
+float QuadtreeGrid::GetValue(FieldType fieldType, int i, int j) const
+{
+    return nodes[FindLeaf(i, j)].f[cur[fieldType]];
+}
+
+void QuadtreeGrid::Split(int node)
+{
+    int block;
+    if (!freeBlocks.empty()) {
+        block = freeBlocks.back();
+        freeBlocks.pop_back();
+    }
+    else {
+        block = static_cast<int>(nodes.size());
+        nodes.resize(nodes.size() + 4);
+    }
+
+    QuadNode parent = nodes[node];
+    int half = parent.isize / 2;
+    for (int c = 0; c < 4; c++) {
+        QuadNode& child = nodes[block + c];
+        child = parent;
+        child.ix = parent.ix + (c & 1) * half;
+        child.iy = parent.iy + (c >> 1) * half;
+        child.isize = half;
+        child.depth = parent.depth + 1;
+        child.parent = node;
+        child.child = -1;
+    }
+    nodes[node].child = block;
+}
+
+void QuadtreeGrid::Merge(int node)
+{
+    QuadNode& parent = nodes[node];
+    int block = parent.child;
+
+    // conservative restriction: the parent takes the children's mean
+    for (int s = 0; s < QUAD_SLOTS; s++) {
+        float sum = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            sum += nodes[block + c].f[s];
+        }
+        parent.f[s] = 0.25f * sum;
+    }
+
+    parent.child = -1;
+    freeBlocks.push_back(block);
+}
+
+void QuadtreeGrid::CollectSide(int node, int side, std::vector<int>& out) const
+{
+    const QuadNode& n = nodes[node];
+    if (n.child < 0) {
+        out.push_back(node);
+        return;
+    }
+
+    // children on each side: left {0, 2}, right {1, 3}, bottom {0, 1}, top {2, 3}
+    static const int sideChildren[4][2] = { { 0, 2 }, { 1, 3 }, { 0, 1 }, { 2, 3 } };
+    CollectSide(n.child + sideChildren[side][0], side, out);
+    CollectSide(n.child + sideChildren[side][1], side, out);
+}
+
+void QuadtreeGrid::BuildTopology()
+{
+    // depth-first leaf list
+    leaves.clear();
+    leafIndex.assign(nodes.size(), -1);
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        if (nodes[n].child < 0) {
+            leafIndex[n] = static_cast<int>(leaves.size());
+            leaves.push_back(n);
+        }
+        else {
+            for (int c = 3; c >= 0; c--) {
+                stack.push_back(nodes[n].child + c);
+            }
+        }
+    }
+
+    // face links
+    float h = 1.0f / resolution;
+    links.clear();
+    linkStart.resize(4 * leaves.size() + 1);
+    std::vector<int> across;
+
+    for (size_t k = 0; k < leaves.size(); k++) {
+        const QuadNode& leaf = nodes[leaves[k]];
+        int mid = leaf.isize / 2;
+        float size = leaf.isize * h;
+
+        // a finest cell just across each face
+        int pi[4] = { leaf.ix - 1, leaf.ix + leaf.isize, leaf.ix + mid, leaf.ix + mid };
+        int pj[4] = { leaf.iy + mid, leaf.iy + mid, leaf.iy - 1, leaf.iy + leaf.isize };
+
+        for (int dir = 0; dir < 4; dir++) {
+            linkStart[4 * k + dir] = static_cast<int>(links.size());
+
+            // walls sit half a cell outside, mirrored like the dense ghost ring
+            if (pi[dir] < 0 || pi[dir] >= resolution || pj[dir] < 0 || pj[dir] >= resolution) {
+                links.push_back({ -1, size, size });
+                continue;
+            }
+
+            // same-size or coarser neighbour, or the subdivided node facing us
+            int other = FindNode(pi[dir], pj[dir], leaf.depth);
+            across.clear();
+            CollectSide(other, dir ^ 1, across);
+
+            for (int n : across) {
+                float otherSize = nodes[n].isize * h;
+                links.push_back({ leafIndex[n], std::min(size, otherSize), 0.5f * (size + otherSize) });
+            }
+        }
+    }
+    linkStart[4 * leaves.size()] = static_cast<int>(links.size());
+}
+
+void QuadtreeGrid::SwapBuffers(FieldType fieldType)
+{
+    std::swap(cur[fieldType], prev[fieldType]);
+}
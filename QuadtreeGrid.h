@@ -0,0 +1,108 @@
+#ifndef QUADTREEGRID_H
+#define QUADTREEGRID_H
+
+#include "Grid.h"
+#include <vector>
+
+// values stored per quadtree cell: slots 0-5 hold the current and previous
+// buffers of DENSITY, VELOCITY_U and VELOCITY_V (addressed through
+// QuadtreeGrid::cur/prev so they swap like Grid's buffers), followed by
+// scratch for the pressure solve
+#define QUAD_PRESSURE 6
+#define QUAD_DIVERGENCE 7
+#define QUAD_SLOTS 8
+
+class QuadtreeFluidSolver;
+
+// one node of the quadtree. position and size are integers in units of the
+// finest cell, so a node covers [ix, ix + isize) x [iy, iy + isize)
+struct QuadNode {
+    int ix, iy, isize;
+    int depth;
+    int parent;
+    // index of the first of four children (bottom-left, bottom-right,
+    // top-left, top-right), -1 for leaves
+    int child;
+    // cell-centred values, valid on leaves
+    float f[QUAD_SLOTS];
+};
+
+// face connection from a leaf to a neighbouring leaf or a wall
+struct QuadLink {
+    int leaf;       // index into QuadtreeGrid::leaves, -1 for a wall
+    float length;   // shared face length
+    float dist;     // centre distance along the face normal
+};
+
+class QuadtreeGrid {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, cells start uniform at minDepth and may refine to maxDepth
+    QuadtreeGrid(int minDepth, int maxDepth);
+
+    // destructor
+    ~QuadtreeGrid();
+
+    int GetLeafCount() const { return static_cast<int>(leaves.size()); }
+
+    // value of a field in the finest-level cell (i, j), 0 <= i, j < 2^maxDepth
+    float GetValue(FieldType fieldType, int i, int j) const;
+
+private:
+
+    friend class QuadtreeFluidSolver;
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    int minDepth;
+    int maxDepth;
+    // finest cells per side
+    int resolution;
+
+    // node pool, children are allocated in blocks of four
+    std::vector<QuadNode> nodes;
+    std::vector<int> freeBlocks;
+
+    // leaves in depth-first order
+    std::vector<int> leaves;
+    // leaf index of every node, -1 for inner nodes
+    std::vector<int> leafIndex;
+    // faces of leaf k towards dir (0 left, 1 right, 2 bottom, 3 top) are
+    // links[linkStart[4 * k + dir] .. linkStart[4 * k + dir + 1])
+    std::vector<int> linkStart;
+    std::vector<QuadLink> links;
+
+    // current and previous slot of DENSITY, VELOCITY_U, VELOCITY_V
+    int cur[3];
+    int prev[3];
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // deepest node containing finest cell (i, j), stopping at maxNodeDepth
+    int FindNode(int i, int j, int maxNodeDepth) const;
+    int FindLeaf(int i, int j) const { return FindNode(i, j, maxDepth); }
+
+    // split a leaf into four children carrying the parent's values
+    void Split(int node);
+    // collapse four leaf children back into their parent (averaging)
+    void Merge(int node);
+
+    // rebuild the leaf list and face links after the tree changed
+    void BuildTopology();
+
+    // collect the leaves below `node` touching its side (0 left .. 3 top)
+    void CollectSide(int node, int side, std::vector<int>& out) const;
+
+    void SwapBuffers(FieldType fieldType);
+};
+
+#endif // QUADTREEGRID_H
@@ -0,0 +1,12 @@
+#ifndef SHADERUTIL_H
+#define SHADERUTIL_H
+
+#include <glad/glad.h>
+
+// compile one shader stage, errors are printed and the shader returned anyway
+GLuint compileShader(GLenum type, const char* source);
+
+// create and link a shader program from vertex and fragment shader sources
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource);
+
+#endif // SHADERUTIL_H
@@ -0,0 +1,320 @@
+#include "ShmTransport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// "FSHM", set by rank 0 once the segment is initialised
+static const unsigned SHM_MAGIC = 0x4653484d;
+// header and ring control words each get their own cache lines
+static const size_t SHM_LINE = 64;
+
+// the control words are shared between processes, which needs atomics
+// that do not fall back to a lock inside one process
+static_assert(std::atomic<unsigned long long>::is_always_lock_free, "shared memory transport needs lock-free 64-bit atomics");
+
+struct ShmTransport::Header {
+    std::atomic<unsigned> ready;
+    int ranks;
+    unsigned long long ringBytes;
+    std::atomic<int> attached;
+    std::atomic<int> aborted;
+};
+
+// followed by ringBytes of data. head counts bytes written, tail bytes read
+struct ShmTransport::Ring {
+    alignas(SHM_LINE) std::atomic<unsigned long long> head;
+    alignas(SHM_LINE) std::atomic<unsigned long long> tail;
+};
+
+static size_t RoundUp(size_t bytes)
+{
+    return (bytes + SHM_LINE - 1) / SHM_LINE * SHM_LINE;
+}
+
+// constructor
+ShmTransport::ShmTransport()
+    : base(nullptr), mappedBytes(0), fd(-1), rank(0), ranks(1), ringBytes(0), ringStride(0),
+    linked(false), timeoutSeconds(60.0)
+{
+}
+
+// destructor
+ShmTransport::~ShmTransport()
+{
+    Close();
+}
+
+ShmTransport::Ring* ShmTransport::GetRing(int from, int to) const
+{
+    size_t offset = RoundUp(sizeof(Header)) + (static_cast<size_t>(from) * ranks + to) * ringStride;
+    return reinterpret_cast<Ring*>(base + offset);
+}
+
+bool ShmTransport::CheckPeer(int peer) const
+{
+    if (!base || peer < 0 || peer >= ranks || peer == rank) {
+        std::cerr << "Error: rank " << rank << " cannot reach rank " << peer << "." << std::endl;
+        return false;
+    }
+    return !GetHeader()->aborted.load(std::memory_order_relaxed);
+}
+
+bool ShmTransport::Backoff(int& spins, std::chrono::steady_clock::time_point& waitStart) const
+{
+    // peers usually answer within microseconds, so spin first, then sleep
+    // for doubling intervals of up to a millisecond so a stalled peer does
+    // not cost a core
+    if (spins++ == 0) {
+        waitStart = std::chrono::steady_clock::now();
+    }
+    if (spins < 256) {
+        return true;
+    }
+    if (GetHeader()->aborted.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count() > timeoutSeconds) {
+        std::cerr << "Error: rank " << rank << " timed out waiting for a peer." << std::endl;
+        GetHeader()->aborted.store(1);
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(1 << std::min(spins - 256, 10)));
+    return true;
+}
+
+bool ShmTransport::Send(int peer, const void* data, size_t bytes)
+{
+    if (!CheckPeer(peer)) {
+        return false;
+    }
+
+    Ring* ring = GetRing(rank, peer);
+    unsigned char* buffer = reinterpret_cast<unsigned char*>(ring) + sizeof(Ring);
+    const unsigned char* source = static_cast<const unsigned char*>(data);
+
+    // only this rank moves the head, the peer only the tail
+    unsigned long long head = ring->head.load(std::memory_order_relaxed);
+    int spins = 0;
+    std::chrono::steady_clock::time_point waitStart;
+    size_t done = 0;
+    while (done < bytes) {
+        size_t space = ringBytes - static_cast<size_t>(head - ring->tail.load(std::memory_order_acquire));
+        if (space == 0) {
+            if (!Backoff(spins, waitStart)) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t offset = static_cast<size_t>(head % ringBytes);
+        size_t chunk = std::min(std::min(space, bytes - done), ringBytes - offset);
+        std::memcpy(buffer + offset, source + done, chunk);
+        head += chunk;
+        done += chunk;
+        ring->head.store(head, std::memory_order_release);
+        spins = 0;
+    }
+    return true;
+}
+
+bool ShmTransport::Receive(int peer, void* data, size_t bytes)
+{
+    if (!CheckPeer(peer)) {
+        return false;
+    }
+
+    Ring* ring = GetRing(peer, rank);
+    const unsigned char* buffer = reinterpret_cast<const unsigned char*>(ring) + sizeof(Ring);
+    unsigned char* target = static_cast<unsigned char*>(data);
+
+    unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+    int spins = 0;
+    std::chrono::steady_clock::time_point waitStart;
+    size_t done = 0;
+    while (done < bytes) {
+        size_t available = static_cast<size_t>(ring->head.load(std::memory_order_acquire) - tail);
+        if (available == 0) {
+            if (!Backoff(spins, waitStart)) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t offset = static_cast<size_t>(tail % ringBytes);
+        size_t chunk = std::min(std::min(available, bytes - done), ringBytes - offset);
+        std::memcpy(target + done, buffer + offset, chunk);
+        tail += chunk;
+        done += chunk;
+        ring->tail.store(tail, std::memory_order_release);
+        spins = 0;
+    }
+    return true;
+}
+
+void ShmTransport::Abort()
+{
+    if (base) {
+        GetHeader()->aborted.store(1);
+    }
+}
+
+#ifdef _WIN32
+
+bool ShmTransport::Open(const char* name, int rank, int ranks, size_t ringBytes)
+{
+    (void)name;
+    (void)rank;
+    (void)ranks;
+    (void)ringBytes;
+    std::cerr << "Error: the shared memory transport needs POSIX shared memory." << std::endl;
+    return false;
+}
+
+void ShmTransport::Close()
+{
+}
+
+#else
+
+bool ShmTransport::Open(const char* name, int rank, int ranks, size_t ringBytes)
+{
+    Close();
+
+    if (ranks < 1 || rank < 0 || rank >= ranks || ringBytes == 0) {
+        std::cerr << "Error: invalid rank " << rank << " of " << ranks << "." << std::endl;
+        return false;
+    }
+    this->name = name;
+    this->rank = rank;
+    this->ranks = ranks;
+    this->ringBytes = ringBytes;
+    ringStride = RoundUp(sizeof(Ring) + ringBytes);
+    size_t totalBytes = RoundUp(sizeof(Header)) + static_cast<size_t>(ranks) * ranks * ringStride;
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    if (rank == 0) {
+        // a segment left behind by a crashed run of the same name is replaced
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            shm_unlink(name);
+            fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        }
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(totalBytes)) != 0) {
+            std::cerr << "Error: cannot create shared memory " << name << std::endl;
+            Close();
+            return false;
+        }
+        linked = true;
+    }
+    else {
+        // wait for rank 0 to create and size the segment
+        struct stat info;
+        while (true) {
+            if (fd < 0) {
+                fd = shm_open(name, O_RDWR, 0600);
+            }
+            if (fd >= 0 && fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= totalBytes) {
+                break;
+            }
+            if (elapsed() > timeoutSeconds) {
+                std::cerr << "Error: cannot attach to shared memory " << name << std::endl;
+                Close();
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void* mapped = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error: cannot map shared memory " << name << std::endl;
+        Close();
+        return false;
+    }
+    base = static_cast<unsigned char*>(mapped);
+    mappedBytes = totalBytes;
+    Header* header = GetHeader();
+
+    if (rank == 0) {
+        // the new segment is zero filled, the atomics are constructed in place
+        new (&header->attached) std::atomic<int>(0);
+        new (&header->aborted) std::atomic<int>(0);
+        header->ranks = ranks;
+        header->ringBytes = ringBytes;
+        for (int from = 0; from < ranks; from++) {
+            for (int to = 0; to < ranks; to++) {
+                new (GetRing(from, to)) Ring();
+                GetRing(from, to)->head.store(0);
+                GetRing(from, to)->tail.store(0);
+            }
+        }
+        new (&header->ready) std::atomic<unsigned>(0);
+        header->ready.store(SHM_MAGIC, std::memory_order_release);
+    }
+    else {
+        while (header->ready.load(std::memory_order_acquire) != SHM_MAGIC) {
+            if (elapsed() > timeoutSeconds) {
+                std::cerr << "Error: shared memory " << name << " was never initialised." << std::endl;
+                Close();
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (header->ranks != ranks || header->ringBytes != ringBytes) {
+            std::cerr << "Error: shared memory " << name << " was created for " << header->ranks << " ranks." << std::endl;
+            Close();
+            return false;
+        }
+    }
+    header->attached.fetch_add(1);
+
+    // once everyone is in, the name is no longer needed and the segment
+    // goes away with the last process
+    if (rank == 0) {
+        while (header->attached.load() < ranks) {
+            if (header->aborted.load() || elapsed() > timeoutSeconds) {
+                std::cerr << "Error: only " << header->attached.load() << " of " << ranks
+                    << " ranks attached to " << name << std::endl;
+                Abort();
+                Close();
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        shm_unlink(name);
+        linked = false;
+    }
+    return true;
+}
+
+void ShmTransport::Close()
+{
+    if (base) {
+        munmap(base, mappedBytes);
+        base = nullptr;
+        mappedBytes = 0;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (linked) {
+        shm_unlink(name.c_str());
+        linked = false;
+    }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SHMTRANSPORT_H
+#define SHMTRANSPORT_H
+
+#include <chrono>
+#include <string>
+#include "HaloTransport.h"
+
+// HaloTransport between processes on one machine through a POSIX shared
+// memory segment holding a single-producer single-consumer byte ring per
+// ordered pair of ranks. rank 0 creates the segment and removes its name
+// once every rank has attached. blocked calls spin briefly, then sleep
+// for growing intervals, and give up when a peer aborts or nothing moves
+// for the timeout
+class ShmTransport : public HaloTransport {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    ShmTransport();
+
+    // destructor, closes the segment
+    ~ShmTransport();
+
+    // rank 0 creates the segment `name` (e.g. "/fluidsim-1234") with
+    // ringBytes of buffering per ordered pair of ranks, the other ranks
+    // attach to it, waiting up to the timeout for rank 0
+    bool Open(const char* name, int rank, int ranks, size_t ringBytes = 1 << 20);
+    void Close();
+
+    // make every rank's pending and future calls fail, e.g. on an error
+    void Abort();
+
+    // seconds a blocked call waits without progress before failing
+    void SetTimeout(double seconds) { timeoutSeconds = seconds; }
+
+    int GetRank() const override { return rank; }
+    int GetRankCount() const override { return ranks; }
+    bool Send(int peer, const void* data, size_t bytes) override;
+    bool Receive(int peer, void* data, size_t bytes) override;
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    struct Header;
+    struct Ring;
+
+    unsigned char* base;
+    size_t mappedBytes;
+    int fd;
+    int rank, ranks;
+    size_t ringBytes;
+    size_t ringStride;
+    std::string name;
+    bool linked;
+    double timeoutSeconds;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    Header* GetHeader() const { return reinterpret_cast<Header*>(base); }
+    Ring* GetRing(int from, int to) const;
+    bool CheckPeer(int peer) const;
+    // wait a little for a peer, false once aborted or past the timeout.
+    // spins is 0 at the start of a wait, which is when waitStart is taken
+    bool Backoff(int& spins, std::chrono::steady_clock::time_point& waitStart) const;
+};
+
+#endif // SHMTRANSPORT_H
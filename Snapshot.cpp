@@ -0,0 +1,150 @@
+#include "Snapshot.h"
+#include "FluidSolver.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char SNAPSHOT_MAGIC[4] = { 'F', 'S', 'S', 'N' };
+
+bool Snapshot::Save(const FluidSolver& solver, const char* path, const CodecOptions& options,
+    ThreadPool* pool, SnapshotStats* stats)
+{
+    int nvx = solver.GetVelocityNX();
+    int nvy = solver.GetVelocityNY();
+    SnapshotFieldRef fields[3] = {
+        { DENSITY, solver.GetNX(), solver.GetNY(), solver.GetDensity() },
+        { VELOCITY_U, nvx, nvy, solver.GetVelocityU() },
+        { VELOCITY_V, nvx, nvy, solver.GetVelocityV() }
+    };
+    return Write(path, solver.GetStepCount(), fields, 3, options, pool, stats);
+}
+
+bool Snapshot::Write(const char* path, long long step, const SnapshotFieldRef* fields, int fieldCount,
+    const CodecOptions& options, ThreadPool* pool, SnapshotStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // magic, version, step, field count
+    unsigned char header[20];
+    uint32_t version = SNAPSHOT_VERSION;
+    int64_t step64 = step;
+    uint32_t count = static_cast<uint32_t>(fieldCount);
+    std::memcpy(header, SNAPSHOT_MAGIC, 4);
+    std::memcpy(header + 4, &version, 4);
+    std::memcpy(header + 8, &step64, 8);
+    std::memcpy(header + 16, &count, 4);
+    std::vector<unsigned char> out(header, header + sizeof(header));
+
+    size_t rawBytes = 0;
+    for (int f = 0; f < fieldCount; f++) {
+        const SnapshotFieldRef& field = fields[f];
+        int32_t dims[3] = { static_cast<int32_t>(field.type), field.nx, field.ny };
+
+        // stream length is patched in once the field is encoded
+        size_t dimsAt = out.size();
+        size_t lengthAt = dimsAt + sizeof(dims);
+        out.resize(lengthAt + sizeof(uint64_t));
+        std::memcpy(out.data() + dimsAt, dims, sizeof(dims));
+
+        size_t values = static_cast<size_t>(field.nx + 2) * (field.ny + 2);
+        FieldCodec::Encode(field.data, values, options, pool, out);
+        uint64_t bytes = out.size() - lengthAt - sizeof(uint64_t);
+        std::memcpy(out.data() + lengthAt, &bytes, sizeof(bytes));
+        rawBytes += values * sizeof(float);
+    }
+
+    double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return false;
+    }
+    size_t written = std::fwrite(out.data(), 1, out.size(), file);
+    bool ok = (std::fclose(file) == 0) && written == out.size();
+    if (!ok) {
+        std::cerr << "Error: short write to " << path << std::endl;
+        return false;
+    }
+
+    if (stats) {
+        stats->rawBytes = rawBytes;
+        stats->storedBytes = out.size();
+        stats->encodeMs = encodeMs;
+    }
+    return true;
+}
+
+bool Snapshot::Load(const char* path, long long& step, std::vector<SnapshotField>& fields, ThreadPool* pool)
+{
+    FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        std::cerr << "Error: cannot open snapshot " << path << std::endl;
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    std::vector<unsigned char> in(length > 0 ? static_cast<size_t>(length) : 0);
+    size_t got = std::fread(in.data(), 1, in.size(), file);
+    std::fclose(file);
+
+    const size_t headerBytes = 20;
+    uint32_t version = 0, count = 0;
+    int64_t step64 = 0;
+    if (got != in.size() || in.size() < headerBytes || std::memcmp(in.data(), SNAPSHOT_MAGIC, 4) != 0) {
+        std::cerr << "Error: " << path << " is not a snapshot." << std::endl;
+        return false;
+    }
+    std::memcpy(&version, in.data() + 4, 4);
+    std::memcpy(&step64, in.data() + 8, 8);
+    std::memcpy(&count, in.data() + 16, 4);
+    if (version != SNAPSHOT_VERSION) {
+        std::cerr << "Error: unsupported snapshot version " << version << "." << std::endl;
+        return false;
+    }
+
+    fields.clear();
+    size_t offset = headerBytes;
+    for (uint32_t f = 0; f < count; f++) {
+        int32_t dims[3];
+        uint64_t bytes;
+        if (in.size() - offset < sizeof(dims) + sizeof(bytes)) {
+            break;
+        }
+        std::memcpy(dims, in.data() + offset, sizeof(dims));
+        std::memcpy(&bytes, in.data() + offset + sizeof(dims), sizeof(bytes));
+        offset += sizeof(dims) + sizeof(bytes);
+        // snapshots hold 2D fields only
+        if (dims[0] < DENSITY || dims[0] > VELOCITY_V || dims[1] <= 0 || dims[2] <= 0 ||
+            in.size() - offset < bytes) {
+            break;
+        }
+        // the grid must agree with the stream before it is allocated
+        size_t values = static_cast<size_t>(static_cast<int64_t>(dims[1]) + 2) * (static_cast<int64_t>(dims[2]) + 2);
+        if (!FieldCodec::CheckCount(in.data() + offset, static_cast<size_t>(bytes), values)) {
+            break;
+        }
+
+        SnapshotField field;
+        field.type = static_cast<FieldType>(dims[0]);
+        field.nx = dims[1];
+        field.ny = dims[2];
+        field.data.resize(values);
+        if (!FieldCodec::Decode(in.data() + offset, static_cast<size_t>(bytes), field.data.data(),
+            field.data.size(), pool)) {
+            break;
+        }
+        offset += static_cast<size_t>(bytes);
+        fields.push_back(std::move(field));
+    }
+
+    if (fields.size() != count) {
+        std::cerr << "Error: corrupt snapshot " << path << "." << std::endl;
+        return false;
+    }
+    step = step64;
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include "FieldCodec.h"
+#include "Grid.h"
+
+class FluidSolver;
+
+// compressed snapshot file, little-endian:
+//   "FSSN", u32 version, i64 step, u32 field count
+//   then per field: i32 type, i32 nx, i32 ny, u64 bytes, FieldCodec stream
+#define SNAPSHOT_VERSION 1
+
+// field to store, (nx + 2) x (ny + 2) values borrowed from the caller
+struct SnapshotFieldRef {
+    FieldType type;
+    int nx, ny;
+    const float* data;
+};
+
+// field read back from a snapshot
+struct SnapshotField {
+    FieldType type;
+    int nx, ny;
+    std::vector<float> data;
+};
+
+// sizes and encode time of the last write
+struct SnapshotStats {
+    size_t rawBytes;
+    size_t storedBytes;
+    double encodeMs;
+};
+
+// density and velocity of a solver compressed with FieldCodec. unlike a
+// Checkpoint a snapshot holds only what is needed to look at a step, not
+// to resume it, and is meant for long output series.
+class Snapshot {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // dens, u and v of the solver at its current step
+    static bool Save(const FluidSolver& solver, const char* path, const CodecOptions& options,
+        ThreadPool* pool = nullptr, SnapshotStats* stats = nullptr);
+
+    static bool Write(const char* path, long long step, const SnapshotFieldRef* fields, int fieldCount,
+        const CodecOptions& options, ThreadPool* pool = nullptr, SnapshotStats* stats = nullptr);
+
+    // false if the file is missing, of another version or corrupt
+    static bool Load(const char* path, long long& step, std::vector<SnapshotField>& fields,
+        ThreadPool* pool = nullptr);
+};
+
+#endif // SNAPSHOT_H
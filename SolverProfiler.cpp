@@ -0,0 +1,142 @@
+#include "SolverProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+// constructor
+SolverProfiler::SolverProfiler()
+{
+    Reset();
+}
+
+void SolverProfiler::Reset()
+{
+    steps = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        current[p] = 0.0;
+        total[p] = 0.0;
+        calls[p] = 0;
+        iterations[p] = 0;
+        residuals[p] = 0.0f;
+        solveStep[p] = -1;
+        std::fill(window[p], window[p] + PROFILE_WINDOW, 0.0);
+    }
+    std::fill(threadBusyMs.begin(), threadBusyMs.end(), 0.0);
+}
+
+void SolverProfiler::AddTime(ProfilePhase phase, double ms)
+{
+    current[phase] += ms;
+    total[phase] += ms;
+    calls[phase]++;
+}
+
+void SolverProfiler::RecordSolve(ProfilePhase phase, int iters, float residual)
+{
+    if (!enabled) {
+        return;
+    }
+
+    // the first solve of a new step replaces the previous step's
+    if (solveStep[phase] != steps) {
+        solveStep[phase] = steps;
+        iterations[phase] = 0;
+        residuals[phase] = 0.0f;
+    }
+    iterations[phase] += iters;
+    residuals[phase] = std::max(residuals[phase], residual);
+}
+
+void SolverProfiler::AddThreadBusy(int thread, double ms)
+{
+    if (thread >= static_cast<int>(threadBusyMs.size())) {
+        threadBusyMs.resize(thread + 1, 0.0);
+    }
+    threadBusyMs[thread] += ms;
+}
+
+void SolverProfiler::EndStep()
+{
+    if (!enabled) {
+        return;
+    }
+
+    int slot = static_cast<int>(steps % PROFILE_WINDOW);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        window[p][slot] = current[p];
+        current[p] = 0.0;
+    }
+    steps++;
+}
+
+PhaseStats SolverProfiler::GetStats(ProfilePhase phase) const
+{
+    PhaseStats stats = { 0.0, 0.0, 0.0, 0.0, total[phase], calls[phase] };
+
+    int count = static_cast<int>(std::min<long long>(steps, PROFILE_WINDOW));
+    if (count == 0) {
+        return stats;
+    }
+
+    stats.lastMs = window[phase][(steps - 1) % PROFILE_WINDOW];
+    stats.minMs = window[phase][0];
+    stats.maxMs = window[phase][0];
+    double sum = 0.0;
+    for (int s = 0; s < count; s++) {
+        double ms = window[phase][s];
+        sum += ms;
+        stats.minMs = std::min(stats.minMs, ms);
+        stats.maxMs = std::max(stats.maxMs, ms);
+    }
+    stats.meanMs = sum / count;
+    return stats;
+}
+
+void SolverProfiler::Dump(std::ostream& out) const
+{
+    char line[160];
+
+    out << "solver profile: " << steps << " steps, last "
+        << std::min<long long>(steps, PROFILE_WINDOW) << " in window" << std::endl;
+    std::snprintf(line, sizeof(line), "%-18s %10s %10s %10s %10s %8s %12s",
+        "phase", "last ms", "mean ms", "min ms", "max ms", "% step", "calls");
+    out << line << std::endl;
+
+    double stepMean = GetStats(PHASE_STEP).meanMs;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        PhaseStats s = GetStats(static_cast<ProfilePhase>(p));
+        std::snprintf(line, sizeof(line), "%-18s %10.4f %10.4f %10.4f %10.4f %7.1f%% %12lld",
+            PhaseName(static_cast<ProfilePhase>(p)), s.lastMs, s.meanMs, s.minMs, s.maxMs,
+            stepMean > 0.0 ? 100.0 * s.meanMs / stepMean : 0.0, s.calls);
+        out << line << std::endl;
+    }
+
+    const ProfilePhase solves[] = { PHASE_DIFFUSE_VELOCITY, PHASE_PROJECT, PHASE_DIFFUSE_DENSITY };
+    for (ProfilePhase p : solves) {
+        std::snprintf(line, sizeof(line), "%-18s %4d iterations per step, residual %.3e%s", PhaseName(p),
+            iterations[p], residuals[p], trackResiduals ? "" : " (tracking off)");
+        out << line << std::endl;
+    }
+
+    double stepTotal = total[PHASE_STEP];
+    for (size_t t = 0; t < threadBusyMs.size(); t++) {
+        std::snprintf(line, sizeof(line), "thread %-11d %10.2f ms busy (%.1f%% of step time)",
+            static_cast<int>(t), threadBusyMs[t], stepTotal > 0.0 ? 100.0 * threadBusyMs[t] / stepTotal : 0.0);
+        out << line << std::endl;
+    }
+}
+
+const char* SolverProfiler::PhaseName(ProfilePhase phase)
+{
+    switch (phase) {
+    case PHASE_STEP: return "Step";
+    case PHASE_UPDATE_ACTIVITY: return "UpdateActivity";
+    case PHASE_DIFFUSE_VELOCITY: return "DiffuseVelocity";
+    case PHASE_PROJECT: return "Project";
+    case PHASE_ADVECT_VELOCITY: return "AdvectVelocity";
+    case PHASE_DIFFUSE_DENSITY: return "DiffuseDensity";
+    case PHASE_ADVECT_DENSITY: return "AdvectDensity";
+    case PHASE_SET_BOUNDARY: return "SetBoundary";
+    default: return "?";
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef SOLVERPROFILER_H
+#define SOLVERPROFILER_H
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+#include "Tracer.h"
+
+// steps kept for the rolling statistics
+#define PROFILE_WINDOW 128
+
+// phases timed inside Step(). nested phases (SetBoundary inside Diffuse)
+// are counted in both, so the per-phase times are inclusive
+enum ProfilePhase {
+    PHASE_STEP,
+    PHASE_UPDATE_ACTIVITY,
+    PHASE_DIFFUSE_VELOCITY,
+    PHASE_PROJECT,
+    PHASE_ADVECT_VELOCITY,
+    PHASE_DIFFUSE_DENSITY,
+    PHASE_ADVECT_DENSITY,
+    PHASE_SET_BOUNDARY,
+    PHASE_COUNT
+};
+
+// per-phase time per step over the rolling window, in ms
+struct PhaseStats {
+    double lastMs;
+    double meanMs;
+    double minMs;
+    double maxMs;
+    // over the whole run
+    double totalMs;
+    long long calls;
+};
+
+// timings, iteration counts and residuals of a solver, aggregated per
+// step into rolling statistics. solvers own one and time their phases
+// with ScopedPhaseTimer; callers read it back or Dump() it on demand.
+class SolverProfiler {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    SolverProfiler();
+
+    // timing is on by default, residuals cost an extra sweep and are off
+    void SetEnabled(bool enable) { enabled = enable; }
+    bool IsEnabled() const { return enabled; }
+    void SetResidualTracking(bool enable) { trackResiduals = enable; }
+    bool IsTrackingResiduals() const { return enabled && trackResiduals; }
+
+    // forget every sample
+    void Reset();
+
+    // accumulate time into the current step
+    void AddTime(ProfilePhase phase, double ms);
+    // iterations and final residual (max norm) of a relaxation. a phase
+    // solved several times in a step (u and v, both projections) reports
+    // the sum of the iterations and the largest residual of that step
+    void RecordSolve(ProfilePhase phase, int iterations, float residual);
+    // busy time of one pool thread (0 = the stepping thread) during this step
+    void AddThreadBusy(int thread, double ms);
+    // close the current step and push its times into the window
+    void EndStep();
+
+    PhaseStats GetStats(ProfilePhase phase) const;
+    long long GetStepCount() const { return steps; }
+    int GetIterations(ProfilePhase phase) const { return iterations[phase]; }
+    float GetResidual(ProfilePhase phase) const { return residuals[phase]; }
+    int GetThreadCount() const { return static_cast<int>(threadBusyMs.size()); }
+    double GetThreadBusy(int thread) const { return threadBusyMs[thread]; }
+
+    // human-readable table of every phase, solve and thread
+    void Dump(std::ostream& out) const;
+
+    static const char* PhaseName(ProfilePhase phase);
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    bool enabled = true;
+    bool trackResiduals = false;
+    long long steps = 0;
+
+    // current step, then the window of per-step totals
+    double current[PHASE_COUNT];
+    double window[PHASE_COUNT][PROFILE_WINDOW];
+    double total[PHASE_COUNT];
+    long long calls[PHASE_COUNT];
+
+    int iterations[PHASE_COUNT];
+    float residuals[PHASE_COUNT];
+    // step the solves above belong to
+    long long solveStep[PHASE_COUNT];
+
+    std::vector<double> threadBusyMs;
+};
+
+// adds the lifetime of the scope to a phase of an enabled profiler (and
+// to the trace timeline when tracing is compiled in)
+class ScopedPhaseTimer {
+
+public:
+
+    ScopedPhaseTimer(SolverProfiler& profiler, ProfilePhase phase)
+        : profiler(profiler), phase(phase), active(profiler.IsEnabled())
+#ifdef FLUIDSIM_TRACE
+        , trace(SolverProfiler::PhaseName(phase))
+#endif
+    {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedPhaseTimer()
+    {
+        if (active) {
+            profiler.AddTime(phase, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+
+    SolverProfiler& profiler;
+    ProfilePhase phase;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+#ifdef FLUIDSIM_TRACE
+    TraceScope trace;
+#endif
+};
+
+#endif // SOLVERPROFILER_H
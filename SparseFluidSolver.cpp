@@ -0,0 +1,239 @@
+#include "SparseFluidSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// constructor
+SparseFluidSolver::SparseFluidSolver(int n, float threshold) : N(n), grid(threshold)
+{
+    std::cout << "SparseFluidSolver constructor called. Reference N = " << N << "." << std::endl;
+}
+
+// destructor
+SparseFluidSolver::~SparseFluidSolver() {
+
+}
+
+void SparseFluidSolver::AddInputToField(FieldType fieldType, int i, int j, float s)
+{
+    if (fieldType != DENSITY && fieldType != VELOCITY_U && fieldType != VELOCITY_V) {
+        std::cerr << "Error: Invalid field type." << std::endl;
+        return;
+    }
+
+    // inputs activate their tile; the halo is added on the next step
+    int index;
+    SparseTile* tile = grid.LocateOrCreate(i, j, index);
+    tile->field[fieldType][index] += s * dt;
+}
+
+void SparseFluidSolver::Rasterize(FieldType fieldType, int i0, int j0, int w, int h, float* out) const
+{
+    for (int j = 0; j < h; j++) {
+        for (int i = 0; i < w; i++) {
+            out[i + w * j] = grid.GetCell(fieldType, i0 + i, j0 + j);
+        }
+    }
+}
+
+float SparseFluidSolver::Sample(const SparseTile* home, int slot, float x, float y) const
+{
+    // a NaN backtrace (the velocity blew up) carries nothing, and far or
+    // infinite ones are clamped so the cell index fits an int. the domain
+    // is unbounded, so there is no edge to clamp to as the dense solver does
+    const float limit = static_cast<float>(1 << 30);
+    if (std::isnan(x) || std::isnan(y)) {
+        return 0.0f;
+    }
+    x = std::min(std::max(x, -limit), limit);
+    y = std::min(std::max(y, -limit), limit);
+
+    int i0 = static_cast<int>(std::floor(x));
+    int j0 = static_cast<int>(std::floor(y));
+    float s1 = x - i0;
+    float s0 = 1.0f - s1;
+    float t1 = y - j0;
+    float t0 = 1.0f - t1;
+
+    // backtraces rarely leave the neighbourhood of their tile, so the
+    // links usually replace the hash lookup
+    int index;
+    const SparseTile* tile = grid.LocateNear(home, i0, j0, index);
+    int li = index % (SPARSE_TILE_SIZE + 2);
+    int lj = index / (SPARSE_TILE_SIZE + 2);
+
+    // fast path: the 2x2 stencil lies inside one tile
+    if (tile && li < SPARSE_TILE_SIZE && lj < SPARSE_TILE_SIZE) {
+        const float* d0 = tile->field[slot];
+        return s0 * (t0 * d0[index] + t1 * d0[index + SPARSE_TILE_SIZE + 2]) +
+            s1 * (t0 * d0[index + 1] + t1 * d0[index + SPARSE_TILE_SIZE + 3]);
+    }
+
+    // stencil straddles tiles, look each corner up
+    float v00 = tile ? tile->field[slot][index] : 0.0f;
+    const SparseTile* t01 = grid.LocateNear(home, i0, j0 + 1, index);
+    float v01 = t01 ? t01->field[slot][index] : 0.0f;
+    const SparseTile* t10 = grid.LocateNear(home, i0 + 1, j0, index);
+    float v10 = t10 ? t10->field[slot][index] : 0.0f;
+    const SparseTile* t11 = grid.LocateNear(home, i0 + 1, j0 + 1, index);
+    float v11 = t11 ? t11->field[slot][index] : 0.0f;
+
+    return s0 * (t0 * v00 + t1 * v01) + s1 * (t0 * v10 + t1 * v11);
+}
+
+// diffuse function using block Gauss-Seidel relaxation over the allocated tiles
+void SparseFluidSolver::Diffuse(FieldType fieldType, int NumIters)
+{
+    float a = dt * diff * N * N;
+
+    for (int k = 0; k < NumIters; k++) {
+        for (SparseTile* tile : grid.tiles) {
+            // pull the latest neighbour values into the ghost ring
+            grid.RefreshGhosts(tile, fieldType);
+
+            float* x = tile->field[fieldType];
+            const float* x0 = tile->field[3 + fieldType];
+            for (int j = 1; j <= SPARSE_TILE_SIZE; j++) {
+                for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                    x[TIX(i, j)] = (x0[TIX(i, j)] + a * (x[TIX(i - 1, j)] + x[TIX(i + 1, j)] +
+                        x[TIX(i, j - 1)] + x[TIX(i, j + 1)])) / (1 + 4 * a);
+                }
+            }
+        }
+    }
+}
+
+void SparseFluidSolver::Advect(FieldType fieldType)
+{
+    // density is carried by the current velocity, velocity by the projected
+    // velocity left in the previous buffers
+    int uSlot = (fieldType == DENSITY) ? VELOCITY_U : 3 + VELOCITY_U;
+    int vSlot = (fieldType == DENSITY) ? VELOCITY_V : 3 + VELOCITY_V;
+    int srcSlot = 3 + fieldType;
+
+    float dt0 = dt * N;
+
+    for (SparseTile* tile : grid.tiles) {
+        float* d = tile->field[fieldType];
+        const float* u = tile->field[uSlot];
+        const float* v = tile->field[vSlot];
+        int baseI = tile->ti * SPARSE_TILE_SIZE - 1;
+        int baseJ = tile->tj * SPARSE_TILE_SIZE - 1;
+
+        for (int j = 1; j <= SPARSE_TILE_SIZE; j++) {
+            for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                float x = (baseI + i) - dt0 * u[TIX(i, j)];
+                float y = (baseJ + j) - dt0 * v[TIX(i, j)];
+                d[TIX(i, j)] = Sample(tile, srcSlot, x, y);
+            }
+        }
+    }
+}
+
+void SparseFluidSolver::StepDensity()
+{
+    // swap the previous and current density buffers
+    grid.SwapBuffers(DENSITY);
+
+    // diffuse the density
+    Diffuse(DENSITY);
+
+    // swap the buffers again to prepare for the advection step
+    grid.SwapBuffers(DENSITY);
+
+    // advect the density using the velocity fields
+    Advect(DENSITY);
+}
+
+void SparseFluidSolver::Project()
+{
+    float h = 1.0f / N;
+    const int p = 3 + VELOCITY_U;   // u_prev stores pressure temporarily
+    const int div = 3 + VELOCITY_V; // v_prev stores divergence temporarily
+
+    // compute divergence of the velocity field
+    for (SparseTile* tile : grid.tiles) {
+        grid.RefreshGhosts(tile, VELOCITY_U);
+        grid.RefreshGhosts(tile, VELOCITY_V);
+    }
+    for (SparseTile* tile : grid.tiles) {
+        const float* u = tile->field[VELOCITY_U];
+        const float* v = tile->field[VELOCITY_V];
+        float* pt = tile->field[p];
+        float* dv = tile->field[div];
+        for (int j = 1; j <= SPARSE_TILE_SIZE; j++) {
+            for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                dv[TIX(i, j)] = -0.5f * h * (u[TIX(i + 1, j)] - u[TIX(i - 1, j)] +
+                    v[TIX(i, j + 1)] - v[TIX(i, j - 1)]);
+                pt[TIX(i, j)] = 0;
+            }
+        }
+    }
+
+    // solve for the pressure, open (p = 0) beyond the allocated tiles
+    for (int k = 0; k < 20; k++) {
+        for (SparseTile* tile : grid.tiles) {
+            grid.RefreshGhosts(tile, p);
+
+            float* pt = tile->field[p];
+            const float* dv = tile->field[div];
+            for (int j = 1; j <= SPARSE_TILE_SIZE; j++) {
+                for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                    pt[TIX(i, j)] = (dv[TIX(i, j)] + pt[TIX(i - 1, j)] + pt[TIX(i + 1, j)] +
+                        pt[TIX(i, j - 1)] + pt[TIX(i, j + 1)]) / 4.0f;
+                }
+            }
+        }
+    }
+
+    // subtract the pressure gradient from the velocity field
+    for (SparseTile* tile : grid.tiles) {
+        grid.RefreshGhosts(tile, p);
+    }
+    for (SparseTile* tile : grid.tiles) {
+        float* u = tile->field[VELOCITY_U];
+        float* v = tile->field[VELOCITY_V];
+        const float* pt = tile->field[p];
+        for (int j = 1; j <= SPARSE_TILE_SIZE; j++) {
+            for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                u[TIX(i, j)] -= 0.5f * (pt[TIX(i + 1, j)] - pt[TIX(i - 1, j)]) / h;
+                v[TIX(i, j)] -= 0.5f * (pt[TIX(i, j + 1)] - pt[TIX(i, j - 1)]) / h;
+            }
+        }
+    }
+}
+
+void SparseFluidSolver::StepVelocity()
+{
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+
+    Diffuse(VELOCITY_U, 20);
+    Diffuse(VELOCITY_V, 20);
+
+    // project the velocity field to ensure it's divergence-free
+    Project();
+
+    // swap the buffers to prepare for the advection step
+    grid.SwapBuffers(VELOCITY_U);
+    grid.SwapBuffers(VELOCITY_V);
+
+    // advect the velocity fields
+    Advect(VELOCITY_U);
+    Advect(VELOCITY_V);
+
+    // project the velocity field again to ensure it's divergence-free after advection
+    Project();
+}
+
+void SparseFluidSolver::Step()
+{
+    // activate/retire tiles before touching any field
+    grid.UpdateActiveSet();
+
+    // step velocity field
+    StepVelocity();
+
+    // step density field
+    StepDensity();
+}
@@ -0,0 +1,67 @@
+#ifndef SPARSEFLUIDSOLVER_H
+#define SPARSEFLUIDSOLVER_H
+
+#include "SparseGrid.h"
+
+// stable fluids on an unbounded, sparsely tiled domain.
+// only tiles holding density or velocity above the threshold (plus a
+// one-tile halo) are allocated and simulated; empty space reads as zero.
+class SparseFluidSolver {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, n = reference resolution (cell size 1/n, as in FluidSolver)
+    SparseFluidSolver(int n, float threshold = 1e-4f);
+
+    // destructor
+    ~SparseFluidSolver();
+
+    // add input to a specified field at a global cell (any integer coordinates)
+    void AddInputToField(FieldType fieldType, int i, int j, float s);
+
+    // step
+    void Step();
+
+    // copy a w x h window of a field starting at global cell (i0, j0) into out
+    void Rasterize(FieldType fieldType, int i0, int j0, int w, int h, float* out) const;
+
+    // number of tiles simulated per step
+    int GetTileCount() const { return grid.GetTileCount(); }
+    size_t GetAllocatedBytes() const { return grid.GetAllocatedBytes(); }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    // reference resolution
+    int N;
+    // SparseGrid object to manage tile data
+    SparseGrid grid;
+
+    // delta time
+    float dt = 0.8f;
+    // diffusion coefficient
+    float diff = 0.0001f;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // bilinear sample of a field slot at global position (x, y), tiles
+    // are found starting from `home`, the tile the backtrace began in
+    float Sample(const SparseTile* home, int slot, float x, float y) const;
+
+    void Diffuse(FieldType fieldType, int NumIters = 20);
+    void Advect(FieldType fieldType);
+    void StepDensity();
+    void Project();
+    void StepVelocity();
+};
+
+#endif // SPARSEFLUIDSOLVER_H
@@ -0,0 +1,253 @@
+#include "SparseGrid.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// retired tiles kept around for reuse before memory is returned
+static const size_t MAX_POOLED_TILES = 256;
+
+static const int TILE_ARRAY = (SPARSE_TILE_SIZE + 2) * (SPARSE_TILE_SIZE + 2);
+
+// integer division rounding towards negative infinity
+static inline int FloorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// constructor
+SparseGrid::SparseGrid(float threshold) : threshold(threshold)
+{
+    std::cout << "SparseGrid constructor called. Tile size = " << SPARSE_TILE_SIZE
+        << ", threshold = " << threshold << "." << std::endl;
+}
+
+// destructor
+SparseGrid::~SparseGrid()
+{
+    for (SparseTile* tile : tiles) {
+        delete tile;
+    }
+    for (SparseTile* tile : freeTiles) {
+        delete tile;
+    }
+}
+
+size_t SparseGrid::GetAllocatedBytes() const
+{
+    return (tiles.size() + freeTiles.size()) * sizeof(SparseTile);
+}
+
+long long SparseGrid::Key(int ti, int tj)
+{
+    return static_cast<long long>((static_cast<unsigned long long>(static_cast<unsigned int>(ti)) << 32) |
+        static_cast<unsigned int>(tj));
+}
+
+SparseTile* SparseGrid::FindTile(int ti, int tj) const
+{
+    auto it = tileMap.find(Key(ti, tj));
+    return (it == tileMap.end()) ? nullptr : it->second;
+}
+
+SparseTile* SparseGrid::FindOrCreateTile(int ti, int tj)
+{
+    SparseTile* tile = FindTile(ti, tj);
+    if (tile) {
+        return tile;
+    }
+
+    // reuse a retired tile if possible
+    if (!freeTiles.empty()) {
+        tile = freeTiles.back();
+        freeTiles.pop_back();
+    }
+    else {
+        tile = new SparseTile;
+    }
+
+    tile->ti = ti;
+    tile->tj = tj;
+    tile->live = false;
+    std::memset(tile->data, 0, sizeof(tile->data));
+    for (int s = 0; s < 6; s++) {
+        tile->field[s] = tile->data + s * TILE_ARRAY;
+    }
+
+    // link with existing neighbours
+    static const int di[4] = { -1, 1, 0, 0 };
+    static const int dj[4] = { 0, 0, -1, 1 };
+    for (int n = 0; n < 4; n++) {
+        SparseTile* other = FindTile(ti + di[n], tj + dj[n]);
+        tile->neighbor[n] = other;
+        if (other) {
+            other->neighbor[n ^ 1] = tile;
+        }
+    }
+
+    tile->listIndex = static_cast<int>(tiles.size());
+    tiles.push_back(tile);
+    tileMap[Key(ti, tj)] = tile;
+    return tile;
+}
+
+void SparseGrid::RetireTile(SparseTile* tile)
+{
+    // unlink from neighbours
+    for (int n = 0; n < 4; n++) {
+        if (tile->neighbor[n]) {
+            tile->neighbor[n]->neighbor[n ^ 1] = nullptr;
+        }
+    }
+
+    // swap-remove from the tile list
+    SparseTile* last = tiles.back();
+    tiles[tile->listIndex] = last;
+    last->listIndex = tile->listIndex;
+    tiles.pop_back();
+    tileMap.erase(Key(tile->ti, tile->tj));
+
+    if (freeTiles.size() < MAX_POOLED_TILES) {
+        freeTiles.push_back(tile);
+    }
+    else {
+        delete tile;
+    }
+}
+
+SparseTile* SparseGrid::Locate(int i, int j, int& index) const
+{
+    int ti = FloorDiv(i, SPARSE_TILE_SIZE);
+    int tj = FloorDiv(j, SPARSE_TILE_SIZE);
+    index = TIX(i - ti * SPARSE_TILE_SIZE + 1, j - tj * SPARSE_TILE_SIZE + 1);
+    return FindTile(ti, tj);
+}
+
+SparseTile* SparseGrid::LocateOrCreate(int i, int j, int& index)
+{
+    int ti = FloorDiv(i, SPARSE_TILE_SIZE);
+    int tj = FloorDiv(j, SPARSE_TILE_SIZE);
+    index = TIX(i - ti * SPARSE_TILE_SIZE + 1, j - tj * SPARSE_TILE_SIZE + 1);
+    return FindOrCreateTile(ti, tj);
+}
+
+const SparseTile* SparseGrid::LocateNear(const SparseTile* from, int i, int j, int& index) const
+{
+    int ti = FloorDiv(i, SPARSE_TILE_SIZE);
+    int tj = FloorDiv(j, SPARSE_TILE_SIZE);
+    index = TIX(i - ti * SPARSE_TILE_SIZE + 1, j - tj * SPARSE_TILE_SIZE + 1);
+
+    int di = ti - from->ti;
+    int dj = tj - from->tj;
+    if (di < -1 || di > 1 || dj < -1 || dj > 1) {
+        return FindTile(ti, tj);
+    }
+
+    // links are nullptr exactly where no tile is allocated
+    int side = (di < 0) ? 0 : 1;
+    int end = (dj < 0) ? 2 : 3;
+    if (dj == 0) {
+        return (di == 0) ? from : from->neighbor[side];
+    }
+    if (di == 0) {
+        return from->neighbor[end];
+    }
+
+    // a diagonal goes through either edge neighbour, with both empty
+    // only the map knows
+    if (from->neighbor[side]) {
+        return from->neighbor[side]->neighbor[end];
+    }
+    if (from->neighbor[end]) {
+        return from->neighbor[end]->neighbor[side];
+    }
+    return FindTile(ti, tj);
+}
+
+float SparseGrid::GetCell(FieldType fieldType, int i, int j) const
+{
+    int index;
+    SparseTile* tile = Locate(i, j, index);
+    return tile ? tile->field[fieldType][index] : 0.0f;
+}
+
+void SparseGrid::UpdateActiveSet()
+{
+    // a tile is live while any current field exceeds the threshold
+    for (SparseTile* tile : tiles) {
+        tile->live = false;
+        for (int s = 0; s < 3 && !tile->live; s++) {
+            const float* x = tile->field[s];
+            for (int j = 1; j <= SPARSE_TILE_SIZE && !tile->live; j++) {
+                for (int i = 1; i <= SPARSE_TILE_SIZE; i++) {
+                    if (std::fabs(x[TIX(i, j)]) > threshold) {
+                        tile->live = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // retire tiles that are neither live nor part of a live tile's halo
+    std::vector<SparseTile*> retired;
+    for (SparseTile* tile : tiles) {
+        if (tile->live) {
+            continue;
+        }
+        bool halo = false;
+        for (int dj = -1; dj <= 1 && !halo; dj++) {
+            for (int di = -1; di <= 1; di++) {
+                SparseTile* other = FindTile(tile->ti + di, tile->tj + dj);
+                if (other && other->live) {
+                    halo = true;
+                    break;
+                }
+            }
+        }
+        if (!halo) {
+            retired.push_back(tile);
+        }
+    }
+    for (SparseTile* tile : retired) {
+        RetireTile(tile);
+    }
+
+    // allocate the one-tile halo around every live tile
+    size_t count = tiles.size();
+    for (size_t t = 0; t < count; t++) {
+        if (!tiles[t]->live) {
+            continue;
+        }
+        int ti = tiles[t]->ti;
+        int tj = tiles[t]->tj;
+        for (int dj = -1; dj <= 1; dj++) {
+            for (int di = -1; di <= 1; di++) {
+                FindOrCreateTile(ti + di, tj + dj);
+            }
+        }
+    }
+}
+
+void SparseGrid::RefreshGhosts(SparseTile* tile, int slot)
+{
+    const int T = SPARSE_TILE_SIZE;
+    float* x = tile->field[slot];
+    SparseTile* left = tile->neighbor[0];
+    SparseTile* right = tile->neighbor[1];
+    SparseTile* bottom = tile->neighbor[2];
+    SparseTile* top = tile->neighbor[3];
+
+    for (int k = 1; k <= T; k++) {
+        x[TIX(0, k)] = left ? left->field[slot][TIX(T, k)] : 0.0f;
+        x[TIX(T + 1, k)] = right ? right->field[slot][TIX(1, k)] : 0.0f;
+        x[TIX(k, 0)] = bottom ? bottom->field[slot][TIX(k, T)] : 0.0f;
+        x[TIX(k, T + 1)] = top ? top->field[slot][TIX(k, 1)] : 0.0f;
+    }
+}
+
+void SparseGrid::SwapBuffers(FieldType fieldType)
+{
+    for (SparseTile* tile : tiles) {
+        SWAP(tile->field[fieldType], tile->field[3 + fieldType]);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef SPARSEGRID_H
+#define SPARSEGRID_H
+
+#include "Grid.h"
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// cells per tile side (not including the ghost ring)
+#define SPARSE_TILE_SIZE 16
+// index into a tile array, ghost ring at 0 and SPARSE_TILE_SIZE + 1 like IX
+#define TIX(i, j) ((i) + (SPARSE_TILE_SIZE + 2) * (j))
+
+class SparseFluidSolver;
+
+// one block of the sparse grid, stored with a one-cell ghost ring so the
+// solver kernels can run the same stencils as on the dense Grid
+struct SparseTile {
+
+    // tile coordinates (tile (ti, tj) holds global cells ti * SPARSE_TILE_SIZE ...)
+    int ti, tj;
+
+    // position in SparseGrid::tiles for O(1) removal
+    int listIndex;
+
+    // true if any cell exceeded the activation threshold on the last update
+    bool live;
+
+    // field[DENSITY / VELOCITY_U / VELOCITY_V] = current buffers,
+    // field[3 + fieldType] = previous buffers (swapped like Grid::SwapBuffers)
+    float* field[6];
+
+    // left, right, bottom, top (nullptr = empty space, reads as zero)
+    SparseTile* neighbor[4];
+
+    float data[6 * (SPARSE_TILE_SIZE + 2) * (SPARSE_TILE_SIZE + 2)];
+};
+
+class SparseGrid {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, tiles whose |u|, |v| or dens exceed threshold stay active
+    SparseGrid(float threshold);
+
+    // destructor
+    ~SparseGrid();
+
+    // number of tiles currently allocated (active tiles plus their halo)
+    int GetTileCount() const { return static_cast<int>(tiles.size()); }
+
+    // bytes held by allocated and pooled tiles
+    size_t GetAllocatedBytes() const;
+
+    // value of a field at global cell (i, j), zero outside allocated tiles
+    float GetCell(FieldType fieldType, int i, int j) const;
+
+private:
+
+    friend class SparseFluidSolver;
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    float threshold;
+
+    // all allocated tiles, processed by every solver kernel
+    std::vector<SparseTile*> tiles;
+    // lookup from packed tile coordinates
+    std::unordered_map<long long, SparseTile*> tileMap;
+    // retired tiles kept for reuse
+    std::vector<SparseTile*> freeTiles;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    static long long Key(int ti, int tj);
+
+    SparseTile* FindTile(int ti, int tj) const;
+    SparseTile* FindOrCreateTile(int ti, int tj);
+    void RetireTile(SparseTile* tile);
+
+    // locate the tile and local index of global cell (i, j)
+    SparseTile* Locate(int i, int j, int& index) const;
+    SparseTile* LocateOrCreate(int i, int j, int& index);
+    // Locate for cells near `from`: tiles in its 3x3 neighbourhood are
+    // reached through the neighbour links, only farther ones hit the map
+    const SparseTile* LocateNear(const SparseTile* from, int i, int j, int& index) const;
+
+    // refresh live flags, retire decayed tiles and allocate the halo around live ones
+    void UpdateActiveSet();
+
+    // copy neighbour edges into the ghost ring of one field slot
+    void RefreshGhosts(SparseTile* tile, int slot);
+
+    // swap the current and previous buffers of every tile
+    void SwapBuffers(FieldType fieldType);
+};
+
+#endif // SPARSEGRID_H
@@ -0,0 +1,179 @@
+#include "StepScheduler.h"
+#include "FluidSolver.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// frames longer than this (a dragged window, a breakpoint) count as this long
+static const double MAX_FRAME_SECONDS = 0.25;
+
+StepScheduler::StepScheduler(FluidSolver* solver, double stepsPerSecond, int maxStepsPerFrame)
+    : solver(solver),
+    stepSeconds(1.0 / std::max(stepsPerSecond, 1.0)),
+    maxStepsPerFrame(std::max(maxStepsPerFrame, 1)),
+    accumulator(0.0),
+    droppedSeconds(0.0),
+    budgetMs(12.0),
+    minIterations(4),
+    maxIterations(solver->GetRelaxationIterations()),
+    iterations(solver->GetRelaxationIterations()),
+    stepMs(0.0),
+    interpolate(true),
+    havePrevious(false),
+    stepped(false)
+{
+}
+
+void StepScheduler::SetIterationRange(int minIterations, int maxIterations)
+{
+    this->minIterations = std::max(minIterations, 1);
+    this->maxIterations = std::max(maxIterations, this->minIterations);
+    iterations = std::min(std::max(iterations, this->minIterations), this->maxIterations);
+    solver->SetRelaxationIterations(iterations);
+}
+
+void StepScheduler::SetInterpolation(bool enable)
+{
+    // the blended tiles go back to showing the solver's field
+    if (!enable) {
+        for (int tile : blendTiles) {
+            solver->MarkDensityTileDirty(tile);
+        }
+        blendTiles.clear();
+        blendFlags.clear();
+        havePrevious = false;
+    }
+    interpolate = enable;
+}
+
+int StepScheduler::Advance(double seconds)
+{
+    TRACE_SCOPE("ScheduleSteps");
+
+    accumulator += std::min(std::max(seconds, 0.0), MAX_FRAME_SECONDS);
+
+    // steps owed, capped per frame and by what the budget has room for
+    int steps = static_cast<int>(accumulator / stepSeconds);
+    steps = std::min(steps, maxStepsPerFrame);
+    if (budgetMs > 0.0 && stepMs > 0.0) {
+        steps = std::min(steps, std::max(static_cast<int>(budgetMs / stepMs), 1));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        // the state before the newest step is what the display blends from
+        if (interpolate && s == steps - 1) {
+            const float* density = solver->GetDensity();
+            previous.assign(density, density + static_cast<size_t>(solver->GetNX() + 2) * (solver->GetNY() + 2));
+            if (!havePrevious) {
+                blended = previous;
+                blendFlags.assign(solver->GetDensityTileCount(), 0);
+                blendTiles.clear();
+                havePrevious = true;
+            }
+        }
+        solver->Step();
+        accumulator -= stepSeconds;
+    }
+    double frameStepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // time the cap left behind is dropped rather than carried, so one slow
+    // frame does not make the next ones slow too
+    bool capped = accumulator >= stepSeconds;
+    if (capped) {
+        double kept = std::fmod(accumulator, stepSeconds);
+        droppedSeconds += accumulator - kept;
+        accumulator = kept;
+    }
+
+    if (steps > 0) {
+        AdjustIterations(steps, frameStepMs, capped);
+        stepped = true;
+    }
+    return steps;
+}
+
+void StepScheduler::AdjustIterations(int steps, double frameStepMs, bool capped)
+{
+    double perStep = frameStepMs / steps;
+    stepMs = (stepMs > 0.0) ? 0.8 * stepMs + 0.2 * perStep : perStep;
+    if (budgetMs <= 0.0) {
+        return;
+    }
+
+    // back off quickly when over, recover slowly once well under
+    if (frameStepMs > budgetMs || capped) {
+        iterations = std::max(iterations * 3 / 4, minIterations);
+    }
+    else if (frameStepMs < 0.5 * budgetMs) {
+        iterations = std::min(iterations + 1, maxIterations);
+    }
+    solver->SetRelaxationIterations(iterations);
+}
+
+void StepScheduler::AddBlendTiles()
+{
+    const int* dirty = solver->GetDirtyTiles();
+    for (int d = 0; d < solver->GetDirtyTileCount(); d++) {
+        if (!blendFlags[dirty[d]]) {
+            blendFlags[dirty[d]] = 1;
+            blendTiles.push_back(dirty[d]);
+        }
+    }
+}
+
+void StepScheduler::TileRange(int tile, int& i0, int& i1, int& j0, int& j1) const
+{
+    // tiles at the edge take the boundary ring with them
+    solver->GetDensityTileBounds(tile, i0, i1, j0, j1);
+    if (i0 == 1) i0 = 0;
+    if (j0 == 1) j0 = 0;
+    if (i1 == solver->GetNX()) i1 = solver->GetNX() + 1;
+    if (j1 == solver->GetNY()) j1 = solver->GetNY() + 1;
+}
+
+const float* StepScheduler::GetDisplayDensity()
+{
+    if (!interpolate || !havePrevious) {
+        return solver->GetDensity();
+    }
+
+    TRACE_SCOPE("BlendDensity");
+
+    // the tiles changed since the last frame, by this frame's steps or by
+    // input, which shows up faded in with the next step
+    const int* dirty = solver->GetDirtyTiles();
+    changedTiles.assign(dirty, dirty + solver->GetDirtyTileCount());
+    AddBlendTiles();
+
+    const float* current = solver->GetDensity();
+    float alpha = static_cast<float>(GetAlpha());
+    int W = solver->GetNX() + 2;
+    int i0, i1, j0, j1;
+    for (int tile : blendTiles) {
+        TileRange(tile, i0, i1, j0, j1);
+        for (int j = j0; j <= j1; j++) {
+            size_t row = static_cast<size_t>(j) * W;
+            for (int i = i0; i <= i1; i++) {
+                blended[row + i] = previous[row + i] + alpha * (current[row + i] - previous[row + i]);
+            }
+        }
+        solver->MarkDensityTileDirty(tile);
+    }
+
+    // after a step previous matches the field outside the changed tiles, so
+    // the rest of the old set has just been blended to its final value
+    if (stepped) {
+        for (int tile : blendTiles) {
+            blendFlags[tile] = 0;
+        }
+        blendTiles.clear();
+        for (int tile : changedTiles) {
+            blendFlags[tile] = 1;
+            blendTiles.push_back(tile);
+        }
+        stepped = false;
+    }
+    return blended.data();
+}
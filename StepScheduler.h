@@ -0,0 +1,89 @@
+#ifndef STEPSCHEDULER_H
+#define STEPSCHEDULER_H
+
+#include <vector>
+
+class FluidSolver;
+
+// runs a solver at a fixed simulation rate, independent of the display
+// rate. each frame's wall time goes into an accumulator that is drained in
+// whole steps, at most maxStepsPerFrame of them, and whatever is left over
+// after the cap is dropped so a slow machine runs the simulation slower
+// instead of falling further behind. when the steps of a frame overrun the
+// budget the relaxation iterations are lowered, and raised again once there
+// is room.
+//
+// the displayed density is blended between the last two steps by the
+// fraction of a step still in the accumulator, so motion stays smooth when
+// the display runs faster than the simulation
+class StepScheduler {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor
+    StepScheduler(FluidSolver* solver, double stepsPerSecond = 60.0, int maxStepsPerFrame = 4);
+
+    // advance by a frame's wall time, returns the steps taken
+    int Advance(double seconds);
+
+    // density to display this frame, (NX + 2) x (NY + 2). the solver's own
+    // field unless interpolating. tiles whose blend changed are marked dirty
+    const float* GetDisplayDensity();
+
+    // milliseconds of step time allowed per frame
+    void SetBudget(double budgetMs) { this->budgetMs = budgetMs > 0.0 ? budgetMs : 0.0; }
+    // range the relaxation iterations are kept in, max is used while under budget
+    void SetIterationRange(int minIterations, int maxIterations);
+    void SetInterpolation(bool enable);
+
+    double GetStepsPerSecond() const { return 1.0 / stepSeconds; }
+    // fraction of a step in the accumulator, the blend weight of the newest state
+    double GetAlpha() const { return accumulator / stepSeconds; }
+    int GetIterations() const { return iterations; }
+    // wall time given up to the step cap since construction
+    double GetDroppedSeconds() const { return droppedSeconds; }
+    // average wall time of one step
+    double GetStepMs() const { return stepMs; }
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    FluidSolver* solver;
+    double stepSeconds;
+    int maxStepsPerFrame;
+    double accumulator;
+    double droppedSeconds;
+
+    double budgetMs;
+    int minIterations, maxIterations;
+    int iterations;
+    double stepMs;
+
+    // density before and after the newest step, blended for display.
+    // blendTiles are the tiles that may differ between them
+    bool interpolate;
+    bool havePrevious;
+    bool stepped;
+    std::vector<float> previous;
+    std::vector<float> blended;
+    std::vector<int> blendTiles;
+    std::vector<int> changedTiles;
+    std::vector<unsigned char> blendFlags;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void AdjustIterations(int steps, double frameStepMs, bool capped);
+    void AddBlendTiles();
+    void TileRange(int tile, int& i0, int& i1, int& j0, int& j1) const;
+};
+
+#endif // STEPSCHEDULER_H
@@ -0,0 +1,78 @@
+#ifndef TESTHELPERS_H
+#define TESTHELPERS_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// shared by the ctest programs. each test is a bool function built from
+// CHECK, which reports the failed condition and returns false, and main
+// exits non-zero on the first failure
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            return false; \
+        } \
+    } while (0)
+
+static inline bool BitEqual(const float* a, const float* b, size_t count)
+{
+    return std::memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+static inline bool BitEqual(const std::vector<float>& a, const std::vector<float>& b)
+{
+    return a.size() == b.size() && BitEqual(a.data(), b.data(), a.size());
+}
+
+// scratch files go to the directory given as the first argument, ctest
+// passes the build directory, or else to the working directory
+static inline std::string ScratchPath(int argc, char** argv, const char* name)
+{
+    return (argc > 1) ? std::string(argv[1]) + "/" + name : std::string(name);
+}
+
+static inline std::vector<unsigned char> ReadFile(const std::string& path)
+{
+    std::vector<unsigned char> bytes;
+    FILE* in = std::fopen(path.c_str(), "rb");
+    if (in) {
+        unsigned char chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0) {
+            bytes.insert(bytes.end(), chunk, chunk + n);
+        }
+        std::fclose(in);
+    }
+    return bytes;
+}
+
+// write the first `count` bytes
+static inline bool WriteFile(const std::string& path, const std::vector<unsigned char>& bytes, size_t count)
+{
+    FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, count, out) == count;
+    return std::fclose(out) == 0 && ok;
+}
+
+// a copy with one byte in [from, to) flipped. readers may decode such
+// payloads to other values but must never crash on them
+static inline std::vector<unsigned char> FlipByte(const std::vector<unsigned char>& bytes, size_t from, size_t to,
+    std::mt19937& random)
+{
+    std::vector<unsigned char> broken = bytes;
+    size_t at = from + random() % (to - from);
+    broken[at] ^= static_cast<unsigned char>(1 + random() % 255);
+    return broken;
+}
+
+#endif // TESTHELPERS_H
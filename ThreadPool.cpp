@@ -0,0 +1,133 @@
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+// constructor
+ThreadPool::ThreadPool(int numThreads)
+{
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    stats = new ThreadStats[numThreads];
+    for (int t = 1; t < numThreads; t++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, t);
+    }
+}
+
+// destructor
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    delete[] stats;
+}
+
+double ThreadPool::GetBusyMs(int thread) const
+{
+    return stats[thread].busyNs.load(std::memory_order_relaxed) * 1e-6;
+}
+
+void ThreadPool::ResetBusyTime()
+{
+    for (int t = 0; t < GetThreadCount(); t++) {
+        stats[t].busyNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::RunChunks(const std::function<void(int, int)>& fn, int count, int grain, int thread)
+{
+    TRACE_SCOPE("ParallelFor");
+
+    using clock = std::chrono::steady_clock;
+    long long busy = 0;
+
+    for (;;) {
+        int begin = next.fetch_add(grain);
+        if (begin >= count) {
+            break;
+        }
+        auto start = clock::now();
+        fn(begin, std::min(begin + grain, count));
+        busy += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    }
+
+    stats[thread].busyNs.fetch_add(busy, std::memory_order_relaxed);
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int, int)>& fn, int grain)
+{
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(grain, 1);
+
+    // nothing to share
+    if (workers.empty() || count <= grain) {
+        next.store(0);
+        RunChunks(fn, count, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        next.store(0);
+        busyWorkers = static_cast<int>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    // the caller works too
+    RunChunks(fn, count, grain, 0);
+
+    // wait for the workers to leave the loop before fn goes out of scope
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int thread)
+{
+#ifdef FLUIDSIM_TRACE
+    std::string name = "worker " + std::to_string(thread);
+    TRACE_THREAD_NAME(name.c_str());
+#endif
+
+    unsigned long long seen = 0;
+
+    for (;;) {
+        const std::function<void(int, int)>* fn;
+        int count, grain;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            fn = job;
+            count = jobCount;
+            grain = jobGrain;
+        }
+
+        RunChunks(*fn, count, grain, thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                done.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for data-parallel loops. the calling thread
+// takes part in every loop, so a pool of n threads runs n - 1 workers.
+class ThreadPool {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, numThreads <= 0 uses the hardware concurrency
+    ThreadPool(int numThreads = 0);
+
+    // destructor
+    ~ThreadPool();
+
+    int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    // run fn(begin, end) over [0, count) in chunks of `grain` items and
+    // return once every chunk has finished. one loop runs at a time, so
+    // fn must not call back into the same pool
+    void ParallelFor(int count, const std::function<void(int, int)>& fn, int grain = 1);
+
+    // time spent inside loop bodies since construction or the last reset,
+    // thread 0 is the caller
+    double GetBusyMs(int thread) const;
+    void ResetBusyTime();
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    std::vector<std::thread> workers;
+
+    // busy time per thread, each written only by its own thread
+    struct alignas(64) ThreadStats {
+        std::atomic<long long> busyNs{ 0 };
+    };
+    ThreadStats* stats;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // current loop, published under the mutex and bumped by generation
+    const std::function<void(int, int)>* job = nullptr;
+    int jobCount = 0;
+    int jobGrain = 1;
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    // next chunk start and number of workers still inside the loop
+    std::atomic<int> next{ 0 };
+    int busyWorkers = 0;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void WorkerLoop(int thread);
+    void RunChunks(const std::function<void(int, int)>& fn, int count, int grain, int thread);
+};
+
+#endif // THREADPOOL_H
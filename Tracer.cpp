@@ -0,0 +1,176 @@
+#include "Tracer.h"
+
+#ifdef FLUIDSIM_TRACE
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    long long begin;
+    long long end;
+};
+
+// single-writer ring owned by one thread. head only grows, so the exporter
+// reads the last min(head, TRACE_RING_SIZE) events
+struct ThreadRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    std::atomic<unsigned long long> head{ 0 };
+    int tid = 0;
+    std::string name;
+};
+
+// the events of a thread, in order, kept once its ring is freed
+struct ThreadEvents {
+    int tid;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+std::mutex registryMutex;
+// rings of running threads
+std::vector<ThreadRing*> registry;
+// events of finished threads, until export or Clear
+std::vector<ThreadEvents> finished;
+int nextTid = 0;
+
+// call with registryMutex held
+ThreadEvents CopyEvents(const ThreadRing* ring)
+{
+    ThreadEvents copy = { ring->tid, ring->name, {} };
+    unsigned long long head = ring->head.load(std::memory_order_acquire);
+    unsigned long long start = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+    copy.events.reserve(static_cast<size_t>(head - start));
+    for (unsigned long long e = start; e < head; e++) {
+        copy.events.push_back(ring->events[e % TRACE_RING_SIZE]);
+    }
+    return copy;
+}
+
+// owns the calling thread's ring, which is only allocated once the thread
+// records with tracing enabled. at thread exit the recorded events move to
+// `finished` and the ring is freed
+struct LocalOwner {
+    ThreadRing* ring = nullptr;
+    std::string name;
+
+    ~LocalOwner()
+    {
+        if (!ring) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.erase(std::find(registry.begin(), registry.end(), ring));
+        if (ring->head.load(std::memory_order_relaxed) > 0) {
+            finished.push_back(CopyEvents(ring));
+        }
+        delete ring;
+    }
+};
+
+thread_local LocalOwner owner;
+
+ThreadRing* LocalRing()
+{
+    if (!owner.ring) {
+        ThreadRing* ring = new ThreadRing();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ring->tid = nextTid++;
+        ring->name = owner.name;
+        registry.push_back(ring);
+        owner.ring = ring;
+    }
+    return owner.ring;
+}
+
+// names come from string literals in this code base, escape anyway
+void WriteEscaped(FILE* out, const char* s)
+{
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            std::fputc('\\', out);
+        }
+        std::fputc(*s, out);
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::enabled{ false };
+
+void Tracer::Record(const char* name, long long begin, long long end)
+{
+    // threads that never record while tracing is on never get a ring
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadRing* ring = LocalRing();
+    unsigned long long h = ring->head.load(std::memory_order_relaxed);
+    ring->events[h % TRACE_RING_SIZE] = { name, begin, end };
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+void Tracer::SetThreadName(const char* name)
+{
+    // kept for the ring this thread may allocate later
+    owner.name = name;
+    if (owner.ring) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        owner.ring->name = name;
+    }
+}
+
+void Tracer::Clear()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (ThreadRing* ring : registry) {
+        ring->head.store(0, std::memory_order_release);
+    }
+    finished.clear();
+}
+
+bool Tracer::WriteChromeJson(const char* path)
+{
+    FILE* out = std::fopen(path, "w");
+    if (!out) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<ThreadEvents> threads = finished;
+    for (const ThreadRing* ring : registry) {
+        threads.push_back(CopyEvents(ring));
+    }
+
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (const ThreadEvents& thread : threads) {
+        if (!thread.name.empty()) {
+            std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+                first ? "" : ",\n", thread.tid);
+            WriteEscaped(out, thread.name.c_str());
+            std::fprintf(out, "\"}}");
+            first = false;
+        }
+
+        for (const TraceEvent& ev : thread.events) {
+            std::fprintf(out, "%s{\"name\":\"", first ? "" : ",\n");
+            WriteEscaped(out, ev.name);
+            std::fprintf(out, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                thread.tid, ev.begin * 1e-3, (ev.end - ev.begin) * 1e-3);
+            first = false;
+        }
+    }
+
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+    return true;
+}
+
+#endif // FLUIDSIM_TRACE
@@ -0,0 +1,90 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+// opt-in timeline tracing exported as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev). build with FLUIDSIM_TRACE defined to compile it in;
+// without it the TRACE_* macros expand to nothing.
+
+#ifdef FLUIDSIM_TRACE
+
+#include <atomic>
+#include <chrono>
+
+// events kept per thread, older events are overwritten
+#define TRACE_RING_SIZE (1 << 16)
+
+class Tracer {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // recording is off until enabled at run time
+    static void SetEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+    static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // ns since the first use of the tracer
+    static long long Now()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // append a complete event to the calling thread's ring. name must
+    // outlive the tracer (a string literal)
+    static void Record(const char* name, long long begin, long long end);
+
+    // label the calling thread in the exported timeline
+    static void SetThreadName(const char* name);
+
+    // write every ring as Chrome trace JSON. call while no thread is
+    // recording (e.g. between steps) so rings are not overwritten mid-export
+    static bool WriteChromeJson(const char* path);
+
+    // drop recorded events
+    static void Clear();
+
+private:
+
+    static std::atomic<bool> enabled;
+};
+
+// records the lifetime of a scope as one event
+class TraceScope {
+
+public:
+
+    explicit TraceScope(const char* name) : name(name), begin(Tracer::IsEnabled() ? Tracer::Now() : -1) {}
+
+    ~TraceScope()
+    {
+        if (begin >= 0) {
+            Tracer::Record(name, begin, Tracer::Now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+
+    const char* name;
+    long long begin;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::SetThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+
+#endif // FLUIDSIM_TRACE
+
+#endif // TRACER_H
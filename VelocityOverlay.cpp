@@ -0,0 +1,193 @@
+#include "VelocityOverlay.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cmath>
+
+// ==================================================
+// SAMPLING
+// ==================================================
+
+void SampleVelocity(const VelocityField& field, float x, float y, float& u, float& v)
+{
+    // velocity cell i covers density cells (i - 1) * scale + 1 .. i * scale,
+    // so its centre sits at 1 + (i - 0.5) * scale
+    float gx = (x - 1.0f) / field.scale + 0.5f;
+    float gy = (y - 1.0f) / field.scale + 0.5f;
+    gx = std::min(std::max(gx, 0.0f), static_cast<float>(field.nx + 1));
+    gy = std::min(std::max(gy, 0.0f), static_cast<float>(field.ny + 1));
+
+    int i0 = std::min(static_cast<int>(gx), field.nx);
+    int j0 = std::min(static_cast<int>(gy), field.ny);
+    float s1 = gx - i0, s0 = 1.0f - s1;
+    float t1 = gy - j0, t0 = 1.0f - t1;
+
+    int stride = field.nx + 2;
+    int k = i0 + stride * j0;
+    u = s0 * (t0 * field.u[k] + t1 * field.u[k + stride]) + s1 * (t0 * field.u[k + 1] + t1 * field.u[k + stride + 1]);
+    v = s0 * (t0 * field.v[k] + t1 * field.v[k + stride]) + s1 * (t0 * field.v[k + 1] + t1 * field.v[k + stride + 1]);
+}
+
+float SampleVelocityGlyphs(const VelocityField& field, const FieldView& view, int columns, int rows,
+    std::vector<float>& glyphs)
+{
+    float maxSpeed = 0.0f;
+    for (int r = 0; r < rows; r++) {
+        float y = view.y0 + (r + 0.5f) / rows * (view.y1 - view.y0);
+        for (int c = 0; c < columns; c++) {
+            float x = view.x0 + (c + 0.5f) / columns * (view.x1 - view.x0);
+            float u, v;
+            SampleVelocity(field, x, y, u, v);
+            glyphs.push_back(x);
+            glyphs.push_back(y);
+            glyphs.push_back(u);
+            glyphs.push_back(v);
+            maxSpeed = std::max(maxSpeed, std::sqrt(u * u + v * v));
+        }
+    }
+    return maxSpeed;
+}
+
+// ==================================================
+// STREAMLINES
+// ==================================================
+
+StreamlineTracer::StreamlineTracer(float seedSpacing, int maxSeeds)
+    : seedSpacing(std::max(seedSpacing, 1.0f)), maxSeeds(std::max(maxSeeds, 1))
+{
+    worker = std::thread(&StreamlineTracer::TracerLoop, this);
+}
+
+StreamlineTracer::~StreamlineTracer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+bool StreamlineTracer::Submit(const VelocityField& field)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (busy) {
+        return false;
+    }
+
+    TRACE_SCOPE("SubmitStreamlines");
+    size_t count = static_cast<size_t>(field.nx + 2) * (field.ny + 2);
+    inputU.assign(field.u, field.u + count);
+    inputV.assign(field.v, field.v + count);
+    input = { inputU.data(), inputV.data(), field.nx, field.ny, field.scale };
+    busy = true;
+    wake.notify_one();
+    return true;
+}
+
+bool StreamlineTracer::TakeLines(std::vector<float>& lines)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!outputReady) {
+        return false;
+    }
+    lines.swap(output);
+    outputReady = false;
+    return true;
+}
+
+void StreamlineTracer::TracerLoop()
+{
+    TRACE_THREAD_NAME("streamlines");
+
+    std::vector<float> traced;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return busy || stopping; });
+        if (!busy) {
+            break;
+        }
+
+        // the input is left alone while busy, so it is read unlocked
+        VelocityField field = input;
+        lock.unlock();
+        Trace(field, seedSpacing, maxSeeds, traced);
+        lock.lock();
+
+        output.swap(traced);
+        outputReady = true;
+        busy = false;
+    }
+}
+
+void StreamlineTracer::Trace(const VelocityField& field, float seedSpacing, int maxSeeds, std::vector<float>& lines)
+{
+    TRACE_SCOPE("TraceStreamlines");
+
+    lines.clear();
+
+    int stride = field.nx + 2;
+    float maxSpeed = 0.0f;
+    for (int j = 1; j <= field.ny; j++) {
+        for (int i = 1; i <= field.nx; i++) {
+            int k = i + stride * j;
+            maxSpeed = std::max(maxSpeed, field.u[k] * field.u[k] + field.v[k] * field.v[k]);
+        }
+    }
+    maxSpeed = std::sqrt(maxSpeed);
+    if (!(maxSpeed > 0.0f)) {
+        return;
+    }
+    // lines end where the flow is this much slower than the fastest point
+    float stopSpeed = maxSpeed * 1e-3f;
+
+    float width = static_cast<float>(field.nx * field.scale);
+    float height = static_cast<float>(field.ny * field.scale);
+    int seedsX = std::min(std::max(static_cast<int>(width / seedSpacing), 1), maxSeeds);
+    int seedsY = std::min(std::max(static_cast<int>(height / seedSpacing), 1), maxSeeds);
+
+    // each half of a line reaches about four seed spacings
+    const int maxSteps = 16;
+    float step = 0.25f * std::min(width / seedsX, height / seedsY);
+
+    for (int sy = 0; sy < seedsY; sy++) {
+        for (int sx = 0; sx < seedsX; sx++) {
+            float seedX = 1.0f + (sx + 0.5f) * width / seedsX;
+            float seedY = 1.0f + (sy + 0.5f) * height / seedsY;
+
+            for (int dir = -1; dir <= 1; dir += 2) {
+                float x = seedX, y = seedY;
+                for (int s = 0; s < maxSteps; s++) {
+                    float u, v;
+                    SampleVelocity(field, x, y, u, v);
+                    float speed = std::sqrt(u * u + v * v);
+                    if (!(speed > stopSpeed)) {
+                        break;
+                    }
+
+                    // midpoint step along the unit direction
+                    float half = 0.5f * step * dir / speed;
+                    float um, vm;
+                    SampleVelocity(field, x + half * u, y + half * v, um, vm);
+                    float speedMid = std::sqrt(um * um + vm * vm);
+                    if (!(speedMid > stopSpeed)) {
+                        break;
+                    }
+                    float nextX = x + step * dir * um / speedMid;
+                    float nextY = y + step * dir * vm / speedMid;
+                    if (nextX < 1.0f || nextX > 1.0f + width || nextY < 1.0f || nextY > 1.0f + height) {
+                        break;
+                    }
+
+                    lines.push_back(x);
+                    lines.push_back(y);
+                    lines.push_back(speed / maxSpeed);
+                    lines.push_back(nextX);
+                    lines.push_back(nextY);
+                    lines.push_back(speedMid / maxSpeed);
+                    x = nextX;
+                    y = nextY;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef VELOCITYOVERLAY_H
+#define VELOCITYOVERLAY_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DisplayDownsample.h"
+
+// a velocity field as the solver stores it: (nx + 2) x (ny + 2) cells,
+// each covering scale x scale density cells
+struct VelocityField {
+    const float* u;
+    const float* v;
+    int nx, ny;
+    int scale;
+};
+
+// bilinear velocity at a point in density cell units (the coordinates of
+// FieldView), clamped to the boundary ring
+void SampleVelocity(const VelocityField& field, float x, float y, float& u, float& v);
+
+// sample columns x rows evenly spaced points of the view and append one
+// arrow per point as x, y, u, v to glyphs. returns the largest speed seen
+float SampleVelocityGlyphs(const VelocityField& field, const FieldView& view, int columns, int rows,
+    std::vector<float>& glyphs);
+
+// traces streamlines of the latest submitted velocity field on its own
+// thread. Submit copies the field only when the tracer is ready for a new
+// one, so the render loop never waits on it; finished lines are picked up
+// with TakeLines whenever they are ready.
+//
+// lines start on a regular grid of seeds and run forward and backward with
+// midpoint steps along the flow direction until they leave the domain or
+// reach still fluid. they come out as GL_LINES vertices of x, y, speed
+// with speed relative to the fastest point of the field.
+class StreamlineTracer {
+
+public:
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    // constructor, starts the tracer thread. seeds are seedSpacing density
+    // cells apart, at most maxSeeds along either axis
+    StreamlineTracer(float seedSpacing = 8.0f, int maxSeeds = 64);
+
+    // destructor, stops the thread once the current field is traced
+    ~StreamlineTracer();
+
+    // hand over a field to trace, false (and nothing copied) while the
+    // tracer is still busy with the last one
+    bool Submit(const VelocityField& field);
+
+    // swap in the newest finished lines, false if there are none since the
+    // last call
+    bool TakeLines(std::vector<float>& lines);
+
+    // traces one field on the calling thread
+    static void Trace(const VelocityField& field, float seedSpacing, int maxSeeds, std::vector<float>& lines);
+
+private:
+
+    // ==================================================
+    // VARIABLES
+    // ==================================================
+
+    float seedSpacing;
+    int maxSeeds;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // copy of the submitted field, owned by the tracer while busy
+    std::vector<float> inputU, inputV;
+    VelocityField input = {};
+    bool busy = false;
+
+    // finished lines waiting for TakeLines
+    std::vector<float> output;
+    bool outputReady = false;
+
+    std::thread worker;
+
+    // ==================================================
+    // FUNCTIONS
+    // ==================================================
+
+    void TracerLoop();
+};
+
+#endif // VELOCITYOVERLAY_H
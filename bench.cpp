@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EnsembleBatch.h"
+#include "FluidSolver.h"
+#include "FluidSolver3D.h"
+
+// phase microbenchmarks for the dense 2D and threaded 3D solvers.
+// every phase is timed in isolation on a seeded field and reported as
+// ns/cell, cells/s and an estimate of the memory bandwidth it achieves.
+// ensembles of small solvers are timed per step of the whole batch.
+
+// estimated bytes moved per cell by one call of each phase: the stencil
+// neighbours come from cache, so a relaxation sweep streams x0 and x in
+// and x out (12 B), advection gathers three inputs and writes one (16 B),
+// the divergence pass reads u, v and writes div, p (16 B) and the gradient
+// pass reads p and updates u, v (20 B)
+static const double RELAX_BYTES = 12.0;
+static const double ADVECT_BYTES = 16.0;
+static const double DIVERGENCE_BYTES = 16.0;
+static const double GRADIENT_BYTES = 20.0;
+static const int ITERS = 20;
+
+// same model for the 3D kernels (three velocity components)
+static const double ADVECT3D_BYTES = 20.0;
+static const double DIVERGENCE3D_BYTES = 20.0;
+static const double GRADIENT3D_BYTES = 28.0;
+
+struct BenchResult {
+    std::string solver;
+    std::string mode;
+    std::string phase;
+    int nx, ny, nz;
+    int threads;
+    double cells;
+    double bytes;
+    double msPerCall;
+    int reps;
+};
+
+struct BenchOptions {
+    std::vector<int> sizes = { 64, 128, 256, 512, 1024, 2048, 4096 };
+    std::vector<int> sizes3D = { 32, 64 };
+    std::vector<int> threads;
+    std::vector<int> ensembleSizes = { 128 };
+    int ensembleMembers = 64;
+    double minMs = 200.0;
+    const char* jsonPath = nullptr;
+};
+
+// median wall time of fn in ms over at least minMs of repetitions
+template <typename F>
+static double TimeMedian(F fn, double minMs, int& reps)
+{
+    using clock = std::chrono::steady_clock;
+
+    // warm caches and page in the arrays
+    fn();
+
+    std::vector<double> samples;
+    double total = 0.0;
+    while (total < minMs || samples.size() < 3) {
+        auto start = clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        samples.push_back(ms);
+        total += ms;
+        if (samples.size() >= 10000) {
+            break;
+        }
+    }
+
+    reps = static_cast<int>(samples.size());
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+class SolverBench {
+
+public:
+
+    static void Run2D(const BenchOptions& opt, std::vector<BenchResult>& results);
+    static void Run3D(const BenchOptions& opt, std::vector<BenchResult>& results);
+    static void RunEnsemble(const BenchOptions& opt, std::vector<BenchResult>& results);
+
+private:
+
+    static void Seed2D(FluidSolver& s, int nx, int ny);
+    static void Seed3D(FluidSolver3D& s, int n);
+};
+
+// smooth nonzero fields everywhere (or in one corner patch) so the
+// activity mask sees the intended active area
+void SolverBench::Seed2D(FluidSolver& s, int nx, int ny)
+{
+    for (int j = 1; j <= ny; j++) {
+        for (int i = 1; i <= nx; i++) {
+            float x = static_cast<float>(i) / nx;
+            float y = static_cast<float>(j) / ny;
+            s.AddInputToField(DENSITY, i, j, 1.0f + std::sin(6.0f * x) * std::cos(4.0f * y));
+            s.AddInputToField(VELOCITY_U, i, j, 0.01f * std::sin(3.0f * y));
+            s.AddInputToField(VELOCITY_V, i, j, 0.01f * std::cos(5.0f * x));
+        }
+    }
+}
+
+void SolverBench::Seed3D(FluidSolver3D& s, int n)
+{
+    for (int k = 1; k <= n; k++) {
+        for (int j = 1; j <= n; j++) {
+            for (int i = 1; i <= n; i++) {
+                float x = static_cast<float>(i) / n;
+                float y = static_cast<float>(j) / n;
+                float z = static_cast<float>(k) / n;
+                s.AddInputToField(DENSITY, i, j, k, 1.0f + std::sin(6.0f * x) * std::cos(4.0f * y));
+                s.AddInputToField(VELOCITY_U, i, j, k, 0.01f * std::sin(3.0f * z));
+                s.AddInputToField(VELOCITY_V, i, j, k, 0.01f * std::cos(5.0f * x));
+                s.AddInputToField(VELOCITY_W, i, j, k, 0.01f * std::sin(2.0f * y));
+            }
+        }
+    }
+}
+
+void SolverBench::Run2D(const BenchOptions& opt, std::vector<BenchResult>& results)
+{
+    // full sweeps, split-resolution velocity, and the activity mask on a
+    // plume covering 1/16 of the domain
+    struct Mode { const char* name; int velocityScale; bool mask; bool patch; };
+    const Mode modes[] = {
+        { "dense", 1, false, false },
+        { "split2", 2, false, false },
+        { "masked_patch", 1, true, true },
+    };
+
+    for (int n : opt.sizes) {
+        for (const Mode& mode : modes) {
+            FluidSolver s(n, n, BoundaryCondition::DIRICHLET, mode.velocityScale);
+            s.SetActivityMaskEnabled(mode.mask);
+            if (mode.patch) {
+                for (int j = 1; j <= n / 4; j++) {
+                    for (int i = 1; i <= n / 4; i++) {
+                        s.AddInputToField(DENSITY, i, j, 1.0f);
+                        s.AddInputToField(VELOCITY_U, i, j, 0.01f);
+                    }
+                }
+            }
+            else {
+                Seed2D(s, n, n);
+            }
+            s.UpdateActivity();
+
+            int nv = s.GetVelocityNX();
+            double cells = static_cast<double>(n) * n;
+            double cellsV = static_cast<double>(nv) * nv;
+            double boundary = 4.0 * n + 4.0;
+            double projectBytes = cellsV * (DIVERGENCE_BYTES + ITERS * RELAX_BYTES + GRADIENT_BYTES);
+            double stepBytes = 2 * 2 * cellsV * ITERS * RELAX_BYTES + 2 * projectBytes +
+                2 * cellsV * ADVECT_BYTES + cells * (ITERS * RELAX_BYTES + ADVECT_BYTES);
+
+            struct Phase { const char* name; double cells; double bytes; };
+            const Phase phases[] = {
+                { "SetBoundary", boundary, boundary * sizeof(float) },
+                { "Diffuse", cells, cells * ITERS * RELAX_BYTES },
+                { "Advect", cells, cells * ADVECT_BYTES },
+                { "Project", cellsV, projectBytes },
+                { "Step", cells, stepBytes },
+            };
+
+            for (const Phase& phase : phases) {
+                std::string name = phase.name;
+                int reps = 0;
+                double ms = TimeMedian([&]() {
+                    if (name == "SetBoundary") s.SetBoundary(DENSITY);
+                    else if (name == "Diffuse") s.Diffuse(DENSITY);
+                    else if (name == "Advect") s.Advect(DENSITY);
+                    else if (name == "Project") s.Project();
+                    else s.Step();
+                }, opt.minMs, reps);
+
+                results.push_back({ "FluidSolver", mode.name, name, n, n, 1, 1,
+                    phase.cells, phase.bytes, ms, reps });
+            }
+        }
+    }
+}
+
+void SolverBench::Run3D(const BenchOptions& opt, std::vector<BenchResult>& results)
+{
+    for (int n : opt.sizes3D) {
+        for (int threads : opt.threads) {
+            FluidSolver3D s(n, BoundaryCondition::DIRICHLET, threads);
+            Seed3D(s, n);
+
+            double cells = static_cast<double>(n) * n * n;
+            double projectBytes = cells * (DIVERGENCE3D_BYTES + ITERS * RELAX_BYTES + GRADIENT3D_BYTES);
+            double stepBytes = 4 * cells * ITERS * RELAX_BYTES + 2 * projectBytes +
+                3 * cells * ADVECT3D_BYTES + cells * ADVECT_BYTES;
+
+            struct Phase { const char* name; double bytes; };
+            const Phase phases[] = {
+                { "Diffuse", cells * ITERS * RELAX_BYTES },
+                { "Advect", cells * ADVECT_BYTES },
+                { "Project", projectBytes },
+                { "Step", stepBytes },
+            };
+
+            for (const Phase& phase : phases) {
+                std::string name = phase.name;
+                int reps = 0;
+                double ms = TimeMedian([&]() {
+                    if (name == "Diffuse") s.Diffuse(DENSITY);
+                    else if (name == "Advect") s.Advect(DENSITY);
+                    else if (name == "Project") s.Project();
+                    else s.Step();
+                }, opt.minMs, reps);
+
+                results.push_back({ "FluidSolver3D", "red_black", name, n, n, n, s.GetThreadCount(),
+                    cells, phase.bytes, ms, reps });
+            }
+        }
+    }
+}
+
+void SolverBench::RunEnsemble(const BenchOptions& opt, std::vector<BenchResult>& results)
+{
+    // members differ in diffusion, as in a parameter sweep. serial steps
+    // them one after another like a process per member on one core would,
+    // batch spreads whole members over the pool and interleaved packs them
+    // four to a vector
+    struct Mode { const char* name; bool pooled; bool interleaved; };
+    const Mode modes[] = {
+        { "serial", false, false },
+        { "batch", true, false },
+        { "interleaved", true, true },
+    };
+
+    for (int n : opt.ensembleSizes) {
+        double cells = static_cast<double>(n) * n * opt.ensembleMembers;
+        double stepBytes = cells * (5 * ITERS * RELAX_BYTES + 2 * (DIVERGENCE_BYTES + GRADIENT_BYTES) + 3 * ADVECT_BYTES);
+
+        for (const Mode& mode : modes) {
+            const std::vector<int> serialThreads = { 1 };
+            for (int threads : mode.pooled ? opt.threads : serialThreads) {
+                std::vector<FluidSolver*> members;
+                EnsembleBatch batch(threads, mode.interleaved);
+                for (int m = 0; m < opt.ensembleMembers; m++) {
+                    FluidSolver* s = new FluidSolver(n, n, BoundaryCondition::DIRICHLET);
+                    s->SetActivityMaskEnabled(false);
+                    s->SetDiffusion(0.0001f * (1.0f + m * 0.1f));
+                    Seed2D(*s, n, n);
+                    members.push_back(s);
+                    batch.Add(s);
+                }
+
+                int reps = 0;
+                double ms = TimeMedian([&]() {
+                    if (mode.pooled) {
+                        batch.Step();
+                    }
+                    else {
+                        for (FluidSolver* s : members) {
+                            s->Step();
+                        }
+                    }
+                }, opt.minMs, reps);
+
+                results.push_back({ "EnsembleBatch", mode.name, "Step", n, n, 1, threads,
+                    cells, stepBytes, ms, reps });
+
+                for (FluidSolver* s : members) {
+                    delete s;
+                }
+            }
+        }
+    }
+}
+
+static std::vector<int> ParseList(const char* arg)
+{
+    std::vector<int> values;
+    for (const char* p = arg; *p; ) {
+        values.push_back(std::atoi(p));
+        p = std::strchr(p, ',');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+    return values;
+}
+
+static void WriteJson(const char* path, const std::vector<BenchResult>& results)
+{
+    FILE* out = std::fopen(path, "w");
+    if (!out) {
+        std::fprintf(stderr, "Error: cannot open %s\n", path);
+        return;
+    }
+
+    std::fprintf(out, "{\n  \"benchmark\": \"fluidsim\",\n  \"hardware_threads\": %u,\n  \"results\": [\n",
+        std::thread::hardware_concurrency());
+    for (size_t r = 0; r < results.size(); r++) {
+        const BenchResult& b = results[r];
+        double seconds = b.msPerCall * 1e-3;
+        std::fprintf(out,
+            "    { \"solver\": \"%s\", \"mode\": \"%s\", \"phase\": \"%s\", \"nx\": %d, \"ny\": %d, \"nz\": %d, "
+            "\"threads\": %d, \"reps\": %d, \"ms_per_call\": %.6f, \"ns_per_cell\": %.4f, "
+            "\"cells_per_s\": %.6e, \"gb_per_s\": %.4f }%s\n",
+            b.solver.c_str(), b.mode.c_str(), b.phase.c_str(), b.nx, b.ny, b.nz, b.threads, b.reps,
+            b.msPerCall, seconds * 1e9 / b.cells, b.cells / seconds, b.bytes / seconds * 1e-9,
+            r + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    std::fclose(out);
+}
+
+static void PrintUsage(const char* exe)
+{
+    std::printf("usage: %s [--sizes 64,128,...] [--sizes3d 32,64] [--threads 1,2,4]"
+        " [--ensemble-sizes 128,256] [--ensemble-members n] [--min-time ms] [--json file] [--no-3d]"
+        " [--no-ensemble]\n", exe);
+}
+
+int main(int argc, char** argv) {
+
+    BenchOptions opt;
+    bool run3D = true;
+    bool runEnsemble = true;
+
+    // 1, 2, 4, ... up to the hardware concurrency
+    int hw = std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 1; t < hw; t *= 2) {
+        opt.threads.push_back(t);
+    }
+    opt.threads.push_back(hw);
+
+    for (int a = 1; a < argc; a++) {
+        bool hasValue = a + 1 < argc;
+        if (!std::strcmp(argv[a], "--sizes") && hasValue) opt.sizes = ParseList(argv[++a]);
+        else if (!std::strcmp(argv[a], "--sizes3d") && hasValue) opt.sizes3D = ParseList(argv[++a]);
+        else if (!std::strcmp(argv[a], "--threads") && hasValue) opt.threads = ParseList(argv[++a]);
+        else if (!std::strcmp(argv[a], "--min-time") && hasValue) opt.minMs = std::atof(argv[++a]);
+        else if (!std::strcmp(argv[a], "--json") && hasValue) opt.jsonPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--ensemble-sizes") && hasValue) opt.ensembleSizes = ParseList(argv[++a]);
+        else if (!std::strcmp(argv[a], "--ensemble-members") && hasValue) opt.ensembleMembers = std::max(std::atoi(argv[++a]), 1);
+        else if (!std::strcmp(argv[a], "--no-3d")) run3D = false;
+        else if (!std::strcmp(argv[a], "--no-ensemble")) runEnsemble = false;
+        else {
+            PrintUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    SolverBench::Run2D(opt, results);
+    if (run3D) {
+        SolverBench::Run3D(opt, results);
+    }
+    if (runEnsemble) {
+        SolverBench::RunEnsemble(opt, results);
+    }
+
+    std::printf("\n%-14s %-13s %-12s %6s %4s %4s %12s %10s %12s %8s\n",
+        "solver", "mode", "phase", "n", "nz", "thr", "ms/call", "ns/cell", "cells/s", "GB/s");
+    for (const BenchResult& b : results) {
+        double seconds = b.msPerCall * 1e-3;
+        std::printf("%-14s %-13s %-12s %6d %4d %4d %12.4f %10.3f %12.4e %8.2f\n",
+            b.solver.c_str(), b.mode.c_str(), b.phase.c_str(), b.nx, b.nz, b.threads, b.msPerCall,
+            seconds * 1e9 / b.cells, b.cells / seconds, b.bytes / seconds * 1e-9);
+    }
+
+    if (opt.jsonPath) {
+        WriteJson(opt.jsonPath, results);
+    }
+
+    return 0;
+}
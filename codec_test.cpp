@@ -0,0 +1,228 @@
+// round trips of FieldCodec and Snapshot: lossless is bit-exact, lossy
+// stays within its bound, incompressible chunks are stored raw and broken
+// input is rejected
+
+#include "FieldCodec.h"
+#include "Snapshot.h"
+#include "TestHelpers.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// a smooth blob like a density field, plus a few values no codec path may
+// mangle
+static std::vector<float> SmoothField(int nx, int ny)
+{
+    std::vector<float> field(static_cast<size_t>(nx + 2) * (ny + 2), 0.0f);
+    for (int j = 1; j <= ny; j++) {
+        for (int i = 1; i <= nx; i++) {
+            float x = (i - nx * 0.5f) / nx;
+            float y = (j - ny * 0.3f) / ny;
+            field[i + (nx + 2) * j] = std::exp(-20.0f * (x * x + y * y)) * (1.0f + 0.1f * std::sin(0.3f * i));
+        }
+    }
+    field[nx + 3] = -0.0f;
+    field[nx + 4] = std::numeric_limits<float>::denorm_min();
+    return field;
+}
+
+static bool TestLossless(ThreadPool* pool)
+{
+    std::vector<float> field = SmoothField(300, 250);
+    field[1000] = std::numeric_limits<float>::infinity();
+    field[1001] = std::numeric_limits<float>::quiet_NaN();
+
+    CodecOptions options;
+    options.mode = CodecMode::LOSSLESS;
+    options.chunkValues = 4096;
+    std::vector<unsigned char> stream;
+    FieldCodec::Encode(field.data(), field.size(), options, pool, stream);
+    CHECK(stream.size() < field.size() * sizeof(float));
+
+    std::vector<float> decoded(field.size());
+    CHECK(FieldCodec::Decode(stream.data(), stream.size(), decoded.data(), decoded.size(), pool));
+    CHECK(BitEqual(field, decoded));
+
+    // serial decode of a parallel encode gives the same bits
+    std::vector<float> serial(field.size());
+    CHECK(FieldCodec::Decode(stream.data(), stream.size(), serial.data(), serial.size(), nullptr));
+    CHECK(BitEqual(field, serial));
+    return true;
+}
+
+static bool TestLossy(ThreadPool* pool)
+{
+    std::vector<float> field = SmoothField(256, 256);
+
+    for (float bound : { 1e-2f, 1e-4f, 1e-6f }) {
+        CodecOptions options;
+        options.mode = CodecMode::LOSSY;
+        options.errorBound = bound;
+        std::vector<unsigned char> stream;
+        FieldCodec::Encode(field.data(), field.size(), options, pool, stream);
+
+        std::vector<float> decoded(field.size());
+        CHECK(FieldCodec::Decode(stream.data(), stream.size(), decoded.data(), decoded.size(), pool));
+        for (size_t i = 0; i < field.size(); i++) {
+            CHECK(std::fabs(decoded[i] - field[i]) <= bound);
+        }
+    }
+
+    // a chunk holding a non-finite value cannot be quantized and falls
+    // back to lossless
+    field[5] = std::numeric_limits<float>::infinity();
+    CodecOptions options;
+    options.mode = CodecMode::LOSSY;
+    std::vector<unsigned char> stream;
+    FieldCodec::Encode(field.data(), field.size(), options, pool, stream);
+    std::vector<float> decoded(field.size());
+    CHECK(FieldCodec::Decode(stream.data(), stream.size(), decoded.data(), decoded.size(), pool));
+    CHECK(decoded[5] == field[5]);
+    return true;
+}
+
+static bool TestRawFallback()
+{
+    // random bit patterns do not compress, so the single chunk is stored
+    // raw: stream header, one chunk size, mode byte and the plain floats
+    std::mt19937 random(7);
+    const size_t count = 10000;
+    std::vector<float> noise(count);
+    for (float& value : noise) {
+        uint32_t bits = random();
+        std::memcpy(&value, &bits, sizeof(bits));
+    }
+
+    CodecOptions options;
+    options.mode = CodecMode::LOSSLESS;
+    std::vector<unsigned char> stream;
+    FieldCodec::Encode(noise.data(), count, options, nullptr, stream);
+    const size_t headerBytes = 16;
+    CHECK(stream.size() == headerBytes + 4 + 1 + count * sizeof(float));
+    CHECK(stream[headerBytes + 4] == static_cast<unsigned char>(CodecMode::RAW));
+
+    std::vector<float> decoded(count);
+    CHECK(FieldCodec::Decode(stream.data(), stream.size(), decoded.data(), count, nullptr));
+    CHECK(BitEqual(noise, decoded));
+    return true;
+}
+
+static bool TestCorruptStream()
+{
+    std::vector<float> field = SmoothField(64, 64);
+    CodecOptions options;
+    options.chunkValues = 1024;
+    std::vector<unsigned char> stream;
+    FieldCodec::Encode(field.data(), field.size(), options, nullptr, stream);
+    std::vector<float> decoded(field.size());
+
+    // every truncation fails
+    for (size_t bytes = 0; bytes < stream.size(); bytes++) {
+        CHECK(!FieldCodec::Decode(stream.data(), bytes, decoded.data(), decoded.size(), nullptr));
+    }
+
+    // a count that does not match the chunk table
+    CHECK(!FieldCodec::Decode(stream.data(), stream.size(), decoded.data(), decoded.size() - 1024, nullptr));
+
+    // an unknown chunk mode, and a chunk size past the end
+    const size_t headerBytes = 16;
+    uint32_t chunkCount;
+    std::memcpy(&chunkCount, stream.data() + 12, sizeof(chunkCount));
+    std::vector<unsigned char> broken = stream;
+    broken[headerBytes + 4 * chunkCount] = 0x7f;
+    CHECK(!FieldCodec::Decode(broken.data(), broken.size(), decoded.data(), decoded.size(), nullptr));
+    broken = stream;
+    uint32_t huge = 0xffffffffu;
+    std::memcpy(broken.data() + headerBytes, &huge, sizeof(huge));
+    CHECK(!FieldCodec::Decode(broken.data(), broken.size(), decoded.data(), decoded.size(), nullptr));
+
+    // a short stream claiming one huge chunk, and a chunk table whose sizes
+    // do not fit, fail the count check that guards allocations
+    std::vector<unsigned char> tiny(30, 0);
+    uint32_t claim[2] = { 0xffffffffu, 1 };
+    std::memcpy(tiny.data() + 8, claim, sizeof(claim));
+    uint32_t tinyChunk = 10;
+    std::memcpy(tiny.data() + headerBytes, &tinyChunk, sizeof(tinyChunk));
+    CHECK(!FieldCodec::CheckCount(tiny.data(), tiny.size(), 0xffffffffu));
+    claim[0] = FIELD_CODEC_MAX_CHUNK;
+    std::memcpy(tiny.data() + 8, claim, sizeof(claim));
+    CHECK(FieldCodec::CheckCount(tiny.data(), tiny.size(), FIELD_CODEC_MAX_CHUNK));
+    tinyChunk = 11;
+    std::memcpy(tiny.data() + headerBytes, &tinyChunk, sizeof(tinyChunk));
+    CHECK(!FieldCodec::CheckCount(tiny.data(), tiny.size(), FIELD_CODEC_MAX_CHUNK));
+
+    std::mt19937 random(11);
+    for (int trial = 0; trial < 200; trial++) {
+        broken = FlipByte(stream, headerBytes, stream.size(), random);
+        FieldCodec::Decode(broken.data(), broken.size(), decoded.data(), decoded.size(), nullptr);
+    }
+    return true;
+}
+
+static bool TestSnapshot(ThreadPool* pool, const std::string& path)
+{
+    const int nx = 96, ny = 80;
+    std::vector<float> dens = SmoothField(nx, ny);
+    std::vector<float> u(dens.size()), v(dens.size());
+    for (size_t i = 0; i < dens.size(); i++) {
+        u[i] = 0.5f * dens[i];
+        v[i] = -0.25f * dens[i];
+    }
+    SnapshotFieldRef refs[3] = { { DENSITY, nx, ny, dens.data() }, { VELOCITY_U, nx, ny, u.data() },
+        { VELOCITY_V, nx, ny, v.data() } };
+
+    CodecOptions options;
+    options.mode = CodecMode::LOSSLESS;
+    SnapshotStats stats;
+    CHECK(Snapshot::Write(path.c_str(), 1234, refs, 3, options, pool, &stats));
+    CHECK(stats.storedBytes < stats.rawBytes);
+
+    long long step = 0;
+    std::vector<SnapshotField> fields;
+    CHECK(Snapshot::Load(path.c_str(), step, fields, pool));
+    CHECK(step == 1234);
+    CHECK(fields.size() == 3);
+    CHECK(fields[0].type == DENSITY && fields[0].nx == nx && fields[0].ny == ny);
+    CHECK(BitEqual(fields[0].data, dens));
+    CHECK(BitEqual(fields[1].data, u));
+    CHECK(BitEqual(fields[2].data, v));
+
+    // a truncated copy is rejected
+    std::vector<unsigned char> bytes = ReadFile(path);
+    CHECK(bytes.size() > 32);
+    std::string cut = path + ".cut";
+    for (size_t keep : { static_cast<size_t>(3), static_cast<size_t>(20), bytes.size() / 2, bytes.size() - 1 }) {
+        CHECK(WriteFile(cut, bytes, keep));
+        CHECK(!Snapshot::Load(cut.c_str(), step, fields, pool));
+    }
+
+    // a field header claiming an absurd grid
+    std::vector<unsigned char> broken = bytes;
+    int32_t huge = 0x7fffffff;
+    std::memcpy(broken.data() + 20 + 4, &huge, sizeof(huge));
+    std::memcpy(broken.data() + 20 + 8, &huge, sizeof(huge));
+    CHECK(WriteFile(cut, broken, broken.size()));
+    CHECK(!Snapshot::Load(cut.c_str(), step, fields, pool));
+
+    // and one of a field type snapshots do not hold
+    broken = bytes;
+    int32_t type = VELOCITY_W;
+    std::memcpy(broken.data() + 20, &type, sizeof(type));
+    CHECK(WriteFile(cut, broken, broken.size()));
+    CHECK(!Snapshot::Load(cut.c_str(), step, fields, pool));
+
+    std::remove(cut.c_str());
+    std::remove(path.c_str());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    ThreadPool pool(4);
+
+    bool ok = TestLossless(&pool) && TestLossy(&pool) && TestRawFallback() && TestCorruptStream() &&
+        TestSnapshot(&pool, ScratchPath(argc, argv, "codec_test.fssn"));
+    std::cout << (ok ? "codec_test passed" : "codec_test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
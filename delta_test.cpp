@@ -0,0 +1,225 @@
+// round trips of DeltaStream: every frame reads back bit-exact, random
+// access matches sequential replay, a stream without its index is scanned
+// and truncated or corrupt streams are rejected
+
+#include "DeltaStream.h"
+#include "FluidSolver.h"
+#include "TestHelpers.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdint>
+
+// grid not a multiple of the tile size, so edge tiles are padded
+static const int NX = 100;
+static const int NY = 90;
+static const int FRAMES = 40;
+static const int KEYFRAME_INTERVAL = 8;
+
+// density of a plume, one frame every other step
+static void MakeFrames(std::vector<std::vector<float>>& frames, std::vector<long long>& steps)
+{
+    FluidSolver fluid(NX, NY, BoundaryCondition::DIRICHLET);
+    size_t count = static_cast<size_t>(NX + 2) * (NY + 2);
+    for (int f = 0; f < FRAMES; f++) {
+        for (int s = 0; s < 2; s++) {
+            for (int i = NX / 2 - 3; i <= NX / 2 + 3; i++) {
+                fluid.AddInputToField(DENSITY, i, 8, 30.0f);
+                fluid.AddInputToField(VELOCITY_V, i, 8, 0.5f);
+            }
+            fluid.Step();
+        }
+        frames.emplace_back(fluid.GetDensity(), fluid.GetDensity() + count);
+        steps.push_back(fluid.GetStepCount());
+    }
+}
+
+static bool TestRoundTrip(const std::vector<std::vector<float>>& frames, const std::vector<long long>& steps,
+    const std::string& path, ThreadPool* pool)
+{
+    DeltaStreamWriter writer;
+    CHECK(!writer.Open(path.c_str(), 0, NY, KEYFRAME_INTERVAL, 64, pool));
+    CHECK(!writer.Open(path.c_str(), NX, -1, KEYFRAME_INTERVAL, 64, pool));
+    CHECK(writer.Open(path.c_str(), NX, NY, KEYFRAME_INTERVAL, 64, pool));
+    for (int f = 0; f < FRAMES; f++) {
+        CHECK(writer.WriteFrame(steps[f], frames[f].data()));
+    }
+    CHECK(writer.Close());
+    DeltaStreamStats stats = writer.GetStats();
+    CHECK(stats.frames == FRAMES);
+    CHECK(stats.keyframes == (FRAMES + KEYFRAME_INTERVAL - 1) / KEYFRAME_INTERVAL);
+    CHECK(stats.storedBytes < stats.rawBytes);
+
+    DeltaStreamReader reader;
+    CHECK(reader.Open(path.c_str(), pool));
+    CHECK(reader.GetNX() == NX && reader.GetNY() == NY);
+    CHECK(reader.GetFrameCount() == FRAMES);
+    CHECK(static_cast<long long>(reader.GetKeyframes().size()) == stats.keyframes);
+
+    // sequential replay
+    size_t count = frames[0].size();
+    std::vector<std::vector<float>> sequential(FRAMES, std::vector<float>(count));
+    for (int f = 0; f < FRAMES; f++) {
+        long long step = -1;
+        CHECK(reader.ReadFrame(f, sequential[f].data(), &step));
+        CHECK(step == steps[f]);
+        CHECK(BitEqual(sequential[f].data(), frames[f].data(), count));
+    }
+
+    // random access from a fresh reader and from the same one, including
+    // backwards jumps and repeats
+    std::vector<int> order;
+    for (int f = 0; f < FRAMES; f++) {
+        order.push_back(f);
+        order.push_back(FRAMES - 1 - f);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(3));
+    DeltaStreamReader fresh;
+    CHECK(fresh.Open(path.c_str(), nullptr));
+    std::vector<float> out(count);
+    for (int f : order) {
+        CHECK(fresh.ReadFrame(f, out.data()));
+        CHECK(BitEqual(out.data(), sequential[f].data(), count));
+        CHECK(reader.ReadFrame(f, out.data()));
+        CHECK(BitEqual(out.data(), sequential[f].data(), count));
+    }
+    CHECK(!reader.ReadFrame(-1, out.data()));
+    CHECK(!reader.ReadFrame(FRAMES, out.data()));
+    return true;
+}
+
+static bool TestDamagedStreams(const std::vector<std::vector<float>>& frames, const std::string& path)
+{
+    std::vector<unsigned char> bytes = ReadFile(path);
+    CHECK(bytes.size() > 64);
+    std::string damaged = path + ".damaged";
+    size_t count = frames[0].size();
+    std::vector<float> out(count);
+
+    // without the index (the writer never closed it) the frames are found
+    // by scanning
+    uint64_t indexOffset;
+    std::memcpy(&indexOffset, bytes.data() + bytes.size() - 12, sizeof(indexOffset));
+    CHECK(indexOffset < bytes.size());
+    CHECK(WriteFile(damaged, bytes, static_cast<size_t>(indexOffset)));
+    {
+        DeltaStreamReader reader;
+        CHECK(reader.Open(damaged.c_str()));
+        CHECK(reader.GetFrameCount() == FRAMES);
+        for (int f = FRAMES - 1; f >= 0; f -= 3) {
+            CHECK(reader.ReadFrame(f, out.data()));
+            CHECK(BitEqual(out.data(), frames[f].data(), count));
+        }
+    }
+
+    // a stream cut inside its last record keeps the complete frames
+    CHECK(WriteFile(damaged, bytes, static_cast<size_t>(indexOffset) - 5));
+    {
+        DeltaStreamReader reader;
+        CHECK(reader.Open(damaged.c_str()));
+        CHECK(reader.GetFrameCount() == FRAMES - 1);
+        CHECK(reader.ReadFrame(FRAMES - 2, out.data()));
+        CHECK(BitEqual(out.data(), frames[FRAMES - 2].data(), count));
+    }
+
+    // too short for a header, or not a delta stream
+    for (size_t keep : { static_cast<size_t>(0), static_cast<size_t>(10), static_cast<size_t>(23) }) {
+        CHECK(WriteFile(damaged, bytes, keep));
+        DeltaStreamReader reader;
+        CHECK(!reader.Open(damaged.c_str()));
+    }
+    std::vector<unsigned char> broken = bytes;
+    broken[0] = 'X';
+    CHECK(WriteFile(damaged, broken, broken.size()));
+    {
+        DeltaStreamReader reader;
+        CHECK(!reader.Open(damaged.c_str()));
+    }
+
+    // the second record: an unknown kind, then a length past the end of
+    // the file. frame 0 still reads, frame 1 fails cleanly
+    const size_t headerBytes = 24;
+    uint64_t firstBytes;
+    std::memcpy(&firstBytes, bytes.data() + headerBytes + 12, sizeof(firstBytes));
+    size_t second = headerBytes + 20 + static_cast<size_t>(firstBytes);
+    for (int damage = 0; damage < 2; damage++) {
+        broken = bytes;
+        if (damage == 0) {
+            uint32_t kind = 7;
+            std::memcpy(broken.data() + second + 8, &kind, sizeof(kind));
+        }
+        else {
+            uint64_t huge = ~0ull;
+            std::memcpy(broken.data() + second + 12, &huge, sizeof(huge));
+        }
+        CHECK(WriteFile(damaged, broken, broken.size()));
+        DeltaStreamReader reader;
+        CHECK(reader.Open(damaged.c_str()));
+        CHECK(reader.ReadFrame(0, out.data()));
+        CHECK(!reader.ReadFrame(1, out.data()));
+        CHECK(reader.ReadFrame(0, out.data()));
+        CHECK(BitEqual(out.data(), frames[0].data(), count));
+    }
+
+    // an index whose keyframe points outside the file, or at a delta
+    // record, is not trusted, the records are scanned instead
+    for (uint64_t offset : { static_cast<uint64_t>(~0ull - 4), static_cast<uint64_t>(second) }) {
+        broken = bytes;
+        std::memcpy(broken.data() + indexOffset + 12 + 24 + 16, &offset, sizeof(offset));
+        CHECK(WriteFile(damaged, broken, broken.size()));
+        DeltaStreamReader reader;
+        CHECK(reader.Open(damaged.c_str()));
+        CHECK(reader.GetFrameCount() == FRAMES);
+        CHECK(reader.ReadFrame(KEYFRAME_INTERVAL + 1, out.data()));
+        CHECK(BitEqual(out.data(), frames[KEYFRAME_INTERVAL + 1].data(), count));
+    }
+
+    // a header claiming a grid larger than the file can hold, or a tile
+    // larger than the grid, is rejected before anything is allocated
+    for (int32_t claim : { 0x7ffffff0, 40000, -3 }) {
+        broken = bytes;
+        std::memcpy(broken.data() + 8, &claim, sizeof(claim));
+        std::memcpy(broken.data() + 12, &claim, sizeof(claim));
+        CHECK(WriteFile(damaged, broken, broken.size()));
+        DeltaStreamReader reader;
+        CHECK(!reader.Open(damaged.c_str()) || reader.GetFrameCount() == 0);
+        CHECK(!reader.ReadFrame(0, out.data()));
+    }
+    broken = bytes;
+    int32_t hugeTile = 1 << 20;
+    std::memcpy(broken.data() + 16, &hugeTile, sizeof(hugeTile));
+    CHECK(WriteFile(damaged, broken, broken.size()));
+    {
+        DeltaStreamReader reader;
+        CHECK(!reader.Open(damaged.c_str()));
+    }
+
+    std::mt19937 random(5);
+    for (int trial = 0; trial < 100; trial++) {
+        broken = FlipByte(bytes, headerBytes, static_cast<size_t>(indexOffset), random);
+        CHECK(WriteFile(damaged, broken, broken.size()));
+        DeltaStreamReader reader;
+        if (reader.Open(damaged.c_str())) {
+            for (int f = 0; f < reader.GetFrameCount(); f += 5) {
+                reader.ReadFrame(f, out.data());
+            }
+        }
+    }
+
+    std::remove(damaged.c_str());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::string path = ScratchPath(argc, argv, "delta_test.fsds");
+    ThreadPool pool(4);
+
+    std::vector<std::vector<float>> frames;
+    std::vector<long long> steps;
+    MakeFrames(frames, steps);
+
+    bool ok = TestRoundTrip(frames, steps, path, &pool) && TestDamagedStreams(frames, path);
+    std::remove(path.c_str());
+    std::cout << (ok ? "delta_test passed" : "delta_test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AsyncFieldWriter.h"
+#include "Checkpoint.h"
+#include "DecomposedSolver.h"
+#include "DeltaStream.h"
+#include "FluidSolver.h"
+#include "InputLog.h"
+#include "ShmTransport.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// headless driver: runs the dense solver without a window and reports
+// timing, so batch jobs and benchmarks need no OpenGL. the input is either
+// a built-in plume or a recorded input log replayed at full speed. frames
+// can be rendered to PNG or video on a background thread with --render.
+// --ranks N splits the plume run into N processes exchanging halos through
+// shared memory
+
+static void PrintUsage(const char* exe)
+{
+    std::cout << "usage: " << exe << " [--nx N] [--ny N] [--steps N] [--velocity-scale S]"
+        " [--no-mask] [--profile] [--trace file] [--out file]"
+        " [--record log] [--replay log]"
+        " [--save-checkpoint file] [--load-checkpoint file]"
+        " [--dump pattern] [--dump-every N] [--dump-queue N] [--dump-policy block|drop|coalesce]"
+        " [--codec lossless|lossy] [--error-bound E] [--snapshot file]"
+        " [--dump-stream file] [--keyframe-interval N]"
+        " [--render pattern.png|file.y4m|\"|command\"] [--render-every N] [--render-field density|speed]"
+        " [--render-size WxH] [--render-range lo:hi] [--colormap gray|inferno] [--fps N]"
+        " [--ranks N] [--halo rows] [--bind-numa]" << std::endl;
+}
+
+// plume rising from the bottom centre during the first PLUME_STEPS solver
+// steps, clipped to the interior on grids narrower than the source
+static const long long PLUME_STEPS = 50;
+
+template <typename Solver>
+static void AddPlumeSource(Solver& fluid, int NX, int NY)
+{
+    int halfWidth = NX / 30 + 1;
+    int sourceJ = NY / 10 + 1;
+    int i0 = std::max(NX / 2 - halfWidth, 1);
+    int i1 = std::min(NX / 2 + halfWidth, NX);
+    for (int i = i0; i <= i1; i++) {
+        fluid.AddInputToField(DENSITY, i, sourceJ, 30.0f);
+        fluid.AddInputToField(VELOCITY_V, i, sourceJ, 0.5f);
+    }
+}
+
+#ifdef __linux__
+// pin this process to the CPUs of NUMA node rank % nodes, so its strip is
+// allocated and streamed on one node
+static void BindToNumaNode(int rank)
+{
+    int nodes = 0;
+    while (FILE* probe = std::fopen(("/sys/devices/system/node/node" + std::to_string(nodes) + "/cpulist").c_str(), "r")) {
+        std::fclose(probe);
+        nodes++;
+    }
+    if (nodes == 0) {
+        return;
+    }
+
+    int node = rank % nodes;
+    FILE* list = std::fopen(("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist").c_str(), "r");
+    if (!list) {
+        return;
+    }
+    // ranges like "0-7,16-23"
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int first, last;
+    while (std::fscanf(list, "%d", &first) == 1) {
+        last = first;
+        int next = std::fgetc(list);
+        if (next == '-') {
+            if (std::fscanf(list, "%d", &last) != 1) {
+                break;
+            }
+            next = std::fgetc(list);
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+        if (next != ',') {
+            break;
+        }
+    }
+    std::fclose(list);
+
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        std::cerr << "Warning: rank " << rank << " cannot bind to NUMA node " << node << std::endl;
+    }
+}
+#endif
+
+// the plume run on `ranks` processes, each stepping a strip of rows. rank
+// 0 is this process and reports, the others are forked from it
+static int RunDecomposed(int NX, int NY, int steps, int ranks, int haloRows, bool bindNuma, const char* outPath)
+{
+#ifdef _WIN32
+    std::cerr << "Error: --ranks needs fork and POSIX shared memory." << std::endl;
+    return -1;
+#else
+    // checked before forking, so a bad split is one error rather than one per rank
+    if (!DecomposedSolver::CheckStrips(NY, ranks, haloRows)) {
+        return -1;
+    }
+
+    std::string name = "/fluidsim-" + std::to_string(getpid());
+
+    int rank = 0;
+    std::vector<pid_t> children;
+    for (int r = 1; r < ranks; r++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            rank = r;
+            children.clear();
+            break;
+        }
+        if (pid < 0) {
+            // the started ranks wait for the segment rank 0 has not created
+            // yet, stop them rather than run on fewer ranks than asked for
+            std::cerr << "Error: cannot start rank " << r << std::endl;
+            for (pid_t child : children) {
+                kill(child, SIGKILL);
+            }
+            for (pid_t child : children) {
+                waitpid(child, nullptr, 0);
+            }
+            return -1;
+        }
+        children.push_back(pid);
+    }
+
+#ifdef __linux__
+    if (bindNuma) {
+        BindToNumaNode(rank);
+    }
+#else
+    (void)bindNuma;
+#endif
+
+    ShmTransport transport;
+    bool ok = transport.Open(name.c_str(), rank, ranks);
+    double totalMs = 0.0;
+    double mass = 0.0;
+    std::vector<float> density;
+    int rowBegin = 0, rowEnd = 0;
+    double exchangeMs = 0.0;
+
+    if (ok) {
+        DecomposedSolver fluid(NX, NY, &transport, haloRows);
+        rowBegin = fluid.GetRowBegin();
+        rowEnd = fluid.GetRowEnd();
+
+        // the same plume as the single process run, each rank keeps its rows
+        for (int step = 0; step < steps && ok; step++) {
+            if (fluid.GetStepCount() < PLUME_STEPS) {
+                AddPlumeSource(fluid, NX, NY);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            ok = fluid.Step();
+            totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        exchangeMs = fluid.GetExchangeMs();
+        ok = ok && fluid.GetDensitySum(mass);
+        if (ok && outPath) {
+            if (rank == 0) {
+                density.resize(static_cast<size_t>(NX + 2) * (NY + 2));
+            }
+            ok = fluid.GatherDensity(rank == 0 ? density.data() : nullptr);
+        }
+    }
+    if (!ok) {
+        transport.Abort();
+    }
+
+    // a forked rank leaves without the parent's atexit handlers, static
+    // destructors or a second flush of the stdio buffers it inherited
+    if (rank != 0) {
+        transport.Close();
+        _exit(ok ? 0 : 1);
+    }
+
+    std::cout << "rank 0 rows " << rowBegin << ".." << rowEnd << ", exchange " << (steps > 0 ? exchangeMs / steps : 0.0)
+        << " ms/step" << std::endl;
+
+    for (pid_t child : children) {
+        int status = 0;
+        if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        std::cerr << "Error: the decomposed run failed." << std::endl;
+        return -1;
+    }
+
+    std::cout << "grid " << NX << "x" << NY << " on " << ranks << " ranks, " << steps << " steps, "
+        << (steps > 0 ? totalMs / steps : 0.0) << " ms/step, density sum " << mass << std::endl;
+
+    if (outPath) {
+        FILE* out = std::fopen(outPath, "wb");
+        if (!out) {
+            std::cerr << "Error: cannot open " << outPath << std::endl;
+            return -1;
+        }
+        std::fwrite(density.data(), sizeof(float), density.size(), out);
+        std::fclose(out);
+    }
+    return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+    int NX = 150;
+    int NY = 150;
+    int steps = -1;
+    int velocityScale = 1;
+    bool useMask = true;
+    bool profile = false;
+    const char* outPath = nullptr;
+    const char* tracePath = nullptr;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* savePath = nullptr;
+    const char* loadPath = nullptr;
+    const char* dumpPattern = nullptr;
+    int dumpEvery = 1;
+    int dumpQueue = 4;
+    OverflowPolicy dumpPolicy = OverflowPolicy::BLOCK;
+    // compressed dumps and snapshots, raw dumps when no codec is given
+    bool compress = false;
+    CodecOptions codec;
+    const char* snapshotPath = nullptr;
+    // all dumped frames in one keyframe + delta stream instead
+    const char* streamPath = nullptr;
+    int keyframeInterval = 32;
+    // colormapped images or video, drawn on the CPU off the solver thread
+    const char* renderTarget = nullptr;
+    int renderEvery = 1;
+    bool renderSpeed = false;
+    ImageOptions image;
+    // strips of rows on separate processes
+    int ranks = 1;
+    int haloRows = 4;
+    bool bindNuma = false;
+
+    for (int a = 1; a < argc; a++) {
+        bool hasValue = a + 1 < argc;
+        if (!std::strcmp(argv[a], "--nx") && hasValue) NX = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--ny") && hasValue) NY = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--steps") && hasValue) steps = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--velocity-scale") && hasValue) velocityScale = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--no-mask")) useMask = false;
+        else if (!std::strcmp(argv[a], "--profile")) profile = true;
+        else if (!std::strcmp(argv[a], "--out") && hasValue) outPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--trace") && hasValue) tracePath = argv[++a];
+        else if (!std::strcmp(argv[a], "--record") && hasValue) recordPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--replay") && hasValue) replayPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--save-checkpoint") && hasValue) savePath = argv[++a];
+        else if (!std::strcmp(argv[a], "--load-checkpoint") && hasValue) loadPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--dump") && hasValue) dumpPattern = argv[++a];
+        else if (!std::strcmp(argv[a], "--dump-every") && hasValue) dumpEvery = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--dump-queue") && hasValue) dumpQueue = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--dump-policy") && hasValue) {
+            const char* policy = argv[++a];
+            if (!std::strcmp(policy, "drop")) dumpPolicy = OverflowPolicy::DROP;
+            else if (!std::strcmp(policy, "coalesce")) dumpPolicy = OverflowPolicy::COALESCE;
+            else dumpPolicy = OverflowPolicy::BLOCK;
+        }
+        else if (!std::strcmp(argv[a], "--codec") && hasValue) {
+            compress = true;
+            codec.mode = !std::strcmp(argv[++a], "lossy") ? CodecMode::LOSSY : CodecMode::LOSSLESS;
+        }
+        else if (!std::strcmp(argv[a], "--error-bound") && hasValue) codec.errorBound = static_cast<float>(std::atof(argv[++a]));
+        else if (!std::strcmp(argv[a], "--snapshot") && hasValue) snapshotPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--dump-stream") && hasValue) streamPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--keyframe-interval") && hasValue) keyframeInterval = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--render") && hasValue) renderTarget = argv[++a];
+        else if (!std::strcmp(argv[a], "--render-every") && hasValue) renderEvery = std::max(std::atoi(argv[++a]), 1);
+        else if (!std::strcmp(argv[a], "--render-field") && hasValue) renderSpeed = !std::strcmp(argv[++a], "speed");
+        else if (!std::strcmp(argv[a], "--render-size") && hasValue) {
+            if (std::sscanf(argv[++a], "%dx%d", &image.width, &image.height) != 2) {
+                image.width = image.height = 0;
+            }
+        }
+        else if (!std::strcmp(argv[a], "--render-range") && hasValue) {
+            if (std::sscanf(argv[++a], "%f:%f", &image.lo, &image.hi) != 2) {
+                image.lo = image.hi = 0.0f;
+            }
+        }
+        else if (!std::strcmp(argv[a], "--colormap") && hasValue) {
+            image.colormap = !std::strcmp(argv[++a], "gray") ? Colormap::GRAY : Colormap::INFERNO;
+        }
+        else if (!std::strcmp(argv[a], "--fps") && hasValue) image.fps = std::max(std::atoi(argv[++a]), 1);
+        else if (!std::strcmp(argv[a], "--ranks") && hasValue) ranks = std::max(std::atoi(argv[++a]), 1);
+        else if (!std::strcmp(argv[a], "--halo") && hasValue) haloRows = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--bind-numa")) bindNuma = true;
+        else {
+            PrintUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    // a replay runs the recorded configuration for the recorded step count
+    InputReplay replay;
+    BoundaryCondition bc = BoundaryCondition::DIRICHLET;
+    if (replayPath) {
+        if (!replay.Open(replayPath)) {
+            return -1;
+        }
+        const InputLogHeader& header = replay.GetHeader();
+        NX = header.nx;
+        NY = header.ny;
+        velocityScale = header.velocityScale;
+        bc = static_cast<BoundaryCondition>(header.boundary);
+        if (steps < 0) {
+            steps = static_cast<int>(header.steps);
+        }
+    }
+    if (steps < 0) {
+        steps = 500;
+    }
+
+    if (NX <= 0 || NY <= 0) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    if (ranks > 1) {
+        if (replayPath || loadPath || savePath || dumpPattern || streamPath || renderTarget || snapshotPath || recordPath) {
+            std::cerr << "Warning: --ranks runs the built-in plume and only writes --out." << std::endl;
+        }
+        return RunDecomposed(NX, NY, steps, ranks, haloRows, bindNuma, outPath);
+    }
+
+#ifdef FLUIDSIM_TRACE
+    Tracer::SetEnabled(tracePath != nullptr);
+    TRACE_THREAD_NAME("main");
+#else
+    if (tracePath) {
+        std::cerr << "Warning: built without FLUIDSIM_TRACE, --trace ignored." << std::endl;
+    }
+#endif
+
+    // a checkpoint brings its own grid, parameters and step counter
+    std::unique_ptr<FluidSolver> fluid;
+    if (loadPath) {
+        fluid = Checkpoint::Load(loadPath);
+        if (!fluid) {
+            return -1;
+        }
+        NX = fluid->GetNX();
+        NY = fluid->GetNY();
+    }
+    else {
+        fluid.reset(new FluidSolver(NX, NY, bc, velocityScale));
+    }
+    fluid->SetActivityMaskEnabled(useMask);
+    fluid->GetProfiler().SetResidualTracking(profile);
+
+    InputRecorder recorder;
+    if (recordPath) {
+        if (!recorder.Open(recordPath, *fluid)) {
+            return -1;
+        }
+        fluid->SetInputRecorder(&recorder);
+    }
+
+    // density frames go out on a background thread
+    std::unique_ptr<FrameSink> sink;
+    CompressedFrameSink* compressedSink = nullptr;
+    DeltaFrameSink* streamSink = nullptr;
+    std::unique_ptr<AsyncFieldWriter> writer;
+    if (dumpPattern || streamPath) {
+        if (streamPath) {
+            streamSink = new DeltaFrameSink(streamPath, keyframeInterval);
+            sink.reset(streamSink);
+        }
+        else if (compress) {
+            compressedSink = new CompressedFrameSink(dumpPattern, codec);
+            sink.reset(compressedSink);
+        }
+        else {
+            sink.reset(new RawFrameSink(dumpPattern));
+        }
+        writer.reset(new AsyncFieldWriter(sink.get(), dumpQueue, dumpPolicy));
+        fluid->SetFieldOutput(writer.get(), dumpEvery);
+    }
+
+    // rendered frames have their own queue, fed from the step loop below
+    std::unique_ptr<ImageFrameSink> renderSink;
+    std::unique_ptr<AsyncFieldWriter> renderWriter;
+    std::vector<float> speed;
+    if (renderTarget) {
+#ifndef _WIN32
+        // an encoder that exits early should fail the writes, not end the run
+        if (renderTarget[0] == '|') {
+            std::signal(SIGPIPE, SIG_IGN);
+        }
+#endif
+        renderSink.reset(new ImageFrameSink(renderTarget, image));
+        renderWriter.reset(new AsyncFieldWriter(renderSink.get(), dumpQueue, dumpPolicy));
+    }
+
+    double totalMs = 0.0;
+    for (int step = 0; step < steps; step++) {
+        if (replayPath) {
+            replay.Apply(*fluid, step);
+        }
+        else if (fluid->GetStepCount() < PLUME_STEPS) {
+            AddPlumeSource(*fluid, NX, NY);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        fluid->Step();
+        auto end = std::chrono::steady_clock::now();
+        totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (renderWriter && fluid->GetStepCount() % renderEvery == 0) {
+            if (renderSpeed) {
+                // |u, v| on the velocity grid, the sink resamples it
+                int nvx = fluid->GetVelocityNX();
+                int nvy = fluid->GetVelocityNY();
+                const float* u = fluid->GetVelocityU();
+                const float* v = fluid->GetVelocityV();
+                speed.resize(static_cast<size_t>(nvx + 2) * (nvy + 2));
+                for (size_t k = 0; k < speed.size(); k++) {
+                    speed[k] = std::sqrt(u[k] * u[k] + v[k] * v[k]);
+                }
+                renderWriter->Submit(fluid->GetStepCount(), nvx, nvy, speed.data());
+            }
+            else {
+                renderWriter->Submit(fluid->GetStepCount(), NX, NY, fluid->GetDensity());
+            }
+        }
+    }
+
+    if (renderWriter) {
+        renderWriter->Flush();
+        WriterStats stats = renderWriter->GetStats();
+        bool closed = renderSink->Close();
+        std::cout << "rendered " << stats.written << " frames to " << renderTarget << ", "
+            << stats.dropped << " dropped, " << stats.failed << " failed, blocked " << stats.blockedMs
+            << " ms" << (closed ? "" : ", video stream failed") << std::endl;
+    }
+
+    if (writer) {
+        auto start = std::chrono::steady_clock::now();
+        writer->Flush();
+        double drainMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        fluid->SetFieldOutput(nullptr);
+
+        WriterStats stats = writer->GetStats();
+        std::cout << "frames: " << stats.submitted << " submitted, " << stats.written << " written, "
+            << stats.dropped << " dropped, " << stats.coalesced << " coalesced, " << stats.failed << " failed, "
+            << "max queue " << stats.maxQueued << ", blocked " << stats.blockedMs << " ms, drain "
+            << drainMs << " ms" << std::endl;
+        if (compressedSink && compressedSink->GetStoredBytes() > 0) {
+            std::cout << "frames compressed " << compressedSink->GetRawBytes() << " -> "
+                << compressedSink->GetStoredBytes() << " bytes ("
+                << static_cast<double>(compressedSink->GetRawBytes()) / compressedSink->GetStoredBytes()
+                << "x)" << std::endl;
+        }
+        if (streamSink) {
+            DeltaStreamWriter& stream = streamSink->GetWriter();
+            stream.Close();
+            DeltaStreamStats stats = stream.GetStats();
+            std::cout << "stream " << stats.frames << " frames (" << stats.keyframes << " keyframes), "
+                << stats.skippedTiles << "/" << stats.tiles << " delta tiles unchanged, "
+                << stats.rawBytes << " -> " << stats.storedBytes << " bytes ("
+                << (stats.storedBytes ? static_cast<double>(stats.rawBytes) / stats.storedBytes : 0.0)
+                << "x)" << std::endl;
+        }
+    }
+
+    // total density as a cheap checksum of the run
+    const float* density = fluid->GetDensity();
+    int size = (NX + 2) * (NY + 2);
+    double mass = 0.0;
+    for (int i = 0; i < size; i++) {
+        mass += density[i];
+    }
+
+    if (recordPath) {
+        recorder.Close(fluid->GetStepCount());
+        std::cout << "recorded " << recorder.GetEventCount() << " inputs to " << recordPath << std::endl;
+    }
+
+    std::cout << "grid " << NX << "x" << NY << ", " << steps << " steps, "
+        << (steps > 0 ? totalMs / steps : 0.0) << " ms/step, density sum " << mass << std::endl;
+
+    if (profile) {
+        fluid->GetProfiler().Dump(std::cout);
+    }
+
+#ifdef FLUIDSIM_TRACE
+    if (tracePath && !Tracer::WriteChromeJson(tracePath)) {
+        std::cerr << "Error: cannot open " << tracePath << std::endl;
+    }
+#endif
+
+    if (savePath && !Checkpoint::Save(*fluid, savePath)) {
+        return -1;
+    }
+
+    if (snapshotPath) {
+        ThreadPool pool;
+        SnapshotStats stats;
+        if (!Snapshot::Save(*fluid, snapshotPath, codec, &pool, &stats)) {
+            return -1;
+        }
+        std::cout << "snapshot " << stats.rawBytes << " -> " << stats.storedBytes << " bytes ("
+            << static_cast<double>(stats.rawBytes) / stats.storedBytes << "x) in " << stats.encodeMs
+            << " ms" << std::endl;
+    }
+
+    // raw float dump of the final (NX + 2) x (NY + 2) density
+    if (outPath) {
+        FILE* out = std::fopen(outPath, "wb");
+        if (!out) {
+            std::cerr << "Error: cannot open " << outPath << std::endl;
+            return -1;
+        }
+        std::fwrite(density, sizeof(float), size, out);
+        std::fclose(out);
+    }
+
+    return 0;
+}
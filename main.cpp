@@ -1,18 +1,113 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "FluidSolver.h"
+#include "InputLog.h"
 #include "OpenGLRenderer.h"
+#include "StepScheduler.h"
+#include "Tracer.h"
 
-int main() {
+int main(int argc, char** argv) {
 
-    int N = 150;
-    FluidSolver fluid(N, BoundaryCondition::DIRICHLET);
-    OpenGLRenderer renderer(800, 800, "Fluid Sim", N, &fluid);
+    // --grid n runs an n x n field, grids larger than the window are shown
+    // resampled to it
+    int NX = 150;
+    int NY = 150;
+    for (int a = 1; a + 1 < argc; a++) {
+        if (!std::strcmp(argv[a], "--grid")) {
+            NX = NY = std::max(std::atoi(argv[a + 1]), 16);
+        }
+    }
+    FluidSolver fluid(NX, NY, BoundaryCondition::DIRICHLET);
+    OpenGLRenderer renderer(800, 800, "Fluid Sim", NX, NY, &fluid);
+
+    // --record <log> captures the mouse input for fluidsim_headless --replay,
+    // --upload half|unorm16|unorm8 shrinks the texture upload, value * --display-scale
+    // is shown, --fused-upload converts inside the solver, --lod-filter box|max
+    // picks how cells are combined into a pixel when the grid outgrows the window,
+    // --arrows and --streamlines start with the velocity overlay shown, --hud
+    // with the performance HUD. the solver runs at --step-rate steps per second
+    // (0 for one step per frame), at most --max-steps per frame and lowering its
+    // relaxation iterations when the steps of a frame take over --step-budget ms.
+    // the display is interpolated between steps unless --no-interpolate, or
+    // --fused-upload, whose display copy always holds the newest step
+    InputRecorder recorder;
+    DisplayFormat uploadFormat = DisplayFormat::FLOAT32;
+    float displayScale = 1.0f;
+    bool fusedUpload = false;
+    bool showArrows = false;
+    bool showStreamlines = false;
+    bool showHud = false;
+    double stepRate = 60.0;
+    int maxSteps = 4;
+    double stepBudget = 12.0;
+    bool interpolate = true;
+    for (int a = 1; a < argc; a++) {
+        bool hasValue = a + 1 < argc;
+        if (!std::strcmp(argv[a], "--record") && hasValue) {
+            if (recorder.Open(argv[++a], fluid)) {
+                fluid.SetInputRecorder(&recorder);
+            }
+        }
+        else if (!std::strcmp(argv[a], "--upload") && hasValue) {
+            const char* format = argv[++a];
+            if (!std::strcmp(format, "half")) uploadFormat = DisplayFormat::HALF16;
+            else if (!std::strcmp(format, "unorm16")) uploadFormat = DisplayFormat::UNORM16;
+            else if (!std::strcmp(format, "unorm8")) uploadFormat = DisplayFormat::UNORM8;
+            else uploadFormat = DisplayFormat::FLOAT32;
+        }
+        else if (!std::strcmp(argv[a], "--display-scale") && hasValue) displayScale = static_cast<float>(std::atof(argv[++a]));
+        else if (!std::strcmp(argv[a], "--fused-upload")) fusedUpload = true;
+        else if (!std::strcmp(argv[a], "--lod-filter") && hasValue) {
+            renderer.setDownsampleFilter(!std::strcmp(argv[++a], "max") ? DownsampleFilter::MAX : DownsampleFilter::BOX);
+        }
+        else if (!std::strcmp(argv[a], "--grid") && hasValue) a++;
+        else if (!std::strcmp(argv[a], "--arrows")) showArrows = true;
+        else if (!std::strcmp(argv[a], "--streamlines")) showStreamlines = true;
+        else if (!std::strcmp(argv[a], "--hud")) showHud = true;
+        else if (!std::strcmp(argv[a], "--step-rate") && hasValue) stepRate = std::atof(argv[++a]);
+        else if (!std::strcmp(argv[a], "--max-steps") && hasValue) maxSteps = std::atoi(argv[++a]);
+        else if (!std::strcmp(argv[a], "--step-budget") && hasValue) stepBudget = std::atof(argv[++a]);
+        else if (!std::strcmp(argv[a], "--no-interpolate")) interpolate = false;
+    }
+    renderer.setUploadFormat(uploadFormat, displayScale, fusedUpload);
+    renderer.setVelocityOverlay(showArrows, showStreamlines);
+    renderer.setHudVisible(showHud);
+
+    StepScheduler scheduler(&fluid, stepRate, maxSteps);
+    scheduler.SetBudget(stepBudget);
+    scheduler.SetInterpolation(interpolate && !fusedUpload);
+    if (stepRate > 0.0) {
+        renderer.setScheduler(&scheduler);
+    }
 
     if (!renderer.initialize()) {
         return -1;
     }
 
+#ifdef FLUIDSIM_TRACE
+    Tracer::SetEnabled(true);
+    TRACE_THREAD_NAME("main");
+#endif
+
     renderer.run();
+    if (renderer.getUploadStalls() > 0) {
+        std::cout << "density uploads stalled " << renderer.getUploadStalls() << " times" << std::endl;
+    }
+    std::cout << "uploaded " << renderer.getUploadedFraction() * 100.0 << "% of density texels" << std::endl;
+    if (scheduler.GetDroppedSeconds() > 0.0) {
+        std::cout << "fell behind the step rate by " << scheduler.GetDroppedSeconds() << " s, ended at "
+            << scheduler.GetIterations() << " relaxation iterations" << std::endl;
+    }
+
+    fluid.SetInputRecorder(nullptr);
+    recorder.Close(fluid.GetStepCount());
+
+#ifdef FLUIDSIM_TRACE
+    // open in chrome://tracing or ui.perfetto.dev
+    Tracer::WriteChromeJson("fluidsim_trace.json");
+#endif
 
     return 0;
 }
\ No newline at end of file